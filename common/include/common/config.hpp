@@ -27,13 +27,18 @@ namespace recastx {
 
     inline constexpr size_t k_DAQ_BUFFER_SIZE = 1000;
     inline constexpr size_t k_DAQ_MONITOR_EVERY = 1000;
+    inline constexpr int k_DAQ_DRAIN_TIMEOUT = 1000; // in milliseconds
     inline constexpr size_t k_PROJECTION_MEDIATOR_BUFFER_SIZE = 10;
+    inline constexpr size_t k_GUI_PACKET_BUFFER_SIZE = 100;
 
     using Orientation = std::array<float, 9>;
 
     enum class ProjectionType : int { DARK = 0, FLAT = 1, PROJECTION = 2, UNKNOWN = 99 };
     enum class BeamShape { PARALELL = 0, CONE = 1 };
     enum class AngleRange { HALF = 0, FULL = 1 };
+    enum class DownsamplingMode { DECIMATION = 0, BINNING = 1 };
+    enum class RampFilterPadding { NONE = 0, ZERO = 1, EDGE = 2 };
+    enum class LogAccuracy { EXACT = 0, FAST = 1 };
 
     using RawDtype = uint16_t;
     using ProDtype = float;
@@ -48,14 +53,17 @@ namespace recastx {
     struct ImageprocParams {
         struct RampFilter {
             std::string name;
+            RampFilterPadding padding = RampFilterPadding::NONE;
         };
 
         uint32_t num_threads;
         uint32_t downsampling_col;
         uint32_t downsampling_row;
+        DownsamplingMode downsampling_mode;
         int32_t offset;
         bool minus_log;
         RampFilter ramp_filter;
+        LogAccuracy log_accuracy = LogAccuracy::EXACT;
     };
 
     struct PaganinParams {
@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef COMMON_RINGQUEUE_H
+#define COMMON_RINGQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace recastx {
+
+// Behavior of RingQueue::push when the queue is full.
+enum class QueuePolicy {
+    DROP_OLDEST = 0, // evict the oldest item
+    DROP_NEWEST = 1, // discard the new item
+    BLOCK = 2 // wait until there is space
+};
+
+// Bounded MPMC queue with pre-allocated slots.
+template<typename T>
+class RingQueue {
+
+    std::vector<T> slots_;
+    const size_t capacity_;
+    const QueuePolicy policy_;
+
+    size_t head_ = 0;
+    size_t len_ = 0;
+    std::atomic<size_t> dropped_ = 0;
+    std::atomic<size_t> popped_ = 0;
+
+    mutable std::mutex mtx_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    // Avoid notifying when nobody is waiting.
+    size_t waiting_consumers_ = 0;
+    size_t waiting_producers_ = 0;
+
+    [[nodiscard]] size_t tail() const {
+        size_t idx = head_ + len_;
+        return idx >= capacity_ ? idx - capacity_ : idx;
+    }
+
+    void advanceHead() {
+        if (++head_ == capacity_) head_ = 0;
+        --len_;
+    }
+
+    template<typename Pred>
+    static bool wait(std::condition_variable& cv, size_t& num_waiting,
+                     std::unique_lock<std::mutex>& lk, int timeout, Pred pred) {
+        if (pred()) return true;
+        ++num_waiting;
+        bool ret = true;
+        if (timeout < 0) {
+            cv.wait(lk, pred);
+        } else {
+            ret = cv.wait_for(lk, std::chrono::milliseconds(timeout), pred);
+        }
+        --num_waiting;
+        return ret;
+    }
+
+    template<typename U>
+    void store(U&& data, std::unique_lock<std::mutex>& lk) {
+        slots_[tail()] = std::forward<U>(data);
+        ++len_;
+        bool notify = waiting_consumers_ > 0;
+        lk.unlock();
+        if (notify) not_empty_.notify_one();
+    }
+
+    void take(T& data, std::unique_lock<std::mutex>& lk) {
+        data = std::move(slots_[head_]);
+        advanceHead();
+        ++popped_;
+        bool notify = waiting_producers_ > 0;
+        lk.unlock();
+        if (notify) not_full_.notify_one();
+    }
+
+    template<typename U>
+    bool tryPushImpl(U&& data) {
+        std::unique_lock lk(mtx_);
+        if (len_ == capacity_) return false;
+        store(std::forward<U>(data), lk);
+        return true;
+    }
+
+    template<typename U>
+    bool pushImpl(U&& data, int timeout) {
+        std::unique_lock lk(mtx_);
+        if (len_ == capacity_) {
+            switch (policy_) {
+                case QueuePolicy::DROP_OLDEST: {
+                    // The evicted item is overwritten below.
+                    advanceHead();
+                    ++dropped_;
+                    break;
+                }
+                case QueuePolicy::DROP_NEWEST: {
+                    ++dropped_;
+                    return false;
+                }
+                case QueuePolicy::BLOCK: {
+                    if (!wait(not_full_, waiting_producers_, lk, timeout, [&] { return len_ < capacity_; })) {
+                        return false;
+                    }
+                    break;
+                }
+            }
+        }
+        store(std::forward<U>(data), lk);
+        return true;
+    }
+
+  public:
+
+    explicit RingQueue(size_t capacity, QueuePolicy policy = QueuePolicy::DROP_OLDEST)
+            : slots_(capacity), capacity_(capacity), policy_(policy) {
+        if (capacity == 0) throw std::invalid_argument("Capacity of RingQueue must be positive");
+    }
+
+    RingQueue(const RingQueue& other) = delete;
+    RingQueue& operator=(const RingQueue& other) = delete;
+
+    // Never blocks. Returns false if the queue is full, in which case 'data' is left untouched.
+    bool tryPush(const T& data) { return tryPushImpl(data); }
+    bool tryPush(T&& data) { return tryPushImpl(std::move(data)); }
+
+    // Push an item and handle a full queue according to the policy. The timeout (in milliseconds)
+    // only applies to QueuePolicy::BLOCK. Returns false if the item is not pushed.
+    bool push(const T& data, int timeout = -1) { return pushImpl(data, timeout); }
+    bool push(T&& data, int timeout = -1) { return pushImpl(std::move(data), timeout); }
+
+    bool tryPop(T& data) {
+        std::unique_lock lk(mtx_);
+        if (len_ == 0) return false;
+        take(data, lk);
+        return true;
+    }
+
+    bool waitAndPop(T& data, int timeout = -1) {
+        std::unique_lock lk(mtx_);
+        if (!wait(not_empty_, waiting_consumers_, lk, timeout, [&] { return len_ > 0; })) return false;
+        take(data, lk);
+        return true;
+    }
+
+    [[nodiscard]] bool empty() const {
+        std::lock_guard lk(mtx_);
+        return len_ == 0;
+    }
+
+    // Release the resources held by the remaining items.
+    void reset() {
+        {
+            std::lock_guard lk(mtx_);
+            while (len_ > 0) {
+                slots_[head_] = T{};
+                advanceHead();
+            }
+            head_ = 0;
+        }
+        not_full_.notify_all();
+    }
+
+    [[nodiscard]] size_t size() const {
+        std::lock_guard lk(mtx_);
+        return len_;
+    }
+
+    [[nodiscard]] size_t capacity() const { return capacity_; }
+
+    [[nodiscard]] QueuePolicy policy() const { return policy_; }
+
+    // Number of items dropped by push() since construction.
+    [[nodiscard]] size_t dropped() const { return dropped_; }
+
+    // Number of items popped since construction. It is updated together with the size, so that
+    // an item is always either in the queue or counted here. Items released by reset() are not
+    // counted.
+    [[nodiscard]] size_t popped() const { return popped_; }
+};
+
+} // namespace recastx
+
+#endif // COMMON_RINGQUEUE_H
\ No newline at end of file
@@ -28,7 +28,7 @@
 
 #include "logger.hpp"
 #include "common/config.hpp"
-#include "common/queue.hpp"
+#include "common/ring_queue.hpp"
 
 namespace recastx::gui {
 
@@ -74,7 +74,7 @@ class RpcClient {
     std::atomic<bool> streaming_proj_ = false;
     std::thread thread_proj_;
 
-    ThreadSafeQueue<DataType> packets_;
+    RingQueue<DataType> packets_ {k_GUI_PACKET_BUFFER_SIZE, QueuePolicy::DROP_OLDEST};
 
     void updateTimeout(int& timeout, const grpc::Status& status) {
         if (checkStatus(status, false) != State::OK) {
@@ -93,7 +93,7 @@ class RpcClient {
 
   public:
 
-    ThreadSafeQueue<DataType>& packets();
+    RingQueue<DataType>& packets();
 
     explicit RpcClient(const std::string& address);
 
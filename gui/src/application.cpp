@@ -298,9 +298,7 @@ void Application::startConsumer() {
         auto& packets = rpc_client_->packets();
         RpcClient::DataType packet;
         while (running_) {
-            if (!packets.tryPop(packet)) {
-                std::this_thread::sleep_for(std::chrono::microseconds(1));
-            } else if (!consume(packet)) {
+            if (packets.waitAndPop(packet, 10) && !consume(packet)) {
                 spdlog::warn("Data ignored!");
             }
         }
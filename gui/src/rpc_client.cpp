@@ -16,7 +16,7 @@ namespace recastx::gui {
 
 using namespace std::string_literals;
 
-ThreadSafeQueue<RpcClient::DataType>& RpcClient::packets() { return packets_; }
+RingQueue<RpcClient::DataType>& RpcClient::packets() { return packets_; }
 
 RpcClient::RpcClient(const std::string& address) {
 
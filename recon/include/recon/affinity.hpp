@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_AFFINITY_H
+#define RECON_AFFINITY_H
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace recastx::recon {
+
+// A set of logical CPUs. An empty set means no restriction.
+class CpuSet {
+
+    std::vector<int> cpus_;
+
+  public:
+
+    CpuSet() = default;
+
+    explicit CpuSet(std::vector<int> cpus);
+
+    // Parse a CPU list, e.g. "0-7,16-23", or a NUMA node, e.g. "node:1".
+    static CpuSet parse(const std::string& s);
+
+    // CPUs of the given NUMA node.
+    static CpuSet numaNode(int node);
+
+    [[nodiscard]] bool empty() const { return cpus_.empty(); }
+
+    [[nodiscard]] const std::vector<int>& cpus() const { return cpus_; }
+
+    [[nodiscard]] std::string str() const;
+};
+
+// CPU affinity of the stages of the reconstruction pipeline.
+//
+// A buffer is allocated and first touched by a thread running on the CPUs of the stage which
+// owns it, so that it is placed on the NUMA node of that stage.
+struct PipelineAffinity {
+    CpuSet daq; // receiving and consumer threads
+    CpuSet preprocessing; // preprocessing thread and workers, raw and flat field buffers
+    CpuSet upload; // sinogram uploading thread and the sinogram buffers
+    CpuSet reconstruction; // reconstruction thread
+};
+
+// Pin the calling thread to the given CPUs. Returns false if it fails.
+bool pinThread(const CpuSet& cpus);
+
+// CPUs the calling thread is allowed to run on. Empty if unknown.
+CpuSet threadAffinity();
+
+// Pin the calling thread to the given CPUs for the lifetime of the scope.
+//
+// The previous affinity is restored on exit, which is required for tasks run by the threads of
+// a shared pool, e.g. the TBB workers.
+class ScopedPin {
+
+    CpuSet prev_;
+    bool pinned_ = false;
+
+  public:
+
+    explicit ScopedPin(const CpuSet& cpus) {
+        if (cpus.empty()) return;
+        prev_ = threadAffinity();
+        pinned_ = !prev_.empty() && pinThread(cpus);
+    }
+
+    ~ScopedPin() {
+        if (pinned_) pinThread(prev_);
+    }
+
+    ScopedPin(const ScopedPin&) = delete;
+    ScopedPin& operator=(const ScopedPin&) = delete;
+};
+
+// Run 'f' in a thread pinned to the given CPUs and wait for it to finish.
+template<typename F>
+void runOn(const CpuSet& cpus, F&& f) {
+    if (cpus.empty()) {
+        f();
+        return;
+    }
+    std::thread t([&] {
+        pinThread(cpus);
+        f();
+    });
+    t.join();
+}
+
+} // namespace recastx::recon
+
+#endif // RECON_AFFINITY_H
\ No newline at end of file
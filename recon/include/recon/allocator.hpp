@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_ALLOCATOR_H
+#define RECON_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+namespace recastx::recon {
+
+enum class HugePages {
+    NONE = 0, // the system default
+    TRANSPARENT = 1, // advise the kernel to back large buffers with transparent huge pages
+    EXPLICIT = 2 // map large buffers from the pool of explicit huge pages, e.g. vm.nr_hugepages
+};
+
+namespace details {
+
+inline constexpr size_t k_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+inline constexpr size_t k_PAGE_SIZE = 4096;
+
+inline std::atomic<HugePages>& hugePagesPolicy() {
+    static std::atomic<HugePages> policy { HugePages::TRANSPARENT };
+    return policy;
+}
+
+inline size_t roundUp(size_t bytes, size_t alignment) {
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+#if defined(__linux__)
+
+// Map 'roundUp(bytes, k_HUGE_PAGE_SIZE)' bytes aligned to the huge page size.
+inline void* mapPages(size_t bytes) {
+    size_t size = roundUp(bytes, k_HUGE_PAGE_SIZE);
+    HugePages policy = hugePagesPolicy().load(std::memory_order_relaxed);
+
+    if (policy == HugePages::EXPLICIT) {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) return p;
+        spdlog::warn("Failed to allocate {} MB from explicit huge pages. Fall back to transparent huge pages",
+                     size / (1024 * 1024));
+        policy = HugePages::TRANSPARENT;
+    }
+
+    // Over-allocate and trim the mapping to align it to the huge page size.
+    size_t mapped = size + k_HUGE_PAGE_SIZE;
+    void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+
+    auto begin = reinterpret_cast<uintptr_t>(p);
+    auto aligned = roundUp(begin, k_HUGE_PAGE_SIZE);
+    if (aligned > begin) munmap(p, aligned - begin);
+    size_t tail = begin + mapped - (aligned + size);
+    if (tail > 0) munmap(reinterpret_cast<void*>(aligned + size), tail);
+
+    if (policy == HugePages::TRANSPARENT) madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+    return reinterpret_cast<void*>(aligned);
+}
+
+inline void unmapPages(void* p, size_t bytes) {
+    munmap(p, roundUp(bytes, k_HUGE_PAGE_SIZE));
+}
+
+#endif
+
+} // namespace details
+
+// Set the huge page policy of the subsequent large allocations of AlignedAllocator.
+inline void setHugePages(HugePages policy) {
+    details::hugePagesPolicy().store(policy, std::memory_order_relaxed);
+}
+
+inline HugePages hugePages() {
+    return details::hugePagesPolicy().load(std::memory_order_relaxed);
+}
+
+// Touch every page in [p, p + bytes) without changing its content, so that the page faults
+// happen now and on the NUMA node of the calling thread.
+inline void prefault(void* p, size_t bytes) {
+    auto ptr = static_cast<volatile char*>(p);
+    for (size_t i = 0; i < bytes; i += details::k_PAGE_SIZE) ptr[i] = ptr[i];
+    if (bytes > 0) ptr[bytes - 1] = ptr[bytes - 1];
+}
+
+// An allocator for large numerical buffers.
+//
+// - The memory is aligned to 'Alignment' bytes.
+// - Elements are default-initialized, i.e. arithmetic values are not zeroed.
+// - Allocations of at least a huge page are mapped directly and follow the huge page policy.
+template<typename T, size_t Alignment = 64>
+class AlignedAllocator {
+
+    static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0);
+
+  public:
+
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    template<typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() noexcept = default;
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(size_t n) {
+        size_t bytes = n * sizeof(T);
+#if defined(__linux__)
+        if (bytes >= details::k_HUGE_PAGE_SIZE) return static_cast<T*>(details::mapPages(bytes));
+#endif
+        return static_cast<T*>(::operator new(bytes, std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        size_t bytes = n * sizeof(T);
+#if defined(__linux__)
+        if (bytes >= details::k_HUGE_PAGE_SIZE) {
+            details::unmapPages(p, bytes);
+            return;
+        }
+#endif
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template<typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new(static_cast<void*>(p)) U;
+    }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+} // namespace recastx::recon
+
+#endif // RECON_ALLOCATOR_H
\ No newline at end of file
@@ -10,9 +10,9 @@
 #define RECON_APPLICATION_H
 
 #include <complex>
-#include <condition_variable>
 #include <chrono>
 #include <cstdint>
+#include <future>
 #include <iostream>
 #include <optional>
 #include <thread>
@@ -25,7 +25,11 @@ extern "C" {
 }
 
 #include "common/config.hpp"
+#include "affinity.hpp"
 #include "buffer.hpp"
+#include "metrics.hpp"
+#include "preprocessing.hpp"
+#include "state_machine.hpp"
 #include "tensor.hpp"
 
 #include "control.pb.h"
@@ -41,8 +45,10 @@ extern "C" {
 namespace recastx::recon {
 
 class Monitor;
+class Pipeline;
 class Preprocessor;
 class ProjectionMediator;
+class Recorder;
 class RpcServer;
 class SliceMediator;
 class SinogramProxy;
@@ -76,22 +82,45 @@ class Application {
 
   private:
 
+    // Declared first so that it outlives everything which records into it.
+    Metrics metrics_;
+    Counter& projections_received_;
+    Counter& darks_received_;
+    Counter& flats_received_;
+    Counter& tomograms_reconstructed_;
+    Histogram& preprocessing_time_;
+    Histogram& upload_time_;
+    Histogram& volume_recon_time_;
+
     size_t group_size_ = 0;
-    // Why did I choose ProDtype over RawDtype?
-    MemoryBuffer<ProDtype, 3> raw_buffer_;
+    // Raw data are widened to ProDtype during preprocessing.
+    MemoryBuffer<RawDtype, 3> raw_buffer_;
 
     std::atomic_bool closing_ = false;
     bool pipeline_wait_on_slowness_ = false;
+    // Preprocess each projection as soon as it arrives instead of the whole chunk at once.
+    bool stream_preprocessing_ = false;
     std::vector<std::thread> consumer_threads_;
+    // Number of projections taken from the DAQ client and handled by the consumers.
+    std::atomic<size_t> num_consumed_ = 0;
+    // Whether the consumers should notify stopProcessing() of their progress.
+    std::atomic_bool draining_ = false;
 
     std::unique_ptr<Monitor> monitor_;
 
     std::mutex reciprocal_mtx_;
-    std::vector<RawImageData> darks_;
-    std::vector<RawImageData> flats_;
-    ProImageData dark_avg_;
-    ProImageData reciprocal_;
-    bool reciprocal_computed_ = false;
+    ImageAccumulator darks_;
+    ImageAccumulator flats_;
+    // Whether the accumulated darks and flats have been used to compute a flat field.
+    std::atomic_bool reciprocal_computed_ = false;
+
+    // The flat field used by the preprocessing. It is only replaced between two chunks, while a
+    // new one is computed into 'flat_field_back_', e.g. when darks and flats are re-acquired
+    // during processing.
+    std::mutex flat_field_mtx_;
+    std::shared_ptr<FlatField> flat_field_;
+    std::shared_ptr<FlatField> flat_field_back_;
+    std::future<void> flat_field_refresh_;
 
     std::unique_ptr<ProjectionMediator> proj_mediator_;
     std::unique_ptr<SliceMediator> slice_mediator_;
@@ -132,17 +161,25 @@ class Application {
     bool sino_uploaded_ = false;
     bool sino_initialized_ = false;
     std::mutex recon_mtx_;
-    std::condition_variable recon_cv_;
 
-    rpc::ServerState_State server_state_ = rpc::ServerState_State_UNKNOWN;
+    StateMachine<rpc::ServerState_State> server_state_ {rpc::ServerState_State_UNKNOWN};
     rpc::ScanMode_Mode scan_mode_;
     uint32_t scan_update_interval_;
 
     DaqClientInterface* daq_client_;
+    Recorder* recorder_ = nullptr;
+    PipelineAffinity affinity_;
     std::unique_ptr<RpcServer> rpc_server_;
 
+    std::unique_ptr<Pipeline> pipeline_;
+
+    // Stopped first since it evaluates the metrics of the other members.
+    std::unique_ptr<MetricsServer> metrics_server_;
+
     void init();
 
+    void registerMetrics();
+
     void checkParams();
 
     void initParams();
@@ -163,15 +200,28 @@ class Application {
 
     void consume();
 
+    // Whether all the projections received by the DAQ client have been handled.
+    [[nodiscard]] bool daqDrained() const;
+
+    void maybeStartStreaming();
+
+    bool preprocess();
+
+    bool fetchSinograms();
+
+    void uploadSinograms();
+
+    void reconstruct();
+
+    void reconstructOnDemand();
+
     bool tryComputeReciprocal();
 
-    bool waitForProcessing() const {
-        if (server_state_ != rpc::ServerState_State_PROCESSING) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            return true;
-        }
-        return false;
-    };
+    void computeFlatField(const ImageAccumulator& darks, const ImageAccumulator& flats);
+
+    void refreshFlatField();
+
+    std::shared_ptr<const FlatField> flatField();
 
 
   public:
@@ -200,13 +250,16 @@ class Application {
 
     void setPipelinePolicy(bool wait_on_slowness);
 
-    void startConsuming();
+    void setStreamPreprocessing(bool enabled) { stream_preprocessing_ = enabled; }
+
+    void setRecorder(Recorder* recorder) { recorder_ = recorder; }
 
-    void startPreprocessing();
+    void setCpuAffinity(const PipelineAffinity& affinity);
 
-    void startUploading();
+    // Serve the metrics in the text exposition format on the local port.
+    void exposeMetrics(int port);
 
-    void startReconstructing();
+    void startConsuming();
 
     void spin();
 
@@ -232,7 +285,10 @@ class Application {
 
     void stopProcessing();
 
-    [[nodiscard]] rpc::ServerState_State getServerState() const { return server_state_; }
+    [[nodiscard]] rpc::ServerState_State getServerState() const { return server_state_.get(); }
+
+    [[nodiscard]] const Metrics& metrics() const { return metrics_; }
+    Metrics& metrics() { return metrics_; }
 
     std::optional<rpc::ProjectionData> getProjectionData(int timeout);
 
@@ -246,9 +302,9 @@ class Application {
 
     // for unittest
 
-    [[nodiscard]] const std::vector<RawImageData>& darks() const { return darks_; }
-    [[nodiscard]] const std::vector<RawImageData>& flats() const { return flats_; }
-    [[nodiscard]] const MemoryBuffer<ProDtype, 3>& rawBuffer() const { return raw_buffer_; }
+    [[nodiscard]] const ImageAccumulator& darks() const { return darks_; }
+    [[nodiscard]] const ImageAccumulator& flats() const { return flats_; }
+    [[nodiscard]] const MemoryBuffer<RawDtype, 3>& rawBuffer() const { return raw_buffer_; }
     [[nodiscard]] const Reconstructor* reconstructor() const { return recon_.get(); }
 };
 
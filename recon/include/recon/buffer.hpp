@@ -9,20 +9,24 @@
 #ifndef RECON_BUFFER_H
 #define RECON_BUFFER_H
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <numeric>
 #include <queue>
-#include <shared_mutex>
 #include <thread>
 #include <type_traits>
+#include <vector>
 
 #include <spdlog/spdlog.h>
 
 #include "common/config.hpp"
+#include "simd.hpp"
 #include "tensor.hpp"
 
 namespace recastx::recon {
@@ -64,6 +68,7 @@ class TripleBuffer : public BufferInterface<T> {
 
     bool is_ready_ = false;
     std::condition_variable cv2_;
+    std::atomic<size_t> num_dropped_ = 0;
 
 protected:
 
@@ -93,6 +98,9 @@ public:
 
     const T& ready() const { return ready_; }
 
+    // Number of prepared data dropped by prepare() since construction.
+    [[nodiscard]] size_t numDropped() const { return num_dropped_; }
+
     T& back() { return back_; };
     const T& back() const { return back_; };
 };
@@ -121,6 +129,7 @@ bool TripleBuffer<T>::prepare() {
     {
         std::lock_guard lk(this->mtx_);
         dropped = is_ready_;
+        if (dropped) ++num_dropped_;
         this->swap(ready_, back_);
         is_ready_ = true;
     }
@@ -147,11 +156,11 @@ bool TripleBuffer<T>::tryPrepare(int timeout) {
 }
 
 template<typename T, size_t N>
-class TripleTensorBuffer : public TripleBuffer<Tensor<T, N>> {
+class TripleTensorBuffer : public TripleBuffer<AlignedTensor<T, N>> {
 
 public:
 
-    using BufferType = Tensor<T, N>;
+    using BufferType = AlignedTensor<T, N>;
     using ValueType = typename BufferType::value_type;
     using ShapeType = typename BufferType::ShapeType;
 
@@ -170,9 +179,10 @@ public:
 template<typename T, size_t N>
 void TripleTensorBuffer<T, N>::resize(const ShapeType& shape) {
     std::lock_guard lk(this->mtx_);
-    this->back_.resize(shape);
-    this->ready_.resize(shape);
-    this->front_.resize(shape);
+    for (auto buffer : {&this->back_, &this->ready_, &this->front_}) {
+        buffer->resize(shape);
+        buffer->prefault();
+    }
 }
 
 template<typename T, bool OD = false>
@@ -239,21 +249,87 @@ void SliceBuffer<T, OD>::resize(const ShapeType& shape) {
 namespace details {
 
 template<typename T, typename D>
-inline void copyToBuffer(T *dst, const char *src, const std::array<size_t, 2> &shape) {
-    D v;
-    for (size_t size = sizeof(D), i = 0; i < shape[0] * shape[1]; ++i) {
-        memcpy(&v, src, size);
-        src += size;
-        *(dst++) = static_cast<T>(v);
+inline constexpr bool k_SIMD_CONVERTIBLE = std::is_same_v<T, float> && std::is_same_v<D, uint16_t>;
+
+// dst[i] = src[i * stride] for i in [0, n).
+template<typename T, typename D>
+inline void convertRow(T *dst, const char *src, size_t n, size_t stride = 1) {
+    if constexpr (k_SIMD_CONVERTIBLE<T, D>) {
+        simd::convert(dst, reinterpret_cast<const uint16_t*>(src), n, stride);
+    } else if constexpr (std::is_same_v<T, D>) {
+        if (stride == 1) {
+            memcpy(dst, src, n * sizeof(T));
+            return;
+        }
+        for (size_t size = sizeof(D), i = 0; i < n; ++i) {
+            memcpy(dst++, src, size);
+            src += stride * size;
+        }
+    } else {
+        D v;
+        for (size_t size = sizeof(D), i = 0; i < n; ++i) {
+            memcpy(&v, src, size);
+            src += stride * size;
+            *(dst++) = static_cast<T>(v);
+        }
     }
 }
 
+// Average 'ds_r' x 'ds_c' blocks of the source rows starting at 'src' into 'n' pixels.
+//
+// The average is rounded if T is an integral type.
+template<typename T, typename D>
+inline void binRow(T *dst, const char *src, size_t src_cols, size_t n, size_t ds_r, size_t ds_c) {
+    thread_local std::vector<float> acc;
+    size_t size = n * ds_c;
+    acc.resize(size);
+    float scale = 1.f / static_cast<float>(ds_r * ds_c);
+    size_t row_bytes = src_cols * sizeof(D);
+    if constexpr (std::is_same_v<D, uint16_t>) {
+        simd::convert(acc.data(), reinterpret_cast<const uint16_t*>(src), size);
+        for (size_t k = 1; k < ds_r; ++k) {
+            simd::accumulate(acc.data(), reinterpret_cast<const uint16_t*>(src + k * row_bytes), size);
+        }
+    } else {
+        D v;
+        std::fill(acc.begin(), acc.end(), 0.f);
+        for (size_t k = 0; k < ds_r; ++k) {
+            const char* ptr = src + k * row_bytes;
+            for (size_t j = 0; j < size; ++j) {
+                memcpy(&v, ptr, sizeof(D));
+                ptr += sizeof(D);
+                acc[j] += static_cast<float>(v);
+            }
+        }
+    }
+
+    if constexpr (std::is_same_v<T, float>) {
+        simd::reduce(dst, acc.data(), n, ds_c, scale);
+    } else {
+        // Reduce in place. The j-th output never overwrites inputs of later outputs.
+        simd::reduce(acc.data(), acc.data(), n, ds_c, scale);
+        for (size_t j = 0; j < n; ++j) {
+            if constexpr (std::is_integral_v<T>) {
+                dst[j] = static_cast<T>(acc[j] + 0.5f);
+            } else {
+                dst[j] = static_cast<T>(acc[j]);
+            }
+        }
+    }
+}
+
+template<typename T, typename D>
+inline void copyToBuffer(T *dst, const char *src, const std::array<size_t, 2> &shape) {
+    convertRow<T, D>(dst, src, shape[0] * shape[1]);
+}
+
 template<typename T, typename D>
 inline void copyToBuffer(T *dst,
                          const std::array<size_t, 2> &dst_shape,
                          const char *src,
                          const std::array<size_t, 2> &src_shape,
-                         const std::array<size_t, 2> &downsampling) {
+                         const std::array<size_t, 2> &downsampling,
+                         DownsamplingMode mode = DownsamplingMode::DECIMATION) {
     if (src_shape == dst_shape) {
         assert(downsampling == (std::array < size_t, 2 > {1, 1}));
         copyToBuffer<T, D>(dst, src, dst_shape);
@@ -268,62 +344,113 @@ inline void copyToBuffer(T *dst,
     assert(dst_shape[0] >= rows_ds);
     assert(dst_shape[1] >= cols_ds);
 
-    D v;
     size_t padding_r = (dst_shape[0] - rows_ds) / 2;
     size_t padding_c = (dst_shape[1] - cols_ds) / 2;
-    for (size_t size = sizeof(D), i = 0; i < rows_ds; ++i) {
-        char* ptr_src = const_cast<char *>(src) + i * ds_r * size * src_shape[1];
+    size_t row_bytes = src_shape[1] * sizeof(D);
+    for (size_t i = 0; i < rows_ds; ++i) {
+        const char* ptr_src = src + i * ds_r * row_bytes;
         T *ptr_dst = dst + dst_shape[1] * (i + padding_r) + padding_c;
-        for (size_t j = 0; j < cols_ds; ++j) {
-            memcpy(&v, ptr_src, size);
-            ptr_src += ds_c * size;
-            *(ptr_dst++) = static_cast<T>(v);
+        if (mode == DownsamplingMode::BINNING) {
+            binRow<T, D>(ptr_dst, ptr_src, src_shape[1], cols_ds, ds_r, ds_c);
+        } else {
+            convertRow<T, D>(ptr_dst, ptr_src, cols_ds, ds_c);
         }
     }
 }
 
 } // details
 
+// A ring of chunks which are filled by multiple producers and fetched by a single consumer.
+//
+// Chunk 'c' is stored in slot 'c % capacity'. In the steady state, a frame is copied into its
+// slot with only atomic operations. The mutex is only taken once per chunk to register it, to
+// mark it as ready and to fetch it. The received frames of each chunk are tracked with a bitmap,
+// so that a duplicated frame does not complete a chunk.
 template<typename T, size_t N>
 class MemoryBuffer {
 
   public:
 
-    using BufferType = Tensor<T, N>;
+    using BufferType = AlignedTensor<T, N>;
     using ValueType = typename BufferType::ValueType;
     using ShapeType = typename BufferType::ShapeType;
 
   private:
 
-    std::shared_mutex data_mtx_;
+    static constexpr size_t k_EMPTY = std::numeric_limits<size_t>::max();
+    static constexpr size_t k_RECYCLING = k_EMPTY - 1;
+
+    struct Slot {
+        std::atomic<size_t> chunk = k_EMPTY;
+        // Number of threads accessing the data of the chunk.
+        std::atomic<size_t> users = 0;
+        std::atomic<size_t> count = 0;
+        std::unique_ptr<std::atomic<uint64_t>[]> received;
+        size_t num_words = 0;
+        BufferType data;
+        // Set when a thread is recycling the slot outside the lock for chunk 'next', which is
+        // protected by the lock.
+        std::atomic<bool> recycling = false;
+        size_t next = k_EMPTY;
+    };
+
     BufferType front_;
-    std::deque<BufferType> buffer_;
+    std::deque<Slot> slots_;
+
+    size_t chunk_size_ = 0;
+    std::array<size_t, N-1> data_shape_;
+    size_t data_size_ = 0;
 
-    std::mutex index_mtx_;
+    mutable std::mutex index_mtx_;
     std::condition_variable cv_;
-    bool is_ready_ = false;
-    std::queue<size_t> chunk_indices_;
-    std::unordered_map<size_t, size_t> map_;
-    std::queue<size_t> unoccupied_;
-    std::vector<size_t> counter_;
+    std::atomic<bool> is_ready_ = false;
+    // Registered chunks are [chunk_begin_, chunk_end_). Earlier chunks are outdated.
+    size_t chunk_begin_ = 0;
+    size_t chunk_end_ = 0;
+    size_t ready_chunk_ = 0;
+    size_t front_chunk_ = k_EMPTY;
+    // Added to the chunk index of a frame, so that the chunk indices keep increasing after the
+    // frame index restarts. Modified only under the lock.
+    std::atomic<size_t> chunk_offset_ = 0;
+    bool restart_expected_ = false;
+    // No chunk can be registered while the users of all the slots are waited for.
+    bool draining_ = false;
+    std::atomic<size_t> num_dropped_ = 0;
 #if (VERBOSITY >= 2)
-    size_t data_received_ = 0;
+    std::atomic<size_t> data_received_ = 0;
 #endif
 
     size_t capacity_;
 
-    void popChunk();
+    // Pin the slot if it holds the given chunk.
+    bool acquire(Slot& slot, size_t chunk_idx);
+
+    void release(Slot& slot) { slot.users.fetch_sub(1); }
+
+    // Assign a slot to a new chunk after all the users of the previous chunk have left.
+    void recycle(Slot& slot, size_t chunk_idx);
+
+    // Complete the recycling of a slot started by registerChunk() without holding the lock.
+    void completeRecycling(Slot& slot);
+
+    // Wait until no thread accesses any slot. The lock is released while waiting.
+    void drain(std::unique_lock<std::mutex>& lk);
 
     template<typename D>
-    void fillImp(size_t buffer_idx, 
+    void fillImp(Slot& slot,
                  size_t data_idx,
                  const char* src,
                  const std::array<size_t, N-1>& src_shape,
-                 const std::array<size_t, N-1>& downsampling);
+                 const std::array<size_t, N-1>& downsampling,
+                 DownsamplingMode mode);
+
+    // 'chunk_idx' is set to the index of the chunk of a frame in the given chunk of the data stream.
+    // 'recycle' is set if the caller must complete the recycling of the slot of the chunk.
+    bool registerChunk(size_t stream_chunk, size_t& chunk_idx, bool& recycle);
 
-    void registerChunk(size_t idx);
+    void dropChunks(size_t chunk_idx);
 
-    void update(size_t buffer_idx, size_t chunk_idx);
+    bool update(size_t chunk_idx);
 
   public:
 
@@ -333,50 +460,69 @@ class MemoryBuffer {
 
     void reset();
 
+    // Regard the next backward jump of the frame index as a restart, e.g. after darks and flats
+    // are re-acquired. The ready chunk can still be fetched. Chunks being filled are dropped once
+    // a chunk after the restart is ready. The restart is no longer expected once a frame of a chunk
+    // which is not outdated arrives.
+    void expectRestart();
+
+    // Returns true if the frame completes its chunk.
     template<typename D>
-    void fill(size_t index,
+    bool fill(size_t index,
               const char* src,
               const std::array<size_t, N-1>& shape,
-              const std::array<size_t, N-1>& downsampling);
+              const std::array<size_t, N-1>& downsampling,
+              DownsamplingMode mode = DownsamplingMode::DECIMATION) {
+        return fill<D>(index, src, shape, downsampling, mode, [](size_t, size_t, const T*) {});
+    }
+
+    // 'on_filled(chunk_idx, data_idx, data)' is called after the frame is copied and before it
+    // counts towards the completion of its chunk, i.e. the chunk cannot be fetched before it returns.
+    template<typename D, typename F>
+    bool fill(size_t index,
+              const char* src,
+              const std::array<size_t, N-1>& shape,
+              const std::array<size_t, N-1>& downsampling,
+              DownsamplingMode mode,
+              F&& on_filled);
 
     bool fetch(int timeout);
 
+    // Index of the chunk in front(). Only valid after a successful fetch.
+    [[nodiscard]] size_t frontChunk() const { return front_chunk_; }
+
     [[nodiscard]] bool isReady() const { return is_ready_; }
 
     BufferType& front() { return front_; }
     const BufferType& front() const { return front_; }
 
-    BufferType& ready() { return buffer_[map_.at(chunk_indices_.front())]; }
-    const BufferType& ready() const { return buffer_[map_.at(chunk_indices_.front())]; }
+    BufferType& ready() {
+        if (!is_ready_) throw std::out_of_range("[Image buffer] No chunk is ready");
+        return slots_[ready_chunk_ % capacity_].data;
+    }
+    const BufferType& ready() const {
+        if (!is_ready_) throw std::out_of_range("[Image buffer] No chunk is ready");
+        return slots_[ready_chunk_ % capacity_].data;
+    }
 
     [[nodiscard]] size_t capacity() const {
-        assert(capacity_ == buffer_.size());
+        assert(capacity_ == slots_.size());
         return capacity_;
     }
 
     [[nodiscard]] size_t occupied() const {
-        assert(capacity_ >= unoccupied_.size());
-        return capacity_ - unoccupied_.size();
+        std::lock_guard lk(index_mtx_);
+        return chunk_end_ - chunk_begin_;
     }
 
+    // Number of chunks dropped before being fetched since construction.
+    [[nodiscard]] size_t numDroppedChunks() const { return num_dropped_; }
+
     const ShapeType& shape() const { return front_.shape(); }
 
     [[nodiscard]] size_t size() const { return front_.size(); }
 };
 
-template<typename T, size_t N>
-void MemoryBuffer<T, N>::popChunk() {
-    size_t chunk_idx = chunk_indices_.front();
-    chunk_indices_.pop();
-
-    size_t buffer_idx = map_[chunk_idx];
-    counter_[buffer_idx] = 0;
-    unoccupied_.push(buffer_idx);
-    map_.erase(chunk_idx);
-
-    is_ready_ = !chunk_indices_.empty() && counter_[map_.at(chunk_indices_.front())] == front_.shape()[0];
-}
-
 template<typename T, size_t N>
 MemoryBuffer<T, N>::MemoryBuffer(int capacity) {
     if (capacity <= 0) {
@@ -385,35 +531,100 @@ MemoryBuffer<T, N>::MemoryBuffer(int capacity) {
         capacity_ = static_cast<size_t>(capacity);
     }
 
-    for (size_t i = 0; i < capacity_; ++i) {
-        buffer_.push_back(BufferType {});
-        counter_.push_back(0);
-        unoccupied_.push(i);
-    }
+    for (size_t i = 0; i < capacity_; ++i) slots_.emplace_back();
+    data_shape_.fill(0);
 }
 
 template<typename T, size_t N>
-void MemoryBuffer<T, N>::resize(const std::array<size_t, N>& shape) {
-    reset();
+bool MemoryBuffer<T, N>::acquire(Slot& slot, size_t chunk_idx) {
+    // Pairs with the check of 'users' in recycle().
+    slot.users.fetch_add(1);
+    if (slot.chunk.load() == chunk_idx) return true;
+    slot.users.fetch_sub(1);
+    return false;
+}
 
-    std::lock_guard lck(data_mtx_);
-    for (size_t i = 0; i < capacity_; ++i) buffer_[i].resize(shape, 0);
-    front_.resize(shape, 0);
+template<typename T, size_t N>
+void MemoryBuffer<T, N>::recycle(Slot& slot, size_t chunk_idx) {
+    slot.chunk.store(k_RECYCLING);
+    while (slot.users.load() != 0) std::this_thread::yield();
+
+    for (size_t i = 0; i < slot.num_words; ++i) slot.received[i].store(0, std::memory_order_relaxed);
+    slot.count.store(0, std::memory_order_relaxed);
+    slot.chunk.store(chunk_idx);
 }
 
 template<typename T, size_t N>
-void MemoryBuffer<T, N>::reset() {
+void MemoryBuffer<T, N>::completeRecycling(Slot& slot) {
+    // A projection being streamed can hold the slot for milliseconds.
+    while (slot.users.load() != 0) std::this_thread::yield();
+
+    for (size_t i = 0; i < slot.num_words; ++i) slot.received[i].store(0, std::memory_order_relaxed);
+    slot.count.store(0, std::memory_order_relaxed);
+
     std::lock_guard lk(index_mtx_);
+    // The chunk could have been dropped in the meanwhile.
+    size_t chunk_idx = slot.next;
+    bool registered = !draining_ && chunk_idx >= chunk_begin_ && chunk_idx < chunk_end_;
+    slot.chunk.store(registered ? chunk_idx : k_EMPTY);
+    slot.recycling = false;
+}
 
-    std::queue<size_t>().swap(chunk_indices_);
-    std::queue<size_t>().swap(unoccupied_);
-    map_.clear();
+template<typename T, size_t N>
+void MemoryBuffer<T, N>::drain(std::unique_lock<std::mutex>& lk) {
+    draining_ = true;
+    for (auto& slot : slots_) slot.chunk.store(k_RECYCLING);
+    chunk_begin_ = 0;
+    chunk_end_ = 0;
+    is_ready_ = false;
 
-    for (size_t i = 0; i < capacity_; ++i) {
-        counter_[i] = 0;
-        unoccupied_.push(i);
+    lk.unlock();
+    for (auto& slot : slots_) {
+        while (slot.users.load() != 0 || slot.recycling) std::this_thread::yield();
     }
+    lk.lock();
+
+    draining_ = false;
+}
 
+template<typename T, size_t N>
+void MemoryBuffer<T, N>::resize(const std::array<size_t, N>& shape) {
+    std::unique_lock lk(index_mtx_);
+    drain(lk);
+
+    chunk_size_ = shape[0];
+    std::copy(shape.begin() + 1, shape.end(), data_shape_.begin());
+    data_size_ = std::accumulate(data_shape_.begin(), data_shape_.end(), 1, std::multiplies<>());
+
+    size_t num_words = (chunk_size_ + 63) / 64;
+    // Zeroing the data, which keeps the padding around downsampled images blank, also faults
+    // in the pages on the NUMA node of the calling thread.
+    for (auto& slot : slots_) {
+        slot.data.resize(shape, 0);
+        slot.received.reset(new std::atomic<uint64_t>[num_words]);
+        slot.num_words = num_words;
+        recycle(slot, k_EMPTY);
+    }
+    front_.resize(shape, 0);
+
+    chunk_begin_ = 0;
+    chunk_end_ = 0;
+    chunk_offset_ = 0;
+    restart_expected_ = false;
+    is_ready_ = false;
+}
+
+template<typename T, size_t N>
+void MemoryBuffer<T, N>::reset() {
+    std::unique_lock lk(index_mtx_);
+    drain(lk);
+
+    for (auto& slot : slots_) recycle(slot, k_EMPTY);
+
+    chunk_begin_ = 0;
+    chunk_end_ = 0;
+    chunk_offset_ = 0;
+    restart_expected_ = false;
     is_ready_ = false;
 
 #if (VERBOSITY >= 2)
@@ -424,54 +635,64 @@ void MemoryBuffer<T, N>::reset() {
 }
 
 template<typename T, size_t N>
-template<typename D>
-void MemoryBuffer<T, N>::fill(size_t index,
+void MemoryBuffer<T, N>::expectRestart() {
+    std::lock_guard lk(index_mtx_);
+    restart_expected_ = true;
+}
+
+template<typename T, size_t N>
+template<typename D, typename F>
+bool MemoryBuffer<T, N>::fill(size_t index,
                               const char* src,
                               const std::array<size_t, N-1>& shape,
-                              const std::array<size_t, N-1>& downsampling) {
-    size_t chunk_size = front_.shape()[0];
-    size_t chunk_idx = index / chunk_size;
-    size_t data_idx = index % chunk_size;
-
-    std::unique_lock lk(index_mtx_);
-
-    if (chunk_indices_.empty()) {
-        registerChunk(chunk_idx);
-    } else if (chunk_idx > chunk_indices_.back()) {
-        for (size_t i = chunk_indices_.back() + 1; i <= chunk_idx; ++i) {
-            if (unoccupied_.empty()) {
-                int idx = chunk_indices_.front();
-                popChunk();
-                spdlog::warn("[Image buffer] Memory buffer is full! Chunk {} dropped!", idx);
-            }
-            registerChunk(i);
+                              const std::array<size_t, N-1>& downsampling,
+                              DownsamplingMode mode,
+                              F&& on_filled) {
+    size_t stream_chunk = index / chunk_size_;
+    size_t data_idx = index % chunk_size_;
+    size_t chunk_idx = stream_chunk + chunk_offset_.load();
+    Slot* slot = &slots_[chunk_idx % capacity_];
+
+    if (!acquire(*slot, chunk_idx)) {
+        bool recycle = false;
+        {
+            std::lock_guard lk(index_mtx_);
+            if (!registerChunk(stream_chunk, chunk_idx, recycle)) return false;
+        }
+        slot = &slots_[chunk_idx % capacity_];
+        if (recycle) completeRecycling(*slot);
+        // Wait if another thread is recycling the slot. The chunk could have been dropped in
+        // the meanwhile.
+        while (!acquire(*slot, chunk_idx)) {
+            if (slot->chunk.load() != k_RECYCLING) return false;
+            std::this_thread::yield();
         }
-    } else if (chunk_idx < chunk_indices_.front()) {
-        spdlog::warn("[Image buffer] Received projection with outdated chunk index: {}, data ignored!",
-                     chunk_idx);
-        return;
     }
 
-    size_t buffer_idx = map_[chunk_idx];
-    lk.unlock();
-
-    {
-        std::shared_lock data_lk(data_mtx_);
-        fillImp<D>(buffer_idx, data_idx, src, shape, downsampling);
+    uint64_t bit = uint64_t(1) << (data_idx % 64);
+    if (slot->received[data_idx / 64].fetch_or(bit) & bit) {
+        release(*slot);
+        spdlog::debug("[Image buffer] Received duplicated projection: {}, data ignored!", index);
+        return false;
     }
 
-    lk.lock();
-    update(buffer_idx, chunk_idx);
+    fillImp<D>(*slot, data_idx, src, shape, downsampling, mode);
+    on_filled(chunk_idx, data_idx, &slot->data[data_idx * data_size_]);
+
+    bool completed = slot->count.fetch_add(1) + 1 == chunk_size_;
+    release(*slot);
+    if (completed) completed = update(chunk_idx);
 
 #if (VERBOSITY >= 2)
-    // Outdated data are excluded.
-    ++data_received_;
-    if (data_received_ % chunk_size == 0) {
+    // Outdated and duplicated data are excluded.
+    size_t data_received = ++data_received_;
+    if (data_received % chunk_size_ == 0) {
         spdlog::info("[Image buffer] {}/{} chunks are occupied. {} of images received in total.",
-                     occupied(), buffer_.size(), data_received_);
+                     occupied(), capacity_, data_received);
     }
 #endif
 
+    return completed;
 }
 
 template<typename T, size_t N>
@@ -485,58 +706,111 @@ bool MemoryBuffer<T, N>::fetch(int timeout) {
         }
     }
 
-    assert(!map_.empty());
-    {
-        std::lock_guard data_lk(data_mtx_);
-        front_.swap(ready());
-    }
-    popChunk();
+    Slot& slot = slots_[ready_chunk_ % capacity_];
+    slot.chunk.store(k_RECYCLING);
+    while (slot.users.load() != 0) std::this_thread::yield();
+    front_.swap(slot.data);
+    front_chunk_ = ready_chunk_;
+    recycle(slot, k_EMPTY);
+
+    chunk_begin_ = ready_chunk_ + 1;
+    is_ready_ = false;
 
     return true;
 }
 
 template<typename T, size_t N>
 template<typename D>
-void MemoryBuffer<T, N>::fillImp(size_t buffer_idx, 
+void MemoryBuffer<T, N>::fillImp(Slot& slot,
                                  size_t data_idx,
                                  const char* src,
                                  const std::array<size_t, N-1>& src_shape,
-                                 const std::array<size_t, N-1>& downsampling) {
-    float* data = buffer_[buffer_idx].data();
-    std::array<size_t, N-1> dst_shape;
-    auto& buffer_shape = front_.shape();
-    std::copy(buffer_shape.begin() + 1, buffer_shape.end(), dst_shape.begin());
-    size_t data_size = std::accumulate(dst_shape.begin(), dst_shape.end(), 1, std::multiplies<>());
-    details::copyToBuffer<T, D>(&data[data_idx * data_size], dst_shape, src, src_shape, downsampling);
+                                 const std::array<size_t, N-1>& downsampling,
+                                 DownsamplingMode mode) {
+    T* data = slot.data.data();
+    details::copyToBuffer<T, D>(&data[data_idx * data_size_], data_shape_, src, src_shape, downsampling, mode);
 }
 
 template<typename T, size_t N>
-void MemoryBuffer<T, N>::registerChunk(size_t idx) {
-    chunk_indices_.push(idx);
-    map_[idx] = unoccupied_.front();
-    unoccupied_.pop();
+bool MemoryBuffer<T, N>::registerChunk(size_t stream_chunk, size_t& chunk_idx, bool& recycle) {
+    if (draining_) return false;
+
+    // The offset could have been changed since the caller read it.
+    chunk_idx = stream_chunk + chunk_offset_.load();
+    if (chunk_idx < chunk_begin_) {
+        // Otherwise, only a backward jump by more than the capacity is regarded as a restart of
+        // the frame index if there is no chunk being filled. Late frames are ignored.
+        if (!restart_expected_ && (chunk_end_ > chunk_begin_ || chunk_idx + capacity_ >= chunk_begin_)) {
+            spdlog::warn("[Image buffer] Received projection with outdated chunk index: {}, data ignored!",
+                         chunk_idx);
+            return false;
+        }
+        // Continue after the chunks in flight, whose slots must not be reused before they are
+        // dropped or fetched.
+        chunk_offset_ += chunk_end_ - chunk_idx;
+        chunk_idx = chunk_end_;
+        restart_expected_ = false;
+        spdlog::info("[Image buffer] Frame index restarted at chunk {}", stream_chunk);
+    } else {
+        // The frame index did not restart. Later backward jumps are late frames.
+        restart_expected_ = false;
+    }
+
+    if (chunk_end_ == chunk_begin_) {
+        // No chunk is registered.
+        chunk_begin_ = chunk_idx;
+        chunk_end_ = chunk_idx + 1;
+    } else if (chunk_idx >= chunk_end_) {
+        if (chunk_idx - chunk_begin_ >= capacity_) {
+            size_t begin = chunk_idx + 1 - capacity_;
+            spdlog::warn("[Image buffer] Memory buffer is full! Chunks [{}, {}) dropped!",
+                         chunk_begin_, std::min(begin, chunk_end_));
+            dropChunks(begin);
+        }
+        chunk_end_ = chunk_idx + 1;
+    }
+
+    Slot& slot = slots_[chunk_idx % capacity_];
+    if (slot.chunk.load() != chunk_idx) {
+        // The users of the previous chunk are waited for by the caller outside the lock. If the
+        // slot is already being recycled, its chunk is updated.
+        slot.next = chunk_idx;
+        if (!slot.recycling) {
+            slot.chunk.store(k_RECYCLING);
+            slot.recycling = true;
+            recycle = true;
+        }
+        spdlog::debug("[Image buffer] Registered chunk: {}", chunk_idx);
+    }
+    return true;
+}
 
-    spdlog::debug("[Image buffer] Registered chunk: {}", idx);
+template<typename T, size_t N>
+void MemoryBuffer<T, N>::dropChunks(size_t chunk_idx) {
+    // The slots of the dropped chunks are recycled lazily.
+    num_dropped_ += std::min(chunk_idx, chunk_end_) - chunk_begin_;
+    chunk_begin_ = chunk_idx;
+    if (is_ready_ && ready_chunk_ < chunk_begin_) is_ready_ = false;
 }
 
 template<typename T, size_t N>
-void MemoryBuffer<T, N>::update(size_t buffer_idx, size_t chunk_idx) {
-    ++counter_[buffer_idx];
+bool MemoryBuffer<T, N>::update(size_t chunk_idx) {
+    {
+        std::lock_guard lk(index_mtx_);
+        // The chunk could have been dropped or the buffer reset while it was being filled.
+        if (chunk_idx < chunk_begin_ || chunk_idx >= chunk_end_) return false;
 
-    // Caveat: We do not track the data indices. Therefore, if data with the same
-    //         frame idx arrives repeatedly, it will still fill the chunk.
-    if (counter_[buffer_idx] == front_.shape()[0]) {
         // Remove earlier chunks, no matter they are ready or not.
-        size_t idx = chunk_indices_.front();
-        while (chunk_idx != idx) {
-            popChunk();
-            spdlog::warn("[Image buffer] Chunk {} is ready! Earlier chunks {} ({}/{}) dropped!",
-                         chunk_idx, idx, counter_[map_[idx]], front_.shape()[0]);
-            idx = chunk_indices_.front();
+        if (chunk_idx > chunk_begin_) {
+            spdlog::warn("[Image buffer] Chunk {} is ready! Earlier chunks [{}, {}) dropped!",
+                         chunk_idx, chunk_begin_, chunk_idx);
+            dropChunks(chunk_idx);
         }
+        ready_chunk_ = chunk_idx;
         is_ready_ = true;
-        cv_.notify_one();
     }
+    cv_.notify_one();
+    return true;
 }
 
 } // namespace recastx::recon
@@ -0,0 +1,177 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_BUFFERPOOL_H
+#define RECON_BUFFERPOOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace recastx::recon {
+
+// A bounded pool of recycled fixed-size buffers.
+//
+// A buffer returns to the pool when the last reference to it is released. At most 'capacity'
+// buffers of the current size exist at any time, and acquiring a buffer waits while all of them
+// are in use. Buffers can outlive the pool.
+template<typename T>
+class BufferPool {
+
+    static constexpr size_t K_ALIGNMENT = 64;
+    static constexpr size_t K_PAGE_SIZE = 4096;
+
+    struct State {
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<T*> free;
+        size_t buffer_size;
+        size_t capacity;
+        // Number of buffers of the current size, either free or in use.
+        size_t num_allocated = 0;
+        // Buffers acquired before the last resize do not return to the pool.
+        size_t generation = 0;
+
+        State(size_t buffer_size, size_t capacity) : buffer_size(buffer_size), capacity(capacity) {}
+
+        ~State() { for (auto ptr : free) std::free(ptr); }
+    };
+
+    std::shared_ptr<State> state_;
+
+    static T* allocate(size_t size) {
+        size_t bytes = (size * sizeof(T) + K_ALIGNMENT - 1) / K_ALIGNMENT * K_ALIGNMENT;
+        auto ptr = static_cast<T*>(std::aligned_alloc(K_ALIGNMENT, bytes));
+        if (ptr == nullptr) throw std::bad_alloc();
+        // Touch every page so that no page fault happens when the buffer is used.
+        auto p = reinterpret_cast<volatile char*>(ptr);
+        for (size_t i = 0; i < bytes; i += K_PAGE_SIZE) p[i] = 0;
+        return ptr;
+    }
+
+    // Return a buffer to the pool. A nullptr gives back the slot of a failed allocation.
+    static void release(const std::shared_ptr<State>& s, T* p, size_t generation) {
+        bool recycled = false;
+        {
+            std::lock_guard lk(s->mtx);
+            if (s->generation == generation) {
+                if (p != nullptr) {
+                    s->free.push_back(p);
+                } else {
+                    --s->num_allocated;
+                }
+                recycled = true;
+            }
+        }
+        if (recycled) {
+            s->cv.notify_one();
+        } else {
+            std::free(p);
+        }
+    }
+
+  public:
+
+    BufferPool(size_t buffer_size, size_t capacity)
+        : state_(std::make_shared<State>(buffer_size, capacity)) {}
+
+    // Returns a buffer of size 'bufferSize()', or nullptr if all the buffers are still in use
+    // after 'timeout' milliseconds. Wait forever if 'timeout' is negative. The content of the
+    // buffer is undefined.
+    std::shared_ptr<T> acquire(int timeout = -1) {
+        T* ptr = nullptr;
+        size_t size;
+        size_t generation;
+        {
+            std::unique_lock lk(state_->mtx);
+            auto available = [this] {
+                return !state_->free.empty() || state_->num_allocated < state_->capacity;
+            };
+            if (timeout < 0) {
+                state_->cv.wait(lk, available);
+            } else if (!state_->cv.wait_for(lk, std::chrono::milliseconds(timeout), available)) {
+                return nullptr;
+            }
+
+            size = state_->buffer_size;
+            generation = state_->generation;
+            if (!state_->free.empty()) {
+                ptr = state_->free.back();
+                state_->free.pop_back();
+            } else {
+                ++state_->num_allocated;
+            }
+        }
+
+        if (ptr == nullptr) {
+            try {
+                ptr = allocate(size);
+            } catch (...) {
+                release(state_, nullptr, generation);
+                throw;
+            }
+        }
+
+        std::weak_ptr<State> state = state_;
+        return std::shared_ptr<T>(ptr, [state, generation](T* p) {
+            if (auto s = state.lock()) {
+                release(s, p, generation);
+            } else {
+                std::free(p);
+            }
+        });
+    }
+
+    // Pre-allocate free buffers up to the capacity.
+    void reserve() {
+        std::lock_guard lk(state_->mtx);
+        while (state_->num_allocated < state_->capacity) {
+            state_->free.push_back(allocate(state_->buffer_size));
+            ++state_->num_allocated;
+        }
+        state_->cv.notify_all();
+    }
+
+    // Change the buffer size. Free buffers are released and buffers of the previous size
+    // will not return to the pool.
+    void resize(size_t buffer_size) {
+        std::lock_guard lk(state_->mtx);
+        if (buffer_size == state_->buffer_size) return;
+        for (auto ptr : state_->free) std::free(ptr);
+        state_->free.clear();
+        state_->num_allocated = 0;
+        ++state_->generation;
+        state_->buffer_size = buffer_size;
+        state_->cv.notify_all();
+    }
+
+    [[nodiscard]] size_t bufferSize() const {
+        std::lock_guard lk(state_->mtx);
+        return state_->buffer_size;
+    }
+
+    [[nodiscard]] size_t numFree() const {
+        std::lock_guard lk(state_->mtx);
+        return state_->free.size();
+    }
+
+    [[nodiscard]] size_t numAllocated() const {
+        std::lock_guard lk(state_->mtx);
+        return state_->num_allocated;
+    }
+
+    [[nodiscard]] size_t capacity() const { return state_->capacity; }
+};
+
+} // namespace recastx::recon
+
+#endif // RECON_BUFFERPOOL_H
\ No newline at end of file
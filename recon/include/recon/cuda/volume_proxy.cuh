@@ -34,6 +34,8 @@ public:
         return buffer_.prepare();
     }
 
+    [[nodiscard]] size_t numDropped() const { return buffer_.numDropped(); }
+
     Data3D fetchData(int timeout) {
         bool has_data = buffer_.fetch(timeout);
         if (has_data) {
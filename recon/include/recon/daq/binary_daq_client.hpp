@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_BINARYDAQCLIENT_H
+#define RECON_BINARYDAQCLIENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "zmq_daq_client.hpp"
+
+namespace recastx::recon {
+
+// Fixed-layout header of the "binary" data protocol. All the fields are little-endian.
+struct BinaryFrameHeader {
+
+    static constexpr uint32_t MAGIC = 0x48465852; // "RXFH"
+    static constexpr uint16_t VERSION = 1;
+
+    enum Dtype : uint16_t { UINT8 = 1, UINT16 = 2, FLOAT32 = 3 };
+
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    uint16_t dtype = UINT16;
+    uint64_t frame = 0;
+    int32_t scan_index = 0;
+    uint32_t num_rows = 0;
+    uint32_t num_cols = 0;
+    uint32_t reserved = 0;
+};
+
+static_assert(sizeof(BinaryFrameHeader) == 32);
+static_assert(offsetof(BinaryFrameHeader, frame) == 8);
+static_assert(offsetof(BinaryFrameHeader, scan_index) == 16);
+static_assert(offsetof(BinaryFrameHeader, num_rows) == 20);
+static_assert(offsetof(BinaryFrameHeader, num_cols) == 24);
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The binary data protocol requires a little-endian host");
+
+class BinaryDaqClient : public ZmqDaqClient {
+
+  protected:
+
+    std::optional<Projection<>> parse(const zmq::message_t& header, zmq::message_t&& data) override;
+
+  public:
+
+    BinaryDaqClient(const std::string& endpoint, const std::string& socket_type, size_t concurrency = 1,
+                    const ZmqClientConfig& config = {});
+};
+
+} // namespace recastx::recon
+
+#endif // RECON_BINARYDAQCLIENT_H
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include <queue>
 
 #include "recon/projection.hpp"
+#include "recon/state_machine.hpp"
 
 namespace recastx::recon {
 
@@ -21,7 +22,8 @@ class DaqClientInterface {
 
     size_t concurrency_;
 
-    bool acquiring_ = false;
+    // Receiving threads and next() wait on it when not acquiring.
+    StateMachine<bool> acquiring_ {false};
     uint32_t num_rows_ {0};
     uint32_t num_cols_ {0};
 
@@ -54,19 +56,26 @@ class DaqClientInterface {
     virtual void spin() = 0;
 
     virtual void setAcquiring(bool state) {
-        acquiring_ = state;
         num_rows_ = 0;
         num_cols_ = 0;
+        acquiring_.set(state);
     }
 
     virtual void startAcquiring(uint32_t num_rows, uint32_t num_cols) {
-        acquiring_ = true;
         num_rows_ = num_rows;
         num_cols_ = num_cols;
+        acquiring_.set(true);
     }
 
     [[nodiscard]] virtual bool next(Projection<>& proj) = 0;
 
+    // Number of received projections which are waiting to be taken by next().
+    [[nodiscard]] virtual size_t numQueued() const { return 0; }
+
+    // Number of projections taken by next() since construction. A projection is no longer queued
+    // once it is counted here.
+    [[nodiscard]] virtual size_t numTaken() const = 0;
+
     [[nodiscard]] size_t concurrency() const { return concurrency_; }
 };
 
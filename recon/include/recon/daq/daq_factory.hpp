@@ -11,17 +11,30 @@
 
 #include <memory>
 #include <string>
+#include <type_traits>
 
 #include <spdlog/spdlog.h>
 
 #include "std_daq_client.hpp"
+#include "binary_daq_client.hpp"
+#include "replay_daq_client.hpp"
 
 namespace recastx::recon {
 
 template<typename ...Ts>
 std::unique_ptr<DaqClientInterface> createDaqClient(std::string_view protocol, Ts... args) {
-    if (protocol == "default") {
-      return std::make_unique<StdDaqClient>(std::forward<Ts>(args)...); 
+    if constexpr (std::is_constructible_v<StdDaqClient, Ts...>) {
+        if (protocol == "default") {
+          return std::make_unique<StdDaqClient>(std::forward<Ts>(args)...); 
+        }
+        if (protocol == "binary") {
+          return std::make_unique<BinaryDaqClient>(std::forward<Ts>(args)...);
+        }
+    }
+    if constexpr (std::is_constructible_v<ReplayDaqClient, Ts...>) {
+        if (protocol == "replay") {
+          return std::make_unique<ReplayDaqClient>(std::forward<Ts>(args)...);
+        }
     }
 
     throw std::runtime_error(fmt::format("Unknown DAQ client protocol: {}", protocol));
@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_RAWSTREAM_H
+#define RECON_RAWSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace recastx::recon {
+
+// A raw stream consists of a data file and an index file (<data file>.idx).
+//
+// The data file contains the raw image data of the frames in arrival order. The index file
+// starts with a RawStreamHeader followed by one RawStreamIndexEntry per frame. Both files are
+// append-only and all the fields are little-endian. A trailing incomplete entry in the index
+// file is ignored by the reader.
+
+struct RawStreamHeader {
+
+    static constexpr uint32_t MAGIC = 0x49525852; // "RXRI"
+    static constexpr uint16_t VERSION = 1;
+
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    uint16_t dtype = 2; // uint16, same code as in BinaryFrameHeader
+    uint32_t entry_size = 0;
+    uint32_t reserved = 0;
+};
+
+struct RawStreamIndexEntry {
+    uint64_t offset = 0; // offset of the image data in the data file
+    uint64_t frame = 0;
+    int32_t scan_index = 0;
+    uint32_t num_rows = 0;
+    uint32_t num_cols = 0;
+    uint32_t reserved = 0;
+    uint64_t timestamp = 0; // arrival time in nanoseconds
+};
+
+static_assert(sizeof(RawStreamHeader) == 16);
+static_assert(sizeof(RawStreamIndexEntry) == 40);
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "The raw stream format requires a little-endian host");
+
+inline std::string rawStreamIndexPath(const std::string& data_path) { return data_path + ".idx"; }
+
+} // namespace recastx::recon
+
+#endif // RECON_RAWSTREAM_H
\ No newline at end of file
@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_REPLAYDAQCLIENT_H
+#define RECON_REPLAYDAQCLIENT_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "daq_client_interface.hpp"
+#include "raw_stream.hpp"
+
+namespace recastx::recon {
+
+// Replay a recorded raw stream from a memory-mapped file.
+class ReplayDaqClient : public DaqClientInterface {
+
+    using clock = std::chrono::steady_clock;
+
+    std::shared_ptr<const void> mapping_;
+    size_t file_size_ = 0;
+
+    std::vector<RawStreamIndexEntry> entries_;
+    // Indices of the projections in entries_, which are replayed repeatedly when looping.
+    std::vector<size_t> projections_;
+
+    double speed_;
+    bool loop_;
+
+    // Timestamps (in ns) of the first frame and the first projection.
+    uint64_t t0_ = 0;
+    uint64_t proj_t0_ = 0;
+    // Durations (in ns) of the first pass and of each following loop.
+    uint64_t first_duration_ = 0;
+    uint64_t loop_duration_ = 0;
+    // Frame index offset of each loop.
+    uint64_t loop_frame_span_ = 0;
+
+    std::atomic<size_t> cursor_ = 0;
+    std::atomic<size_t> taken_ = 0;
+    // Number of frames being taken by next().
+    std::atomic<size_t> pending_ = 0;
+    std::mutex mtx_;
+    clock::time_point start_;
+
+    void readIndex(const std::string& path);
+
+    void mapData(const std::string& path);
+
+    void initLoop();
+
+    void restart();
+
+    // Returns the entry, the loop number and the time (in ns) since the start of the replay
+    // of the i-th frame.
+    [[nodiscard]] bool locate(size_t i, const RawStreamIndexEntry*& entry, size_t& loop, uint64_t& t) const;
+
+  public:
+
+    // speed: the replay speed relative to the recording. 0 for as fast as possible.
+    // loop: replay the projections repeatedly after all the frames have been replayed.
+    explicit ReplayDaqClient(const std::string& path, double speed = 0., bool loop = false, size_t concurrency = 1);
+
+    void spin() override;
+
+    [[nodiscard]] bool next(Projection<>& proj) override;
+
+    [[nodiscard]] size_t numQueued() const override { return pending_; }
+
+    [[nodiscard]] size_t numTaken() const override { return taken_; }
+
+    void setAcquiring(bool state) override;
+
+    void startAcquiring(uint32_t num_rows, uint32_t num_cols) override;
+
+    [[nodiscard]] size_t size() const { return entries_.size(); }
+};
+
+} // namespace recastx::recon
+
+#endif // RECON_REPLAYDAQCLIENT_H
\ No newline at end of file
@@ -9,19 +9,29 @@
 #ifndef RECON_STDDAQCLIENT_H
 #define RECON_STDDAQCLIENT_H
 
+#include <optional>
 #include <string>
 
+#include <nlohmann/json.hpp>
+
 #include "zmq_daq_client.hpp"
 
 namespace recastx::recon {
 
 class StdDaqClient : public ZmqDaqClient {
 
-  public:
+  protected:
+
+    std::optional<nlohmann::json> parseMeta(const zmq::message_t& msg);
 
-    StdDaqClient(const std::string& endpoint, const std::string& socket_type, size_t concurrency = 1);
+    std::optional<Projection<>> parseData(const nlohmann::json& meta, zmq::message_t&& msg);
+
+    std::optional<Projection<>> parse(const zmq::message_t& header, zmq::message_t&& data) override;
+
+  public:
 
-    std::optional<Projection<>> parseData(const nlohmann::json& meta, const zmq::message_t& msg) override;
+    StdDaqClient(const std::string& endpoint, const std::string& socket_type, size_t concurrency = 1,
+                 const ZmqClientConfig& config = {});
 };
 
 } // namespace recastx::recon
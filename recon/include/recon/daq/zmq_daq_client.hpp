@@ -9,42 +9,66 @@
 #ifndef RECON_ZMQDAQCLIENT_H
 #define RECON_ZMQDAQCLIENT_H
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include <zmq.hpp>
 #include <spdlog/spdlog.h>
-#include <nlohmann/json.hpp>
 
 #include "daq_client_interface.hpp"
-#include "common/queue.hpp"
+#include "common/ring_queue.hpp"
+#include "recon/affinity.hpp"
+#include "recon/buffer_pool.hpp"
 #include "recon/projection.hpp"
 
 namespace recastx::recon {
 
+struct ZmqClientConfig {
+    int io_threads = 1;
+    int rcvhwm = 1;
+    int rcvbuf = -1; // use the OS default
+    // Number of recycled frame buffers. If 0, projections refer to the received messages directly.
+    size_t pool_size = 0;
+    // CPUs of the ZMQ I/O threads and the receiving threads.
+    CpuSet cpus;
+};
+
 class ZmqDaqClient : public DaqClientInterface {
 
     [[nodiscard]] zmq::socket_type parseSocketType(const std::string& socket_type) const;
 
+    void receive(zmq::socket_t& socket);
+
   protected:
 
-    ThreadSafeQueue<Projection<>> buffer_;
+    RingQueue<Projection<>> buffer_;
 
     zmq::context_t context_;
-    zmq::socket_t socket_;
+    // Each receiving thread owns one socket.
+    std::vector<zmq::socket_t> sockets_;
+    std::vector<std::thread> threads_;
 
-    std::mutex mtx_;
+    std::atomic_bool running_ = false;
 
-    bool running_ = false;
+    // At most 'pool_size' frames are held by the projections in flight.
+    std::unique_ptr<BufferPool<RawDtype>> pool_;
 
-    virtual std::optional<nlohmann::json> parseMeta(const zmq::message_t& msg);
+    CpuSet cpus_;
 
-    virtual std::optional<Projection<>> parseData(const nlohmann::json& meta, const zmq::message_t& msg) = 0;
+    // Copy the data to a pooled buffer. Returns false if the client stopped while waiting for
+    // a free buffer.
+    bool recycle(Projection<>& proj);
+
+    // Parse a multipart message which consists of a header (metadata) part and a data part.
+    virtual std::optional<Projection<>> parse(const zmq::message_t& header, zmq::message_t&& data) = 0;
 
   public:
 
-    ZmqDaqClient(const std::string& endpoint, const std::string& socket_type, size_t concurrency);
+    ZmqDaqClient(const std::string& endpoint, const std::string& socket_type, size_t concurrency,
+                 const ZmqClientConfig& config = {});
 
     ~ZmqDaqClient() override;
 
@@ -52,6 +76,10 @@ class ZmqDaqClient : public DaqClientInterface {
 
     [[nodiscard]] bool next(Projection<>& proj) override;
 
+    [[nodiscard]] size_t numQueued() const override;
+
+    [[nodiscard]] size_t numTaken() const override;
+
     void setAcquiring(bool state) override;
 
     void startAcquiring(uint32_t num_rows, uint32_t num_cols) override;
@@ -45,13 +45,13 @@ inline std::vector<rpc::ReconData> createVolumeDataPacket(const ProDtype* ptr, u
     return packets;
 }
 
-template<typename Container>
-inline rpc::ProjectionData createProjectionDataPacket(uint32_t id, uint32_t x, uint32_t y, const Container& data) {
+inline rpc::ProjectionData createProjectionDataPacket(uint32_t id, uint32_t x, uint32_t y,
+                                                      const void* data, size_t size) {
     rpc::ProjectionData packet;
     packet.set_id(id);
     packet.set_col_count(x);
     packet.set_row_count(y);
-    packet.set_data(data.data(), data.size() * sizeof(typename Container::value_type));
+    packet.set_data(data, size);
     return packet;
 }
 
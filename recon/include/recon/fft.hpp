@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_FFT_H
+#define RECON_FFT_H
+
+#include <string>
+
+namespace recastx::recon {
+
+enum class FftPlanning {
+    ESTIMATE = 0, // heuristic plans, created instantly
+    MEASURE = 1, // plans measured on the machine, which takes up to seconds for a new size
+    PATIENT = 2 // plans measured more extensively, which takes up to minutes for a new size
+};
+
+// Set the planning mode of the subsequently created FFT plans.
+//
+// Except for FftPlanning::ESTIMATE, the input and output arrays are overwritten during planning.
+void setFftPlanning(FftPlanning mode);
+
+FftPlanning fftPlanning();
+
+// FFTW planner flags of the current planning mode.
+unsigned fftPlanningFlags();
+
+// Set the file which caches the FFTW wisdom and import the wisdom from it if it exists.
+//
+// The wisdom is cached per number of threads which run the plans concurrently, since they compete
+// for the caches and memory bandwidth that the measured plans are tuned to. Returns false if no
+// wisdom is imported.
+bool setFftWisdomFile(const std::string& path, size_t num_threads);
+
+// Export the FFTW wisdom to the cache file if it has changed since it was imported or exported.
+void saveFftWisdom();
+
+} // namespace recastx::recon
+
+#endif // RECON_FFT_H
\ No newline at end of file
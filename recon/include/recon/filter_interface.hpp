@@ -10,6 +10,9 @@
 #define RECON_FILTERINTERFACE_H
 
 #include <memory>
+#include <string>
+
+#include "common/config.hpp"
 
 namespace recastx::recon {
 
@@ -20,6 +23,12 @@ class Filter {
     virtual ~Filter() = default;
 
     virtual void apply(float* data, int buffer_index) = 0;
+
+    // Filter 'num_rows' consecutive rows of a projection starting at 'data'. 'num_rows' must be
+    // a multiple of rowAlignment() unless the rows end the projection.
+    virtual void applyRows(float* data, int num_rows, int buffer_index) = 0;
+
+    [[nodiscard]] virtual int rowAlignment() const { return 1; }
 };
 
 class FilterFactory {
@@ -29,7 +38,13 @@ class FilterFactory {
     virtual ~FilterFactory() = default;
 
     virtual std::unique_ptr<Filter> create(const std::string& name, 
-                                           float* data, int num_cols, int num_rows, int buffer_size) = 0;
+                                           float* data, int num_cols, int num_rows, int buffer_size,
+                                           RampFilterPadding padding) = 0;
+
+    std::unique_ptr<Filter> create(const std::string& name,
+                                   float* data, int num_cols, int num_rows, int buffer_size) {
+        return create(name, data, num_cols, num_rows, buffer_size, RampFilterPadding::NONE);
+    }
 
 };
 
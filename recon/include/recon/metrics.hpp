@@ -0,0 +1,227 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_METRICS_H
+#define RECON_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace recastx::recon {
+
+namespace details {
+
+inline constexpr size_t k_METRICS_SHARDS = 16;
+
+// Threads are assigned to the shards in turn, so that threads recording the same metric rarely
+// share a cache line.
+size_t metricsShard();
+
+} // namespace details
+
+// A monotonic counter which can be incremented by many threads without contention.
+class Counter {
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value = 0;
+    };
+
+    std::array<Shard, details::k_METRICS_SHARDS> shards_;
+
+  public:
+
+    void add(uint64_t n = 1) {
+        shards_[details::metricsShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t value() const;
+};
+
+// A latency histogram with log-linear buckets as in HdrHistogram.
+//
+// Values (in microseconds) are exact below 2 * k_SUB_BUCKETS. Above, every power-of-two range is
+// split into k_SUB_BUCKETS buckets, which bounds the relative error of the quantiles to
+// 1 / k_SUB_BUCKETS. Values above k_MAX_VALUE are clamped.
+class Histogram {
+
+  public:
+
+    static constexpr size_t k_SUB_BUCKET_BITS = 3;
+    static constexpr size_t k_SUB_BUCKETS = size_t(1) << k_SUB_BUCKET_BITS;
+    static constexpr uint64_t k_MAX_VALUE = (uint64_t(1) << 32) - 1;
+    static constexpr size_t k_NUM_BUCKETS = (32 - k_SUB_BUCKET_BITS + 1) * k_SUB_BUCKETS;
+    // Seconds per recorded unit. The metrics are exported in seconds.
+    static constexpr double k_SECONDS = 1e-6;
+
+    struct Snapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+
+        // Returns the upper bound of the bucket which contains the q-quantile (0 <= q <= 1).
+        [[nodiscard]] uint64_t quantile(double q) const;
+    };
+
+  private:
+
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, k_NUM_BUCKETS> buckets {};
+        std::atomic<uint64_t> count = 0;
+        std::atomic<uint64_t> sum = 0;
+    };
+
+    std::unique_ptr<Shard[]> shards_;
+
+  public:
+
+    Histogram();
+
+    static size_t bucketIndex(uint64_t value);
+
+    // The largest value falling into the bucket.
+    static uint64_t bucketUpperBound(size_t index);
+
+    void record(uint64_t value) {
+        if (value > k_MAX_VALUE) value = k_MAX_VALUE;
+        auto& shard = shards_[details::metricsShard()];
+        shard.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] Snapshot snapshot() const;
+};
+
+// Record the lifetime of the scope (in microseconds) into a histogram.
+class LatencyTimer {
+
+    using clock = std::chrono::steady_clock;
+
+    Histogram& hist_;
+    const clock::time_point start_;
+
+  public:
+
+    explicit LatencyTimer(Histogram& hist) : hist_(hist), start_(clock::now()) {}
+
+    ~LatencyTimer() {
+        hist_.record(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start_).count());
+    }
+
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+};
+
+// Registry of the metrics of the reconstruction server.
+//
+// Counters and histograms are owned by the registry and recorded directly on the hot path.
+// Values which are already tracked somewhere else, e.g. the depth of a queue, are registered
+// as callbacks and only evaluated when the metrics are collected.
+class Metrics {
+
+  public:
+
+    enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    struct Sample {
+        std::string name;
+        std::string help;
+        Type type;
+        Labels labels;
+        // Counters and gauges.
+        double value = 0.;
+        // Histograms.
+        Histogram::Snapshot histogram;
+    };
+
+  private:
+
+    struct Entry {
+        Labels labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> callback;
+    };
+
+    struct Family {
+        std::string help;
+        Type type;
+        std::map<std::string, Entry> entries;
+    };
+
+    std::map<std::string, Family> families_;
+    mutable std::mutex mtx_;
+
+    Entry& entry(const std::string& name, const std::string& help, Type type, const Labels& labels);
+
+  public:
+
+    // The quantiles of the histograms in the text exposition.
+    static constexpr std::array<double, 4> k_QUANTILES {0.5, 0.9, 0.99, 0.999};
+
+    // Returns the counter with the given name and labels, which is created on first use.
+    Counter& counter(const std::string& name, const std::string& help, const Labels& labels = {});
+
+    // Register a counter which is maintained elsewhere.
+    void counter(const std::string& name, const std::string& help,
+                 std::function<double()> callback, const Labels& labels = {});
+
+    // Register a gauge which is evaluated on collection.
+    void gauge(const std::string& name, const std::string& help,
+               std::function<double()> callback, const Labels& labels = {});
+
+    // Returns the histogram with the given name and labels, which is created on first use.
+    Histogram& histogram(const std::string& name, const std::string& help, const Labels& labels = {});
+
+    [[nodiscard]] std::vector<Sample> collect() const;
+
+    // Render the metrics in the Prometheus text exposition format. Histograms are rendered as
+    // summaries with the quantiles in k_QUANTILES (in seconds).
+    [[nodiscard]] std::string exposition() const;
+};
+
+// Serve the text exposition of the metrics over HTTP on the loopback interface.
+class MetricsServer {
+
+    const Metrics& metrics_;
+    int fd_ = -1;
+    std::atomic_bool running_ = false;
+    std::thread thread_;
+
+    void serve();
+
+    void respond(int conn);
+
+  public:
+
+    MetricsServer(int port, const Metrics& metrics);
+
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // The port the server is listening on, which is picked by the OS if 0 is given.
+    [[nodiscard]] int port() const;
+};
+
+} // namespace recastx::recon
+
+#endif // RECON_METRICS_H
\ No newline at end of file
@@ -16,9 +16,13 @@ extern "C" {
 #include <fftw3.h>
 }
 
+#include "allocator.hpp"
+
 namespace recastx::recon {
 
 namespace details {
+    // Paganin filter laid out like the r2c half-spectrum of a 'num_rows' x 'num_cols' image,
+    // i.e. 'num_rows' x (num_cols / 2 + 1). The normalization of the inverse FFT is included.
     std::vector<float> paganinFilter(
         float pixel_size, float lambda, float delta, float beta, float distance, 
         int num_cols, int num_rows);
@@ -33,18 +37,38 @@ class Paganin {
 
     int num_cols_;
     int num_rows_;
+    int num_freqs_; // size of the half-spectrum of a row
+
+    using SpectrumType = std::vector<std::complex<float>, AlignedAllocator<std::complex<float>>>;
+
+    static constexpr int k_BLOCK_ROWS = 16;
 
     fftwf_plan fft2d_plan_;
-    fftwf_plan ffti2d_plan_;
-    std::vector<std::vector<std::complex<float>>> freq_;
+    // The inverse transform is split into a transform along the columns and blocks of row
+    // transforms, so that the log and scale pass runs on each block while it is still in cache.
+    fftwf_plan ffti_col_plan_;
+    fftwf_plan ffti_row_plan_;
+    fftwf_plan ffti_row_tail_plan_ = nullptr;
+    int block_rows_;
+    // One spectrum per worker.
+    std::vector<SpectrumType> freq_;
     std::vector<float> filter_;
 
+    bool fast_log_;
+
   public:
 
     Paganin(float pixel_size, float lambda, float delta, float beta, float distance, 
-            float* data, int num_cols, int num_rows);
+            float* data, int num_cols, int num_rows, int buffer_size, bool fast_log = false);
+
+    ~Paganin();
+
+    Paganin(const Paganin&) = delete;
+    Paganin& operator=(const Paganin&) = delete;
 
-    void apply(float* data, int idx=1);
+    // Retrieve the phase of a flat-field corrected projection in place. 'buffer_index' must be
+    // unique among the concurrent calls, e.g. the thread index in the arena.
+    void apply(float* data, int buffer_index);
 
 };
 
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_PIPELINE_H
+#define RECON_PIPELINE_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <tuple>
+
+#include <oneapi/tbb/flow_graph.h>
+#include <oneapi/tbb/task_arena.h>
+
+#include "affinity.hpp"
+
+namespace recastx::recon {
+
+// The reconstruction pipeline as a dataflow graph:
+//
+//   ingest -> preprocess -> upload -> reconstruct and publish
+//                                     reconstruct on demand
+//
+// Each stage runs serially as soon as it receives a token, instead of polling its input buffer.
+// The data stay in the buffers between the stages, which keep their own drop policies.
+//
+// - The ingest tokens are coalesced, since the preprocessing always takes the latest complete
+//   chunk from the raw buffer.
+// - At most one chunk of sinograms is handed off by the preprocessing and not yet taken over
+//   by the uploading, so that the staging buffer is free whenever the preprocessing finishes.
+class Pipeline {
+
+  public:
+
+    struct Stages {
+        // Preprocess the latest complete chunk. Returns true if its sinograms are handed off.
+        std::function<bool()> preprocess;
+        // Take over the sinograms handed off. Returns false if there is none.
+        std::function<bool()> fetch;
+        std::function<void()> upload;
+        // Reconstruct the uploaded sinograms and publish the results.
+        std::function<void()> reconstruct;
+        std::function<void()> reconstructOnDemand;
+    };
+
+  private:
+
+    using Token = oneapi::tbb::flow::continue_msg;
+    using SplitNode = oneapi::tbb::flow::multifunction_node<Token, std::tuple<Token, Token>>;
+
+    // One thread for each stage.
+    static constexpr int k_CONCURRENCY = 4;
+
+    Stages stages_;
+    PipelineAffinity affinity_;
+
+    std::atomic_bool ingest_pending_ = false;
+    std::atomic_bool on_demand_pending_ = false;
+
+    oneapi::tbb::task_arena arena_;
+    std::unique_ptr<oneapi::tbb::flow::graph> graph_;
+    std::unique_ptr<oneapi::tbb::flow::queue_node<Token>> ingest_;
+    // Tokens of the sinograms being preprocessed or handed off.
+    std::unique_ptr<oneapi::tbb::flow::limiter_node<Token>> staging_;
+    // Merge the releases of the staging buffer, since the decrementer of the limiter waits for a
+    // message from each of its predecessors.
+    std::unique_ptr<oneapi::tbb::flow::broadcast_node<Token>> release_;
+    // Output 0: sinograms handed off; output 1: nothing handed off.
+    std::unique_ptr<SplitNode> preprocess_;
+    // Output 0: sinograms uploaded; output 1: staging buffer released.
+    std::unique_ptr<SplitNode> upload_;
+    std::unique_ptr<oneapi::tbb::flow::function_node<Token>> reconstruct_;
+    std::unique_ptr<oneapi::tbb::flow::function_node<Token>> on_demand_;
+
+  public:
+
+    explicit Pipeline(Stages stages);
+
+    ~Pipeline();
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    // The thread running a stage is pinned to the CPUs of the stage while running it.
+    void setCpuAffinity(const PipelineAffinity& affinity) { affinity_ = affinity; }
+
+    // Signal that a chunk is complete or that the preprocessing has something to do.
+    void ingest();
+
+    // Signal that the on-demand slices have been updated.
+    void requestOnDemand();
+
+    // Wait until all the stages are idle.
+    void wait();
+};
+
+} // namespace recastx::recon
+
+#endif // RECON_PIPELINE_H
\ No newline at end of file
@@ -15,6 +15,8 @@
 #include <stdexcept>
 #include <vector>
 
+#include <unistd.h>
+
 #include <spdlog/spdlog.h>
 
 #include "common/config.hpp"
@@ -25,14 +27,36 @@ namespace recastx::recon {
 
 namespace details {
 
-template<typename T>
-inline void copyToBuffer(Tensor<T, 2> &dst, const Tensor<T, 2> &src) {
+// Size of the L2 cache, or 1 MiB if it is unknown.
+inline size_t l2CacheSize() {
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+    long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (size > 0) return static_cast<size_t>(size);
+#endif
+    return 1 << 20;
+}
+
+// Number of rows of a projection processed as a tile, such that the raw, dark, reciprocal and
+// processed rows of a tile fit in half of the cache. It is a multiple of 'alignment' unless it
+// covers the whole projection.
+inline size_t tileRows(size_t row_count, size_t col_count, size_t alignment, size_t cache_size) {
+    size_t bytes_per_row = col_count * (sizeof(RawDtype) + 3 * sizeof(ProDtype));
+    size_t rows = cache_size / 2 / std::max(bytes_per_row, size_t(1));
+    rows = std::max(alignment, rows / alignment * alignment);
+    return std::min(rows, row_count);
+}
+
+template<typename T, typename A1, typename A2>
+inline void copyToBuffer(Tensor<T, 2, A1> &dst, const Tensor<T, 2, A2> &src) {
     assert(dst.shape() == src.shape());
     memcpy(dst.data(), src.data(), src.size() * sizeof(T));
 }
 
-template<typename T>
-inline void copyToBuffer(Tensor<T, 2> &dst, const Tensor<T, 2> &src, const std::array<size_t, 2> &downsampling) {
+template<typename T, typename A1, typename A2>
+inline void copyToBuffer(Tensor<T, 2, A1> &dst,
+                         const Tensor<T, 2, A2> &src,
+                         const std::array<size_t, 2> &downsampling,
+                         DownsamplingMode mode = DownsamplingMode::DECIMATION) {
     const auto &src_shape = src.shape();
     const auto &dst_shape = dst.shape();
     if (dst_shape == src_shape) {
@@ -51,55 +75,190 @@ inline void copyToBuffer(Tensor<T, 2> &dst, const Tensor<T, 2> &src, const std::
 
     size_t padding_r = (dst_shape[0] - rows_ds) / 2;
     size_t padding_c = (dst_shape[1] - cols_ds) / 2;
+    // The destination is not necessarily zero-initialized.
+    if (dst_shape[0] > rows_ds || dst_shape[1] > cols_ds) std::fill(dst.begin(), dst.end(), T(0));
+    T scale = static_cast<T>(1) / static_cast<T>(ds_r * ds_c);
     T* ptr_src = const_cast<T*>(src.data());
     T* ptr_dst = dst.data() + dst_shape[1] * padding_r;
     for (size_t i = 0; i < rows_ds; ++i) {
         for (size_t j = 0; j < cols_ds; ++j) {
-            ptr_dst[j + padding_c] = ptr_src[ds_c * j];
+            if (mode == DownsamplingMode::BINNING) {
+                T v = 0;
+                for (size_t k = 0; k < ds_r; ++k) {
+                    for (size_t l = 0; l < ds_c; ++l) v += ptr_src[k * src_shape[1] + ds_c * j + l];
+                }
+                ptr_dst[j + padding_c] = v * scale;
+            } else {
+                ptr_dst[j + padding_c] = ptr_src[ds_c * j];
+            }
         }
         ptr_src += ds_r * src_shape[1];
         ptr_dst += dst_shape[1];
     }
 }
 
-inline ProImageData computeReciprocal(const ProImageData &dark_avg, const ProImageData &flat_avg) {
+template<typename A>
+inline Tensor<ProDtype, 2, A> computeReciprocal(const Tensor<ProDtype, 2, A> &dark_avg,
+                                               const Tensor<ProDtype, 2, A> &flat_avg) {
     const auto &shape = dark_avg.shape();
-    ProImageData reciprocal{shape};
-    for (size_t i = 0; i < shape[0] * shape[1]; ++i) {
-        if (dark_avg[i] == flat_avg[i]) {
-            reciprocal[i] = 1.0f;
-        } else {
-            reciprocal[i] = 1.0f / (flat_avg[i] - dark_avg[i]);
+    Tensor<ProDtype, 2, A> reciprocal{shape};
+    parallelFor(reciprocal.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (dark_avg[i] == flat_avg[i]) {
+                reciprocal[i] = 1.0f;
+            } else {
+                reciprocal[i] = 1.0f / (flat_avg[i] - dark_avg[i]);
+            }
         }
-    }
+    });
     return reciprocal;
 }
 
+// Compute the reciprocal from the averaged dark and flat images and downsample them.
+inline void computeReciprocal(const Tensor<float, 2>& dark_averaged,
+                              const Tensor<float, 2>& flat_averaged,
+                              ProImageData& dark_avg,
+                              ProImageData& reciprocal,
+                              const std::array<size_t, 2>& downsampling,
+                              DownsamplingMode mode) {
+    if (mode == DownsamplingMode::BINNING) {
+        // The reciprocal is not linear and must be computed from the binned averages.
+        ProImageData flat_binned{dark_avg.shape()};
+        details::copyToBuffer(dark_avg, dark_averaged, downsampling, mode);
+        details::copyToBuffer(flat_binned, flat_averaged, downsampling, mode);
+        details::copyToBuffer(reciprocal, details::computeReciprocal(dark_avg, flat_binned));
+        return;
+    }
+
+    auto reciprocal_orig = details::computeReciprocal(dark_averaged, flat_averaged);
+    details::copyToBuffer(dark_avg, dark_averaged, downsampling);
+    details::copyToBuffer(reciprocal, reciprocal_orig, downsampling);
+}
+
 } // namespace details
 
+// Per-pixel running sum of raw images, e.g. darks or flats.
+//
+// Images are accumulated as they arrive, so that they do not need to be kept. Sums of integers
+// are exact in double precision.
+class ImageAccumulator {
+
+  public:
+
+    using ShapeType = std::array<size_t, 2>;
+
+  private:
+
+    Tensor<double, 2> sum_;
+    size_t count_ = 0;
+
+  public:
+
+    ImageAccumulator() = default;
+
+    // Add an image given by its raw bytes. The accumulator restarts if the shape changes.
+    void push(const char* src, const ShapeType& shape) {
+        if (count_ == 0 || shape != sum_.shape()) {
+            sum_.resize(shape);
+            count_ = 0;
+        }
+
+        double* sum = sum_.data();
+        bool first = count_ == 0;
+        details::parallelFor(sum_.size(), [&](size_t begin, size_t end) {
+            RawDtype v;
+            for (size_t i = begin; i < end; ++i) {
+                // The raw data are not necessarily aligned.
+                memcpy(&v, src + i * sizeof(RawDtype), sizeof(RawDtype));
+                sum[i] = first ? static_cast<double>(v) : sum[i] + static_cast<double>(v);
+            }
+        });
+        ++count_;
+    }
+
+    // Forget the accumulated images while keeping the memory.
+    void reset() { count_ = 0; }
+
+    void average(Tensor<float, 2>& dst) const {
+        assert(count_ > 0);
+        dst.resize(sum_.shape());
+        float* ptr = dst.data();
+        const double* sum = sum_.data();
+        double scale = 1. / static_cast<double>(count_);
+        details::parallelFor(sum_.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) ptr[i] = static_cast<float>(sum[i] * scale);
+        });
+    }
+
+    [[nodiscard]] size_t count() const { return count_; }
+
+    [[nodiscard]] bool empty() const { return count_ == 0; }
+
+    [[nodiscard]] const ShapeType& shape() const { return sum_.shape(); }
+};
+
+// Averaged dark and reciprocal of (flat - dark) for flat field correction.
+struct FlatField {
+    ProImageData dark_avg;
+    ProImageData reciprocal;
+
+    // Returns true if the buffers are reallocated.
+    bool resize(const std::array<size_t, 2>& shape) {
+        if (dark_avg.shape() == shape && reciprocal.shape() == shape) return false;
+        dark_avg.resize(shape);
+        dark_avg.prefault();
+        reciprocal.resize(shape);
+        reciprocal.prefault();
+        return true;
+    }
+};
+
 inline void computeReciprocal(const std::vector<RawImageData> &darks,
                               const std::vector<RawImageData> &flats,
                               ProImageData& dark_avg,
                               ProImageData& reciprocal,
-                              const std::array<size_t, 2>& downsampling) {
+                              const std::array<size_t, 2>& downsampling,
+                              DownsamplingMode mode = DownsamplingMode::DECIMATION) {
     assert(!darks.empty() || !flats.empty());
 
     Tensor<float, 2> flat_averaged;
     Tensor<float, 2> dark_averaged;
     if (darks.empty()) {
         flat_averaged = math::average<ProDtype>(flats);
-        dark_averaged = flat_averaged * 0;
+        dark_averaged = flat_averaged * 0.f;
     } else if (flats.empty()) {
         dark_averaged = math::average<ProDtype>(darks);
-        flat_averaged = dark_averaged + 1;
+        flat_averaged = dark_averaged + 1.f;
     } else {
         dark_averaged = math::average<ProDtype>(darks);
         flat_averaged = math::average<ProDtype>(flats);
     }
 
-    auto reciprocal_orig = details::computeReciprocal(dark_averaged, flat_averaged);
-    details::copyToBuffer(dark_avg, dark_averaged, downsampling);
-    details::copyToBuffer(reciprocal, reciprocal_orig, downsampling);
+    details::computeReciprocal(dark_averaged, flat_averaged, dark_avg, reciprocal, downsampling, mode);
+}
+
+inline void computeReciprocal(const ImageAccumulator &darks,
+                              const ImageAccumulator &flats,
+                              ProImageData& dark_avg,
+                              ProImageData& reciprocal,
+                              const std::array<size_t, 2>& downsampling,
+                              DownsamplingMode mode = DownsamplingMode::DECIMATION) {
+    assert(!darks.empty() || !flats.empty());
+
+    Tensor<float, 2> flat_averaged;
+    Tensor<float, 2> dark_averaged;
+    if (darks.empty()) {
+        flats.average(flat_averaged);
+        dark_averaged = flat_averaged * 0.f;
+    } else if (flats.empty()) {
+        darks.average(dark_averaged);
+        flat_averaged = dark_averaged + 1.f;
+    } else {
+        darks.average(dark_averaged);
+        flats.average(flat_averaged);
+    }
+
+    details::computeReciprocal(dark_averaged, flat_averaged, dark_avg, reciprocal, downsampling, mode);
 }
 
 inline void flatField(float *data,
@@ -111,6 +270,36 @@ inline void flatField(float *data,
     }
 }
 
+// Widen the raw data and apply flat field correction in a single pass.
+inline void flatField(float *dst,
+                      const RawDtype *src,
+                      size_t size,
+                      const ProImageData &dark,
+                      const ProImageData &reciprocal) {
+    for (size_t i = 0; i < size; ++i) {
+        dst[i] = (static_cast<float>(src[i]) - dark[i]) * reciprocal[i];
+    }
+}
+
+// Widen the raw data, apply flat field correction and, optionally, the negative log in a single pass.
+inline void flatField(float *dst,
+                      const RawDtype *src,
+                      size_t size,
+                      const ProDtype *dark,
+                      const ProDtype *reciprocal,
+                      bool minus_log) {
+    if (minus_log) {
+        for (size_t i = 0; i < size; ++i) {
+            float v = (static_cast<float>(src[i]) - dark[i]) * reciprocal[i];
+            dst[i] = v <= 0.0f ? 0.0f : -std::log(v);
+        }
+    } else {
+        for (size_t i = 0; i < size; ++i) {
+            dst[i] = (static_cast<float>(src[i]) - dark[i]) * reciprocal[i];
+        }
+    }
+}
+
 inline void negativeLog(float *data, size_t size) {
     for (size_t i = 0; i < size; ++i) {
         data[i] = data[i] <= 0.0f ? 0.0f : -std::log(data[i]);
@@ -125,21 +314,22 @@ inline std::vector<float> defaultAngles(uint32_t n, float angle_range) {
     return angles;
 }
 
+// Copy the projection 'src' to the 'chunk_idx'-th position of the sinogram.
 template<typename T1, typename T2>
 inline void copyToSinogram(T1 *dst,
-                           const T2 &src,
+                           const T2 *src,
                            size_t chunk_idx,
                            size_t chunk_size,
                            size_t row_count,
                            size_t col_count,
                            int32_t offset) {
-    // (chunk_idx, rows, cols) -> (rows, chunk_idx, cols).
+    // (rows, cols) -> (rows, chunk_idx, cols).
 
     if (offset == 0) {
         for (size_t j = 0; j < row_count; ++j) {
             for (size_t k = 0; k < col_count; ++k) {
                 dst[(row_count - 1 - j) * chunk_size * col_count + chunk_idx * col_count + k] =
-                        src[chunk_idx * col_count * row_count + j * col_count + k];
+                        src[j * col_count + k];
             }
         }
     } else if (offset < 0) {
@@ -149,7 +339,7 @@ inline void copyToSinogram(T1 *dst,
             }
             for (size_t k = 0; k < col_count + offset; ++k) {
                 dst[(row_count - 1 - j) * chunk_size * col_count + chunk_idx * col_count + k] =
-                        src[chunk_idx * col_count * row_count + j * col_count + k - offset];
+                        src[j * col_count + k - offset];
             }
         }
     } else {
@@ -159,12 +349,24 @@ inline void copyToSinogram(T1 *dst,
             }
             for (size_t k = offset; k < col_count; ++k) {
                 dst[(row_count - 1 - j) * chunk_size * col_count + chunk_idx * col_count + k] =
-                        src[chunk_idx * col_count * row_count + j * col_count + k - offset];
+                        src[j * col_count + k - offset];
             }
         }
     }
 }
 
+template<typename T1, typename T2, typename A>
+inline void copyToSinogram(T1 *dst,
+                           const Tensor<T2, 3, A> &src,
+                           size_t chunk_idx,
+                           size_t chunk_size,
+                           size_t row_count,
+                           size_t col_count,
+                           int32_t offset) {
+    // (chunk_idx, rows, cols) -> (rows, chunk_idx, cols).
+    copyToSinogram(dst, &src[chunk_idx * col_count * row_count], chunk_idx, chunk_size, row_count, col_count, offset);
+}
+
 } // namespace recastx::recon
 
 #endif // RECON_PREPROCESSING_H
\ No newline at end of file
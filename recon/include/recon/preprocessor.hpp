@@ -9,7 +9,9 @@
 #ifndef RECON_PREPROCESSOR_H
 #define RECON_PREPROCESSOR_H
 
+#include <atomic>
 #include <cassert>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <vector>
@@ -18,9 +20,11 @@
 #include <oneapi/tbb.h>
 
 #include "common/config.hpp"
+#include "affinity.hpp"
 #include "buffer.hpp"
 #include "filter_interface.hpp"
 #include "phase.hpp"
+#include "preprocessing.hpp"
 
 namespace recastx::recon {
 
@@ -28,12 +32,20 @@ class Preprocessor {
 
 public:
 
-    using RawBufferType = MemoryBuffer<ProDtype, 3>;
+    using RawBufferType = MemoryBuffer<RawDtype, 3>;
 
 private:
 
+    static constexpr size_t k_NO_CHUNK = std::numeric_limits<size_t>::max();
+    static constexpr size_t k_ANY_CHUNK = k_NO_CHUNK - 1;
+
     uint32_t num_threads_ = 1;
     oneapi::tbb::task_arena arena_;
+    // Pin the worker threads when they join the arena.
+    std::unique_ptr<oneapi::tbb::task_scheduler_observer> observer_;
+
+    // Per-thread buffers of the widened projections.
+    AlignedTensor<ProDtype, 3> workspace_;
 
     std::unique_ptr<Paganin> paganin_;
 
@@ -41,13 +53,45 @@ private:
     std::unique_ptr<Filter> ramp_filter_;
 
     bool minus_log_ = true;
+    // Use the vectorised approximation of the logarithm.
+    bool fast_log_ = false;
+
+    // Rows of a projection which are flat-field corrected, filtered and copied to the sinograms
+    // while they are in cache.
+    size_t tile_rows_ = 0;
+
+    size_t row_count_ = 0;
+    size_t col_count_ = 0;
+
+    // Streaming: projections of 'stream_chunk_' are preprocessed into 'stream_sino_' as soon as
+    // they arrive. The chunk being streamed is the one after 'last_chunk_', or the first one to
+    // arrive if no chunk has been processed yet.
+    std::atomic<size_t> stream_chunk_ = k_NO_CHUNK;
+    // Number of threads streaming projections.
+    std::atomic<size_t> stream_users_ = 0;
+    // Whether each projection of the chunk being streamed has been preprocessed.
+    std::vector<uint8_t> streamed_;
+    ProDtype* stream_sino_ = nullptr;
+    std::shared_ptr<const FlatField> stream_flat_field_;
+    int32_t stream_offset_ = 0;
+    size_t last_chunk_ = k_NO_CHUNK;
+    // The chunk whose projections in 'streamed_' have been preprocessed.
+    size_t streamed_chunk_ = k_NO_CHUNK;
+
+    void processProjection(const RawDtype* src,
+                           ProDtype* sino_buffer,
+                           size_t idx,
+                           size_t chunk_size,
+                           const ProImageData& dark_avg,
+                           const ProImageData& reciprocal,
+                           int32_t offset,
+                           int thread_idx);
 
     void initPaganin(const std::optional<PaganinParams> &params,
-                     RawBufferType &buffer, size_t col_count,
+                     size_t col_count,
                      size_t row_count);
 
     void initFilter(const ImageprocParams &params,
-                    RawBufferType &buffer,
                     size_t col_count,
                     size_t row_count);
 
@@ -55,7 +99,11 @@ public:
 
     explicit Preprocessor(FilterFactory *ramp_filter_factory, uint32_t num_threads);
 
-    void init(RawBufferType &buffer, size_t col_count, size_t row_count,
+    ~Preprocessor();
+
+    void setCpuAffinity(const CpuSet& cpus);
+
+    void init(size_t col_count, size_t row_count,
               const ImageprocParams &imgproc_params,
               const std::optional<PaganinParams> &paganin_cfg);
 
@@ -65,6 +113,21 @@ public:
                  const ProImageData &reciprocal,
                  int32_t offset);
 
+    // Preprocess the projections of the next chunk into 'sino_buffer' as they arrive, until
+    // stopStreaming() is called. process() then only preprocesses the remaining projections.
+    void startStreaming(ProDtype* sino_buffer,
+                        size_t chunk_size,
+                        std::shared_ptr<const FlatField> flat_field,
+                        int32_t offset);
+
+    // Returns the flat field of the stream, or nullptr if it is not streaming.
+    std::shared_ptr<const FlatField> stopStreaming();
+
+    [[nodiscard]] bool streaming() const { return stream_flat_field_ != nullptr; }
+
+    // Called by the producers of the raw buffer after a projection is copied into it. Returns
+    // true if the projection has been preprocessed.
+    bool streamProjection(size_t chunk_idx, size_t data_idx, const RawDtype* src);
 };
 
 } // namespace recastx::recon
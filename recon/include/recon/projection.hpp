@@ -9,6 +9,7 @@
 #ifndef RECON_PROJECTION_H
 #define RECON_PROJECTION_H
 
+#include <memory>
 #include <type_traits>
 
 #include "common/config.hpp"
@@ -18,10 +19,23 @@ namespace recastx::recon {
 
 template<typename T = RawDtype>
 struct Projection {
+
+    using ShapeType = typename Tensor<T, 2>::ShapeType;
+
     ProjectionType type;
     size_t index;
     Tensor<T, 2> data;
 
+  private:
+
+    // A projection can also refer to memory owned by someone else, e.g. a received ZMQ
+    // message. 'ref_' keeps that memory alive until the projection is destroyed.
+    std::shared_ptr<const void> ref_;
+    const void* ptr_ = nullptr;
+    ShapeType shape_ {0, 0};
+
+  public:
+
     Projection() = default;
 
     Projection(ProjectionType type, size_t index, size_t col_count, size_t row_count, std::vector<T> data_)
@@ -32,6 +46,30 @@ struct Projection {
             : type(type), index(index), data(std::array<size_t, 2> {row_count, col_count}) {
         std::memcpy(data.data(), data_, size);
     }
+
+    // Zero-copy constructor.
+    Projection(ProjectionType type, size_t index, size_t col_count, size_t row_count,
+               std::shared_ptr<const void> ref, const void* data_)
+            : type(type), index(index), ref_(std::move(ref)), ptr_(data_), shape_{row_count, col_count} {
+    }
+
+    [[nodiscard]] bool isView() const { return ptr_ != nullptr; }
+
+    [[nodiscard]] const ShapeType& shape() const { return isView() ? shape_ : data.shape(); }
+
+    [[nodiscard]] const char* bytes() const {
+        return isView() ? static_cast<const char*>(ptr_) : reinterpret_cast<const char*>(data.data());
+    }
+
+    // Copy the referred data into 'data' and release the reference.
+    void materialize() {
+        if (!isView()) return;
+
+        data.resize(shape_);
+        std::memcpy(data.data(), ptr_, data.size() * sizeof(T));
+        ref_.reset();
+        ptr_ = nullptr;
+    }
 };
 
 } // namespace recastx::recon
@@ -9,7 +9,8 @@
 #ifndef RECON_PROJECTIONMEDIATOR_H
 #define RECON_PROJECTIONMEDIATOR_H
 
-#include "common/queue.hpp"
+#include "common/config.hpp"
+#include "common/ring_queue.hpp"
 #include "projection.hpp"
 
 namespace recastx::recon {
@@ -25,11 +26,12 @@ class ProjectionMediator {
     size_t monitor_every_;
     size_t proj_id_;
 
-    ThreadSafeQueue<DataType> queue_;
+    // The oldest projection is dropped when the queue is full.
+    RingQueue<DataType> queue_;
 
   public:
     
-    explicit ProjectionMediator(int capacity = 0);
+    explicit ProjectionMediator(size_t capacity = k_PROJECTION_MEDIATOR_BUFFER_SIZE);
 
     void push(DataType proj);
 
@@ -16,25 +16,50 @@ extern "C" {
 #include <fftw3.h>
 }
 
+#include "allocator.hpp"
 #include "filter_interface.hpp"
 
 namespace recastx::recon {
 
+namespace details {
+
+// The smallest length which is not less than n and is a product of 2, 3, 5 and 7.
+int nextSmoothLength(int n);
+
+} // namespace details
+
 class RampFilter : public Filter {
 
   public:
 
     using DataType = std::vector<float>;
 
+    // Number of rows transformed by one batched FFT, which keeps the spectra of a block in cache.
+    static constexpr int k_BLOCK_ROWS = 16;
+
   protected:
 
-    std::vector<std::vector<std::complex<float>>> freq_;
+    using SpectrumType = std::vector<std::complex<float>, AlignedAllocator<std::complex<float>>>;
+    using RowsType = std::vector<float, AlignedAllocator<float>>;
+
+    std::vector<SpectrumType> freq_;
+    // Padded rows of a block. Not used without padding.
+    std::vector<RowsType> padded_;
     DataType filter_;
-    fftwf_plan fft_plan_;
-    fftwf_plan ffti_plan_;
+    // Plans for a full block of rows and for the remaining rows.
+    fftwf_plan fft_plan_ = nullptr;
+    fftwf_plan ffti_plan_ = nullptr;
+    fftwf_plan fft_tail_plan_ = nullptr;
+    fftwf_plan ffti_tail_plan_ = nullptr;
 
     int num_cols_;
     int num_rows_;
+    RampFilterPadding padding_;
+    int padded_cols_; // length of the transforms
+    int num_freqs_; // size of the half-spectrum of a row
+    int block_rows_;
+
+    void padRows(const float* src, float* dst, int n) const;
 
     static DataType frequency(int n);
 
@@ -42,10 +67,21 @@ class RampFilter : public Filter {
   
   public:
   
-    RampFilter(float* data, int num_cols, int num_rows, int buffer_size);
+    RampFilter(float* data, int num_cols, int num_rows, int buffer_size,
+               RampFilterPadding padding = RampFilterPadding::NONE);
+
+    ~RampFilter() override;
 
     void apply(float* data, int buffer_index) override;
 
+    void applyRows(float* data, int num_rows, int buffer_index) override;
+
+    [[nodiscard]] int rowAlignment() const override { return block_rows_; }
+
+    // Length of the transforms of rows of 'num_cols' pixels with the given padding, i.e. the
+    // next FFT-friendly length of at least twice the width, which also avoids wrap-around.
+    static int paddedLength(int num_cols, RampFilterPadding padding);
+
     static DataType generate(int n);
 };
 
@@ -58,7 +94,8 @@ class RamlakFilter : public RampFilter {
 
   public:
 
-    RamlakFilter(float* data, int num_cols, int num_rows, int buffer_size);
+    RamlakFilter(float* data, int num_cols, int num_rows, int buffer_size,
+                 RampFilterPadding padding = RampFilterPadding::NONE);
 
     static DataType generate(int n);
 };
@@ -72,7 +109,8 @@ class SheppFilter : public RampFilter {
 
   public:
 
-    SheppFilter(float* data, int num_cols, int num_rows, int buffer_size);
+    SheppFilter(float* data, int num_cols, int num_rows, int buffer_size,
+                RampFilterPadding padding = RampFilterPadding::NONE);
 
     static DataType generate(int n);
 };
@@ -82,8 +120,11 @@ class RampFilterFactory: public FilterFactory {
 
   public:
 
+    using FilterFactory::create;
+
     std::unique_ptr<Filter> create(const std::string& name, 
-                                   float* data, int num_cols, int num_rows, int buffer_size) override;
+                                   float* data, int num_cols, int num_rows, int buffer_size,
+                                   RampFilterPadding padding) override;
 
 };
 
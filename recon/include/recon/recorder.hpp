@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_RECORDER_H
+#define RECON_RECORDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/ring_queue.hpp"
+#include "projection.hpp"
+#include "daq/raw_stream.hpp"
+
+namespace recastx::recon {
+
+// Record the incoming projections to a raw stream, which can be replayed by ReplayDaqClient.
+//
+// Frames are handed over to a dedicated writer thread through a bounded queue. The writer
+// thread writes large aligned blocks to the data file (with O_DIRECT if supported by the file
+// system) and appends the index entries of the frames in a block once the block is written.
+// A frame is dropped if the queue is full, so that the data acquisition is never blocked.
+class Recorder {
+
+    static constexpr size_t K_ALIGNMENT = 4096;
+
+    struct Frame {
+        Projection<> proj;
+        uint64_t timestamp = 0;
+    };
+
+    std::string path_;
+
+    RingQueue<Frame> queue_;
+    std::atomic<size_t> num_recorded_ = 0;
+    std::atomic<size_t> num_dropped_ = 0;
+
+    int data_fd_ = -1;
+    int index_fd_ = -1;
+    bool direct_io_ = false;
+
+    size_t block_size_;
+    std::unique_ptr<char, void(*)(void*)> block_;
+    size_t block_fill_ = 0;
+    // Number of bytes written to the data file.
+    uint64_t flushed_ = 0;
+    // Index entries of the frames which have not been completely written to the data file.
+    std::vector<RawStreamIndexEntry> pending_;
+
+    std::atomic_bool running_ = true;
+    std::atomic_bool failed_ = false;
+    std::thread writer_;
+
+    void openFiles();
+
+    void write();
+
+    void append(const Frame& frame);
+
+    void flush(bool final);
+
+    bool writeAll(int fd, const char* buf, size_t size);
+
+    void writeIndex();
+
+  public:
+
+    // queue_size: maximum number of frames waiting to be written.
+    // block_size: size in bytes of the blocks written to the data file. It will be rounded up
+    //             to a multiple of 4096.
+    explicit Recorder(const std::string& path, size_t queue_size = 256, size_t block_size = 8 * 1024 * 1024);
+
+    ~Recorder();
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    // Never blocks. Returns false if the frame is dropped.
+    bool push(const Projection<>& proj);
+
+    [[nodiscard]] size_t numRecorded() const { return num_recorded_; }
+    [[nodiscard]] size_t numDropped() const { return num_dropped_; }
+};
+
+} // namespace recastx::recon
+
+#endif // RECON_RECORDER_H
\ No newline at end of file
@@ -10,6 +10,8 @@
 #define RECON_RPCSERVER_H
 
 #include <array>
+#include <map>
+#include <mutex>
 #include <string>
 #include <thread>
 
@@ -24,10 +26,40 @@
 #include "projection.grpc.pb.h"
 #include "reconstruction.grpc.pb.h"
 
+#include "metrics.hpp"
+
 namespace recastx::recon {
 
 class Application;
 
+// Bytes of a data stream sent to each client host.
+//
+// The counter of a host is looked up in the registry only once. Since the series are never
+// removed, hosts beyond k_MAX_HOSTS are counted as "other".
+class BytesSentCounter {
+
+    Metrics& metrics_;
+    const std::string stream_;
+
+    std::mutex mtx_;
+    std::map<std::string, Counter*> counters_;
+    Counter* other_ = nullptr;
+
+    Counter& counter(const std::string& host);
+
+  public:
+
+    static constexpr size_t k_MAX_HOSTS = 16;
+
+    BytesSentCounter(Metrics& metrics, std::string stream);
+
+    // Strip the port, which changes on every reconnection, from a peer address, e.g.
+    // "ipv4:127.0.0.1:50000" or "ipv6:[::1]:50000".
+    static std::string peerHost(const std::string& peer);
+
+    void add(const grpc::ServerContext* context, size_t num_bytes);
+};
+
 class ControlService final : public rpc::Control::Service {
 
     Application* app_;
@@ -60,6 +92,10 @@ class ControlService final : public rpc::Control::Service {
                              const rpc::ScanMode* mode,
                              google::protobuf::Empty* rep) override;
 
+    grpc::Status GetMetrics(grpc::ServerContext* context,
+                            const google::protobuf::Empty* req,
+                            rpc::MetricsData* data) override;
+
 };
 
 class ImageprocService final : public rpc::Imageproc::Service {
@@ -87,6 +123,8 @@ class ProjectionTransferService final : public rpc::ProjectionTransfer::Service
 
     Application* app_;
 
+    BytesSentCounter bytes_sent_;
+
   public:
 
     explicit ProjectionTransferService(Application* app);
@@ -111,6 +149,8 @@ class ReconstructionService final : public rpc::Reconstruction::Service {
 
     Application* app_;
 
+    BytesSentCounter bytes_sent_;
+
   public:
 
     explicit ReconstructionService(Application* app);
@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_SIMD_H
+#define RECON_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Vectorised kernels for the per-pixel hot loops.
+//
+// The kernels are compiled for several instruction sets in simd.cpp and the best one supported
+// by the CPU is selected at runtime, so that the binary does not depend on '-march'.
+namespace recastx::recon::simd {
+
+enum class Isa { SCALAR = 0, AVX2 = 1, AVX512 = 2 };
+
+// The instruction set used by the kernels.
+Isa isa();
+
+// The best instruction set supported by the CPU.
+Isa detectIsa();
+
+// Set the instruction set used by the kernels. It is capped at detectIsa(). Returns the
+// instruction set actually used.
+Isa setIsa(Isa isa);
+
+const char* isaName(Isa isa);
+
+// dst[i] = src[i * stride] for i in [0, n).
+//
+// 'src' is only required to be aligned to its element size.
+void convert(float* dst, const uint16_t* src, size_t n, size_t stride = 1);
+
+// dst[i] += src[i] for i in [0, n).
+void accumulate(float* dst, const uint16_t* src, size_t n);
+
+// dst[i] = scale * (src[i * factor] + ... + src[i * factor + factor - 1]) for i in [0, n).
+//
+// 'dst' may be the same as 'src'.
+void reduce(float* dst, const float* src, size_t n, size_t factor, float scale);
+
+// Maximum relative error of negativeLog() with respect to the exact -log for the normal positive
+// floats whose logarithm is not within 1e-3 of zero (measured: 7.7e-8). Closer to zero, the
+// absolute error is below 1e-10.
+inline constexpr float k_NEGATIVE_LOG_MAX_REL_ERROR = 2e-7f;
+
+// data[i] = data[i] <= 0 ? 0 : -scale * log(data[i]) for i in [0, n).
+//
+// The logarithm is approximated by a polynomial. Subnormal values are treated as the smallest
+// normal float and the values must not be infinite or NaN.
+void negativeLog(float* data, size_t n, float scale = 1.f);
+
+} // namespace recastx::recon::simd
+
+#endif // RECON_SIMD_H
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include <unordered_set>
 
 #include "buffer.hpp"
+#include "metrics.hpp"
 #include "reconstructor_interface.hpp"
 
 
@@ -33,6 +34,10 @@ protected:
 
     std::mutex mtx_;
 
+    // Reconstruction time of each slice.
+    Histogram* recon_time_ = nullptr;
+    Histogram* ondemand_recon_time_ = nullptr;
+
 public:
 
     SliceMediator();
@@ -47,6 +52,8 @@ public:
 
     void resize(const SliceBuffer<float>::ShapeType& shape);
 
+    void registerMetrics(Metrics& metrics);
+
     void update(size_t timestamp, const Orientation& orientation);
 
     void reconAll(Reconstructor* recon, int gpu_buffer_index);
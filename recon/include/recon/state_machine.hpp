@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#ifndef RECON_STATEMACHINE_H
+#define RECON_STATEMACHINE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace recastx::recon {
+
+// A state which threads can wait on instead of polling it.
+//
+// Reading the state never blocks. Every transition wakes up all the waiters, which re-evaluate
+// their conditions.
+template<typename S>
+class StateMachine {
+
+    std::atomic<S> state_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+
+  public:
+
+    explicit StateMachine(S state) : state_(state) {}
+
+    StateMachine(const StateMachine&) = delete;
+    StateMachine& operator=(const StateMachine&) = delete;
+
+    [[nodiscard]] S get() const { return state_; }
+
+    // Returns the previous state.
+    S set(S state) {
+        S prev;
+        {
+            std::lock_guard lk(mtx_);
+            prev = state_.exchange(state);
+        }
+        cv_.notify_all();
+        return prev;
+    }
+
+    // Returns false if the current state is not 'from', in which case the state is left untouched.
+    bool transit(S from, S to) {
+        {
+            std::lock_guard lk(mtx_);
+            if (state_ != from) return false;
+            state_ = to;
+        }
+        cv_.notify_all();
+        return true;
+    }
+
+    // Wake up the waiters whose conditions also depend on something else than the state. The
+    // change must be visible before calling it.
+    void notify() {
+        { std::lock_guard lk(mtx_); }
+        cv_.notify_all();
+    }
+
+    // Wait until pred(state) is true. The timeout is in milliseconds and a negative value means
+    // waiting forever. Returns false on timeout.
+    template<typename Pred>
+    bool waitUntil(Pred pred, int timeout = -1) {
+        std::unique_lock lk(mtx_);
+        auto ready = [&] { return pred(state_.load()); };
+        if (timeout < 0) {
+            cv_.wait(lk, ready);
+            return true;
+        }
+        return cv_.wait_for(lk, std::chrono::milliseconds(timeout), ready);
+    }
+
+    // Wait until pred(state) is true or the deadline is reached. Returns false on timeout.
+    template<typename Pred, typename Clock, typename Duration>
+    bool waitUntil(Pred pred, const std::chrono::time_point<Clock, Duration>& deadline) {
+        std::unique_lock lk(mtx_);
+        return cv_.wait_until(lk, deadline, [&] { return pred(state_.load()); });
+    }
+
+    bool waitFor(S state, int timeout = -1) {
+        return waitUntil([state](S s) { return s == state; }, timeout);
+    }
+};
+
+} // namespace recastx::recon
+
+#endif // RECON_STATEMACHINE_H
\ No newline at end of file
@@ -15,22 +15,125 @@
 #include <cstring>
 #include <numeric>
 #include <stdexcept>
+#include <type_traits>
 #include <unordered_set>
+#include <vector>
 
+#include <oneapi/tbb/blocked_range.h>
+#include <oneapi/tbb/parallel_for.h>
 #include <spdlog/spdlog.h>
 
 #include "common/config.hpp"
+#include "allocator.hpp"
 
 
 namespace recastx::recon {
 
-template<typename T, size_t N>
-class Tensor {
+template<typename T, size_t N, typename Alloc = std::allocator<T>>
+class Tensor;
+
+namespace details {
+
+// Element-wise loops over at least this number of elements are split among the TBB workers.
+inline constexpr size_t k_PARALLEL_SIZE = 1 << 20;
+inline constexpr size_t k_PARALLEL_GRAIN = 1 << 16;
+
+// Call f(begin, end) on sub-ranges of [0, n), in parallel if n is large.
+template<typename F>
+inline void parallelFor(size_t n, F&& f) {
+    if (n < k_PARALLEL_SIZE) {
+        f(size_t(0), n);
+        return;
+    }
+    oneapi::tbb::parallel_for(oneapi::tbb::blocked_range<size_t>(0, n, k_PARALLEL_GRAIN),
+                              [&f](const oneapi::tbb::blocked_range<size_t>& r) { f(r.begin(), r.end()); });
+}
+
+// Base of tensors and lazily evaluated element-wise expressions of tensors.
+//
+// An expression only holds references to the tensors it involves. It is evaluated in a single
+// loop without temporaries when it is assigned to a tensor. Do not keep it beyond the full
+// expression which creates it.
+template<typename E>
+class TensorExpr {
+
+  public:
+
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+// Tensors are referred to while nested expressions are held by value.
+template<typename E>
+struct ExprOperand { using type = const E; };
+
+template<typename T, size_t N, typename Alloc>
+struct ExprOperand<Tensor<T, N, Alloc>> { using type = const Tensor<T, N, Alloc>&; };
+
+template<typename E>
+using ExprOperandType = typename ExprOperand<E>::type;
+
+struct Plus { template<typename T> auto operator()(T a, T b) const { return a + b; } };
+struct Minus { template<typename T> auto operator()(T a, T b) const { return a - b; } };
+struct Multiplies { template<typename T> auto operator()(T a, T b) const { return a * b; } };
+struct Divides { template<typename T> auto operator()(T a, T b) const { return a / b; } };
+
+template<typename Op, typename L, typename R>
+class BinaryExpr : public TensorExpr<BinaryExpr<Op, L, R>> {
+
+    static_assert(std::is_same_v<typename L::ValueType, typename R::ValueType>);
+
+    ExprOperandType<L> lhs_;
+    ExprOperandType<R> rhs_;
+
+  public:
+
+    using ValueType = typename L::ValueType;
+    using ShapeType = typename L::ShapeType;
+
+    BinaryExpr(const L& lhs, const R& rhs) : lhs_(lhs), rhs_(rhs) {
+        assert(lhs_.shape() == rhs_.shape());
+    }
+
+    ValueType operator[](size_t i) const { return static_cast<ValueType>(Op{}(lhs_[i], rhs_[i])); }
+
+    const ShapeType& shape() const { return lhs_.shape(); }
+
+    [[nodiscard]] size_t size() const { return lhs_.size(); }
+};
+
+template<typename Op, typename L>
+class ScalarExpr : public TensorExpr<ScalarExpr<Op, L>> {
+
+  public:
+
+    using ValueType = typename L::ValueType;
+    using ShapeType = typename L::ShapeType;
+
+  private:
+
+    ExprOperandType<L> lhs_;
+    ValueType rhs_;
+
+  public:
+
+    ScalarExpr(const L& lhs, ValueType rhs) : lhs_(lhs), rhs_(rhs) {}
+
+    ValueType operator[](size_t i) const { return static_cast<ValueType>(Op{}(lhs_[i], rhs_)); }
+
+    const ShapeType& shape() const { return lhs_.shape(); }
+
+    [[nodiscard]] size_t size() const { return lhs_.size(); }
+};
+
+} // namespace details
+
+template<typename T, size_t N, typename Alloc>
+class Tensor : public details::TensorExpr<Tensor<T, N, Alloc>> {
 
 public:
 
     using ShapeType = std::array<size_t, N>;
-    using ContainerType = std::vector<T>;
+    using ContainerType = std::vector<T, Alloc>;
     using ValueType = T;
 
     using value_type = typename ContainerType::value_type;
@@ -54,7 +157,7 @@ public:
 
     explicit Tensor(const ShapeType& shape) : shape_(shape), data_(size(shape)) {}
 
-    Tensor(const ShapeType& shape, const std::vector<T>& data) : shape_(shape), data_(data) {
+    Tensor(const ShapeType& shape, const ContainerType& data) : shape_(shape), data_(data) {
         size_t s = size(shape_);
         if (s != data_.size()) {
             throw std::runtime_error(fmt::format(
@@ -62,7 +165,7 @@ public:
         }
     }
 
-    Tensor(ShapeType&& shape, std::vector<T>&& data) : shape_(std::move(shape)), data_(std::move(data)) {
+    Tensor(ShapeType&& shape, ContainerType&& data) : shape_(std::move(shape)), data_(std::move(data)) {
         size_t s = size(shape_);
         if (s != data_.size()) {
             throw std::runtime_error(fmt::format(
@@ -70,6 +173,13 @@ public:
         }
     }
 
+    // Evaluate an expression, which could also be a tensor with another allocator.
+    template<typename E>
+    Tensor(const details::TensorExpr<E>& expr) : shape_(expr.self().shape()), data_(size(shape_)) {
+        static_assert(std::is_same_v<typename E::ValueType, T>);
+        evaluate(expr.self(), [](T& x, T v) { x = v; });
+    }
+
     virtual ~Tensor() = default; 
 
     Tensor(const Tensor& other) = default;
@@ -89,6 +199,19 @@ public:
         return *this;
     }
 
+    template<typename E>
+    Tensor& operator=(const details::TensorExpr<E>& expr) {
+        static_assert(std::is_same_v<typename E::ValueType, T>);
+        if (shape_ != expr.self().shape()) {
+            // The expression could refer to this tensor.
+            Tensor tmp(expr);
+            swap(tmp);
+        } else {
+            evaluate(expr.self(), [](T& x, T v) { x = v; });
+        }
+        return *this;
+    }
+
     void swap(Tensor& other) noexcept {
         data_.swap(other.data_);
         shape_.swap(other.shape_);
@@ -108,6 +231,9 @@ public:
 
     const T& operator[](size_t pos) const { return data_[pos]; }
 
+    // Fault in the pages of the data on the NUMA node of the calling thread.
+    void prefault() { recon::prefault(data_.data(), data_.size() * sizeof(T)); }
+
     T* data() { return data_.data(); }
 
     const T* data() const { return data_.data(); }
@@ -118,107 +244,137 @@ public:
     iterator end() { return data_.end(); }
     const_iterator end() const { return data_.end(); }
 
-    Tensor<T, N>& operator+=(const Tensor<T, N>& rhs) {
-        for (size_t i = 0; i < data_.size(); ++i) {
-            data_[i] += rhs.data_[i];
-        }
+    template<typename E>
+    Tensor& operator+=(const details::TensorExpr<E>& rhs) {
+        evaluate(rhs.self(), [](T& x, T v) { x += v; });
         return *this;
     }
 
-    Tensor<T, N>& operator+=(T rhs) {
-        for (size_t i = 0; i < data_.size(); ++i) {
-            data_[i] += rhs;
-        }
+    Tensor& operator+=(T rhs) {
+        evaluate(details::ScalarExpr<details::Plus, Tensor>(*this, rhs), [](T& x, T v) { x = v; });
         return *this;
     }
 
-    Tensor<T, N>& operator-=(const Tensor<T, N>& rhs) {
-        for (size_t i = 0; i < data_.size(); ++i) {
-            data_[i] -= rhs.data_[i];
-        }
+    template<typename E>
+    Tensor& operator-=(const details::TensorExpr<E>& rhs) {
+        evaluate(rhs.self(), [](T& x, T v) { x -= v; });
         return *this;
     }
 
-    Tensor<T, N>& operator-=(T rhs) {
-        for (size_t i = 0; i < data_.size(); ++i) {
-            data_[i] -= rhs;
-        }
+    Tensor& operator-=(T rhs) {
+        evaluate(details::ScalarExpr<details::Minus, Tensor>(*this, rhs), [](T& x, T v) { x = v; });
         return *this;
     }
 
-    Tensor<T, N>& operator*=(T rhs) {
-        for (size_t i = 0; i < data_.size(); ++i) {
-            data_[i] *= rhs;
-        }
+    template<typename E>
+    Tensor& operator*=(const details::TensorExpr<E>& rhs) {
+        evaluate(rhs.self(), [](T& x, T v) { x *= v; });
         return *this;
     }
 
-    Tensor<T, N>& operator/=(T rhs) {
-        for (size_t i = 0; i < data_.size(); ++i) {
-            data_[i] /= rhs;
-        }
+    Tensor& operator*=(T rhs) {
+        evaluate(details::ScalarExpr<details::Multiplies, Tensor>(*this, rhs), [](T& x, T v) { x = v; });
         return *this;
     }
 
-    friend Tensor<T, N> operator+(Tensor<T, N> lhs, const Tensor<T, N>& rhs) {
-        lhs += rhs;
-        return lhs;
+    template<typename E>
+    Tensor& operator/=(const details::TensorExpr<E>& rhs) {
+        evaluate(rhs.self(), [](T& x, T v) { x /= v; });
+        return *this;
     }
 
-    friend Tensor<T, N> operator+(Tensor<T, N> lhs, T rhs) {
-        lhs += rhs;
-        return lhs;
+    Tensor& operator/=(T rhs) {
+        evaluate(details::ScalarExpr<details::Divides, Tensor>(*this, rhs), [](T& x, T v) { x = v; });
+        return *this;
     }
 
-    friend Tensor<T, N> operator-(Tensor<T, N> lhs, const Tensor<T, N>& rhs) {
-        lhs -= rhs;
-        return lhs;
-    }
+    const ShapeType& shape() const { return shape_; }
 
-    friend Tensor<T, N> operator-(Tensor<T, N> lhs, T rhs) {
-        lhs -= rhs;
-        return lhs;
-    }
+    [[nodiscard]] size_t size() const { return data_.size(); }
 
-    friend Tensor<T, N> operator*(Tensor<T, N> lhs, T rhs) {
-        lhs *= rhs;
-        return lhs;
-    }
+  private:
 
-    friend Tensor<T, N> operator/(Tensor<T, N> lhs, T rhs) {
-        lhs /= rhs;
-        return lhs;
+    // Apply 'f(data_[i], expr[i])' to every element in a single (parallel) loop.
+    template<typename E, typename F>
+    void evaluate(const E& expr, F f) {
+        assert(expr.shape() == shape_);
+        T* dst = data_.data();
+        details::parallelFor(data_.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) f(dst[i], expr[i]);
+        });
     }
+};
 
-    const ShapeType& shape() const { return shape_; }
+template<typename L, typename R>
+inline auto operator+(const details::TensorExpr<L>& lhs, const details::TensorExpr<R>& rhs) {
+    return details::BinaryExpr<details::Plus, L, R>(lhs.self(), rhs.self());
+}
 
-    [[nodiscard]] size_t size() const { return data_.size(); }
-};
+template<typename L>
+inline auto operator+(const details::TensorExpr<L>& lhs, typename L::ValueType rhs) {
+    return details::ScalarExpr<details::Plus, L>(lhs.self(), rhs);
+}
+
+template<typename L, typename R>
+inline auto operator-(const details::TensorExpr<L>& lhs, const details::TensorExpr<R>& rhs) {
+    return details::BinaryExpr<details::Minus, L, R>(lhs.self(), rhs.self());
+}
+
+template<typename L>
+inline auto operator-(const details::TensorExpr<L>& lhs, typename L::ValueType rhs) {
+    return details::ScalarExpr<details::Minus, L>(lhs.self(), rhs);
+}
+
+template<typename L, typename R>
+inline auto operator*(const details::TensorExpr<L>& lhs, const details::TensorExpr<R>& rhs) {
+    return details::BinaryExpr<details::Multiplies, L, R>(lhs.self(), rhs.self());
+}
 
-using ProImageData = Tensor<ProDtype, 2>;
+template<typename L>
+inline auto operator*(const details::TensorExpr<L>& lhs, typename L::ValueType rhs) {
+    return details::ScalarExpr<details::Multiplies, L>(lhs.self(), rhs);
+}
+
+template<typename L, typename R>
+inline auto operator/(const details::TensorExpr<L>& lhs, const details::TensorExpr<R>& rhs) {
+    return details::BinaryExpr<details::Divides, L, R>(lhs.self(), rhs.self());
+}
+
+template<typename L>
+inline auto operator/(const details::TensorExpr<L>& lhs, typename L::ValueType rhs) {
+    return details::ScalarExpr<details::Divides, L>(lhs.self(), rhs);
+}
+
+// Tensor for large buffers in the processing pipeline.
+template<typename T, size_t N>
+using AlignedTensor = Tensor<T, N, AlignedAllocator<T>>;
+
+using ProImageData = AlignedTensor<ProDtype, 2>;
 using RawImageData = Tensor<RawDtype, 2>;
 
 namespace math {
 
 namespace details {
-    template<typename R, typename T, size_t N>
-    inline void average(const std::vector<Tensor<T, N>>& src, Tensor<R, N>& dst) {
-        const auto& shape = dst.shape();
-        size_t size = std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<>());
-        
-        for (const auto& v : src) {
-            for (size_t i = 0; i < size; ++i) {
-                dst[i] += static_cast<R>(v[i]);
+    template<typename R, typename T, size_t N, typename A>
+    inline void average(const std::vector<Tensor<T, N>>& src, Tensor<R, N, A>& dst) {
+        // Sum up the sources block by block so that each block of 'dst' stays in cache.
+        recon::details::parallelFor(dst.size(), [&](size_t begin, size_t end) {
+            R* ptr = dst.data();
+            const T* ptr_src = src[0].data();
+            for (size_t i = begin; i < end; ++i) ptr[i] = static_cast<R>(ptr_src[i]);
+            for (size_t k = 1; k < src.size(); ++k) {
+                ptr_src = src[k].data();
+                for (size_t i = begin; i < end; ++i) ptr[i] += static_cast<R>(ptr_src[i]);
             }
-        }
-
-        dst /= static_cast<R>(src.size());
+            auto n = static_cast<R>(src.size());
+            for (size_t i = begin; i < end; ++i) ptr[i] /= n;
+        });
     }
 }
 
 // FIXME: specialize for N == 1
-template<typename R, typename T, size_t N>
-inline void average(const std::vector<Tensor<T, N>>& src, Tensor<R, N>& dst) {
+template<typename R, typename T, size_t N, typename A>
+inline void average(const std::vector<Tensor<T, N>>& src, Tensor<R, N, A>& dst) {
     assert(!src.empty());
     assert(src[0].shape() == dst.shape());
     details::average(src, dst);
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+#include "recon/affinity.hpp"
+
+namespace recastx::recon {
+
+namespace {
+
+int parseCpu(const std::string& s) {
+    size_t pos;
+    int cpu = -1;
+    try {
+        cpu = std::stoi(s, &pos);
+    } catch (const std::exception&) {
+        pos = 0;
+    }
+    if (pos == 0 || pos != s.size() || cpu < 0) {
+        throw std::invalid_argument(fmt::format("Invalid CPU: '{}'", s));
+    }
+    return cpu;
+}
+
+} // namespace
+
+CpuSet::CpuSet(std::vector<int> cpus) : cpus_(std::move(cpus)) {
+    std::sort(cpus_.begin(), cpus_.end());
+    cpus_.erase(std::unique(cpus_.begin(), cpus_.end()), cpus_.end());
+}
+
+CpuSet CpuSet::parse(const std::string& s) {
+    if (s.empty()) return {};
+
+    if (s.rfind("node:", 0) == 0) return numaNode(parseCpu(s.substr(5)));
+    if (s.back() == ',') throw std::invalid_argument(fmt::format("Invalid CPU list: '{}'", s));
+
+    std::vector<int> cpus;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        auto pos = item.find('-');
+        if (pos == std::string::npos) {
+            cpus.push_back(parseCpu(item));
+        } else {
+            int first = parseCpu(item.substr(0, pos));
+            int last = parseCpu(item.substr(pos + 1));
+            if (first > last) throw std::invalid_argument(fmt::format("Invalid CPU range: '{}'", item));
+            for (int i = first; i <= last; ++i) cpus.push_back(i);
+        }
+    }
+    return CpuSet(std::move(cpus));
+}
+
+CpuSet CpuSet::numaNode(int node) {
+    auto path = fmt::format("/sys/devices/system/node/node{}/cpulist", node);
+    std::ifstream file(path);
+    std::string cpulist;
+    if (!file || !std::getline(file, cpulist) || cpulist.empty()) {
+        throw std::invalid_argument(fmt::format("Failed to read the CPUs of NUMA node {} from {}", node, path));
+    }
+    return parse(cpulist);
+}
+
+std::string CpuSet::str() const {
+    if (cpus_.empty()) return "any";
+
+    std::string ret;
+    for (size_t i = 0; i < cpus_.size();) {
+        size_t j = i;
+        while (j + 1 < cpus_.size() && cpus_[j + 1] == cpus_[j] + 1) ++j;
+        if (!ret.empty()) ret += ",";
+        ret += j == i ? std::to_string(cpus_[i]) : fmt::format("{}-{}", cpus_[i], cpus_[j]);
+        i = j + 1;
+    }
+    return ret;
+}
+
+bool pinThread(const CpuSet& cpus) {
+    if (cpus.empty()) return true;
+
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus.cpus()) {
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0) {
+        spdlog::warn("Failed to pin thread to CPUs {}: error code {}", cpus.str(), ret);
+        return false;
+    }
+    return true;
+#else
+    spdlog::warn("Thread pinning is not supported on this platform");
+    return false;
+#endif
+}
+
+CpuSet threadAffinity() {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0) return {};
+
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    return CpuSet(std::move(cpus));
+#else
+    return {};
+#endif
+}
+
+} // namespace recastx::recon
\ No newline at end of file
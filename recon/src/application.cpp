@@ -20,10 +20,13 @@
 #include "recon/application.hpp"
 #include "recon/encoder.hpp"
 #include "recon/monitor.hpp"
+#include "recon/pipeline.hpp"
 #include "recon/preprocessing.hpp"
 #include "recon/preprocessor.hpp"
 #include "recon/projection_mediator.hpp"
+#include "recon/recorder.hpp"
 #include "recon/rpc_server.hpp"
+#include "recon/simd.hpp"
 #include "recon/slice_mediator.hpp"
 #include "recon/cuda/sinogram_proxy.cuh"
 #include "recon/cuda/volume_proxy.cuh"
@@ -42,7 +45,21 @@ Application::Application(size_t raw_buffer_size,
                          FilterFactory* ramp_filter_factory,
                          ReconstructorFactory* recon_factory,
                          const RpcServerConfig& rpc_config)
-     : raw_buffer_(raw_buffer_size),
+     : projections_received_(metrics_.counter(
+               "recon_projections_received_total", "Images received from the DAQ.", {{"type", "projection"}})),
+       darks_received_(metrics_.counter(
+               "recon_projections_received_total", "Images received from the DAQ.", {{"type", "dark"}})),
+       flats_received_(metrics_.counter(
+               "recon_projections_received_total", "Images received from the DAQ.", {{"type", "flat"}})),
+       tomograms_reconstructed_(metrics_.counter(
+               "recon_tomograms_reconstructed_total", "Tomograms reconstructed.")),
+       preprocessing_time_(metrics_.histogram(
+               "recon_preprocessing_seconds", "Time to preprocess a chunk of projections.")),
+       upload_time_(metrics_.histogram(
+               "recon_upload_seconds", "Time to upload a chunk of sinograms to the GPU.")),
+       volume_recon_time_(metrics_.histogram(
+               "recon_volume_reconstruction_seconds", "Time to reconstruct a volume.")),
+       raw_buffer_(raw_buffer_size),
        monitor_(new Monitor()),
        proj_mediator_(new ProjectionMediator(k_PROJECTION_MEDIATOR_BUFFER_SIZE)),
        slice_mediator_(new SliceMediator),
@@ -54,12 +71,24 @@ Application::Application(size_t raw_buffer_size,
        scan_mode_(rpc::ScanMode_Mode_STATIC),
        scan_update_interval_(K_MAX_SCAN_UPDATE_INTERVAL),
        daq_client_(daq_client),
-       rpc_server_(new RpcServer(rpc_config.port, this)) {
+       rpc_server_(new RpcServer(rpc_config.port, this)),
+       pipeline_(new Pipeline({
+           [this] { return preprocess(); },
+           [this] { return fetchSinograms(); },
+           [this] { uploadSinograms(); },
+           [this] { reconstruct(); },
+           [this] { reconstructOnDemand(); }
+       })) {
+    registerMetrics();
 }
 
 Application::~Application() { 
     closing_ = true;
+    // Wake up the consumers waiting in the DAQ client.
+    daq_client_->setAcquiring(false);
     for (auto& t : consumer_threads_) t.join();
+    pipeline_->wait();
+    if (flat_field_refresh_.valid()) flat_field_refresh_.wait();
 }
 
 void Application::setProjectionGeometry(BeamShape beam_shape, uint32_t col_count, uint32_t row_count,
@@ -100,217 +129,307 @@ bool Application::tryComputeReciprocal() {
     }
 
     spdlog::info("Computing reciprocal for flat field correction "
-                 "with {} darks and {} flats ...", darks_.size(), flats_.size());
+                 "with {} darks and {} flats ...", darks_.count(), flats_.count());
 
-    {
+    computeFlatField(darks_, flats_);
+
+    reciprocal_computed_ = true;
+    spdlog::info("Reciprocal computed!");
+
+    return true;
+}
+
+void Application::computeFlatField(const ImageAccumulator& darks, const ImageAccumulator& flats) {
 #if (VERBOSITY >= 2)
-        ScopedTimer timer("Bench", "Computing reciprocal");
+    ScopedTimer timer("Bench", "Computing reciprocal");
 #endif
 
-        recastx::recon::computeReciprocal(darks_, flats_, dark_avg_, reciprocal_,
-                                          {imgproc_params_.downsampling_row, imgproc_params_.downsampling_col});
-    }
+    // The preprocessing could still be using the buffer before the last swap.
+    while (flat_field_back_.use_count() > 1) std::this_thread::yield();
+
+    recastx::recon::computeReciprocal(darks, flats, flat_field_back_->dark_avg, flat_field_back_->reciprocal,
+                                      {imgproc_params_.downsampling_row, imgproc_params_.downsampling_col},
+                                      imgproc_params_.downsampling_mode);
 
+    std::lock_guard lk(flat_field_mtx_);
+    flat_field_.swap(flat_field_back_);
+}
+
+void Application::refreshFlatField() {
+    if (flat_field_refresh_.valid()) flat_field_refresh_.wait();
+
+    // Hand the accumulated images over so that the next acquisition can start right away.
+    auto darks = std::make_shared<ImageAccumulator>(std::move(darks_));
+    auto flats = std::make_shared<ImageAccumulator>(std::move(flats_));
+    darks_.reset();
+    flats_.reset();
     reciprocal_computed_ = true;
-    spdlog::info("Reciprocal computed!");
 
-    return true;
+    spdlog::info("Refreshing reciprocal for flat field correction "
+                 "with {} darks and {} flats in the background ...", darks->count(), flats->count());
+
+    flat_field_refresh_ = std::async(std::launch::async, [this, darks, flats] {
+        pinThread(affinity_.preprocessing);
+        if (!flat_field_back_) {
+            flat_field_back_ = std::make_shared<FlatField>();
+            flat_field_back_->resize(flatField()->dark_avg.shape());
+        }
+        computeFlatField(*darks, *flats);
+        spdlog::info("Reciprocal refreshed!");
+    });
+}
+
+std::shared_ptr<const FlatField> Application::flatField() {
+    std::lock_guard lk(flat_field_mtx_);
+    return flat_field_;
 }
 
 void Application::setPipelinePolicy(bool wait_on_slowness) {
     pipeline_wait_on_slowness_ = wait_on_slowness;
 }
 
+void Application::setCpuAffinity(const PipelineAffinity& affinity) {
+    affinity_ = affinity;
+    preproc_->setCpuAffinity(affinity_.preprocessing);
+    pipeline_->setCpuAffinity(affinity_);
+}
+
+void Application::exposeMetrics(int port) {
+    metrics_server_ = std::make_unique<MetricsServer>(port, metrics_);
+}
+
+void Application::registerMetrics() {
+    metrics_.gauge("recon_daq_queue_depth", "Images received by the DAQ client and not yet consumed.",
+                   [this] { return daq_client_->numQueued(); });
+    metrics_.gauge("recon_raw_buffer_occupied_chunks", "Chunks being filled or ready in the raw buffer.",
+                   [this] { return raw_buffer_.occupied(); });
+    metrics_.gauge("recon_raw_buffer_capacity_chunks", "Capacity of the raw buffer.",
+                   [this] { return raw_buffer_.capacity(); });
+    metrics_.counter("recon_raw_buffer_dropped_chunks_total", "Chunks dropped from the raw buffer before preprocessing.",
+                     [this] { return raw_buffer_.numDroppedChunks(); });
+    metrics_.counter("recon_triple_buffer_dropped_total",
+                     "Reconstructed data overwritten before being sent to the clients.",
+                     [this] { return volume_proxy_->numDropped(); }, {{"buffer", "volume"}});
+    slice_mediator_->registerMetrics(metrics_);
+}
+
 void Application::startConsuming() {
     for (size_t i = 0; i < 2 * daq_client_->concurrency(); ++i) {
         consumer_threads_.emplace_back(&Application::consume, this);
     }
 }
 
-void Application::startPreprocessing() {
-    auto t = std::thread([&] {
-        while (!closing_) {
-            if (waitForProcessing()) continue;
+bool Application::preprocess() {
+    if (closing_ || server_state_.get() != rpc::ServerState_State_PROCESSING) return false;
 
-            if (!raw_buffer_.fetch(100)) continue;
+    maybeStartStreaming();
 
-            {
-                std::lock_guard lck(reciprocal_mtx_);
-                if (!reciprocal_computed_) {
-                    if (!tryComputeReciprocal()) continue;
-                }
-            }
+    if (!raw_buffer_.fetch(0)) return false;
 
-            spdlog::debug("Preprocessing - started");
+    // The flat field is only replaced between two chunks. The streamed projections of the chunk
+    // were corrected with the flat field of the stream.
+    auto flat_field = preproc_->stopStreaming();
+    if (!flat_field) flat_field = flatField();
+    if (!flat_field) {
+        std::lock_guard lck(reciprocal_mtx_);
+        if (!tryComputeReciprocal()) return false;
+        flat_field = flatField();
+    }
 
-            {
+    spdlog::debug("Preprocessing - started");
+
+    {
 #if defined(BENCHMARK)
-                nvtx3::scoped_range sr("Preprocessing projections");
+        nvtx3::scoped_range sr("Preprocessing projections");
 #endif
-                preproc_->process(raw_buffer_, sino_proxy_->buffer(), dark_avg_, reciprocal_, imgproc_params_.offset);
-            }
-
+        LatencyTimer timer(preprocessing_time_);
+        preproc_->process(raw_buffer_, sino_proxy_->buffer(),
+                          flat_field->dark_avg, flat_field->reciprocal, imgproc_params_.offset);
+    }
+    flat_field.reset();
 
+    {
 #if defined(BENCHMARK)
-            nvtx3::scoped_range sr("Waiting for sinogram buffer ready");
+        nvtx3::scoped_range sr("Waiting for sinogram buffer ready");
 #endif
-            while (!sino_proxy_->tryPrepareBuffer(100)) {
-                if (closing_) return;
-            }
-
-            spdlog::debug("Preprocessing - finished");
+        // The pipeline only starts the preprocessing after the last chunk has been taken over.
+        while (!sino_proxy_->tryPrepareBuffer(100)) {
+            if (closing_) return false;
         }
-    });
+    }
+
+    spdlog::debug("Preprocessing - finished");
 
-    t.detach();
+    // Stream the next chunk into the buffer just released.
+    maybeStartStreaming();
+    return true;
 }
 
-void Application::startUploading() {
+void Application::maybeStartStreaming() {
+    if (!stream_preprocessing_ || preproc_->streaming()) return;
 
-    auto t = std::thread([&] {
-        while (!closing_) {
-            if(waitForProcessing()) continue;
+    // The projections which arrive before the flat field is ready are processed with the chunk.
+    auto flat_field = flatField();
+    if (!flat_field) return;
 
-            if (!sino_proxy_->fetchData(100)) continue;
+    preproc_->startStreaming(sino_proxy_->buffer(), group_size_, std::move(flat_field), imgproc_params_.offset);
+    spdlog::debug("Preprocessing - streaming");
+}
 
-            {
-                spdlog::debug("Uploading sinograms to GPU - started");
+bool Application::fetchSinograms() {
+    return sino_proxy_->fetchData(0);
+}
+
+void Application::uploadSinograms() {
+    spdlog::debug("Uploading sinograms to GPU - started");
 
 #if defined(BENCHMARK)
-                nvtx3::scoped_range sr("Uploading sinograms to GPU");
+    nvtx3::scoped_range sr("Uploading sinograms to GPU");
 #endif
+    LatencyTimer timer(upload_time_);
 
-                if (double_buffering_) {
-                    recon_->uploadSinograms(1 - gpu_buffer_index_, sino_proxy_.get());
-
-                    std::lock_guard<std::mutex> lck(recon_mtx_);
-                    gpu_buffer_index_ = 1 - gpu_buffer_index_;
-                    sino_uploaded_ = true;
-                } else {
-                    std::lock_guard<std::mutex> lck(recon_mtx_);
-                    recon_->uploadSinograms(gpu_buffer_index_, sino_proxy_.get());
-                    sino_uploaded_ = true;
-                }
-
-                sino_initialized_ = true;
+    if (double_buffering_) {
+        recon_->uploadSinograms(1 - gpu_buffer_index_, sino_proxy_.get());
 
-                spdlog::debug("Uploading sinograms to GPU - finished");
-            }
+        std::lock_guard<std::mutex> lck(recon_mtx_);
+        gpu_buffer_index_ = 1 - gpu_buffer_index_;
+        sino_uploaded_ = true;
+    } else {
+        std::lock_guard<std::mutex> lck(recon_mtx_);
+        recon_->uploadSinograms(gpu_buffer_index_, sino_proxy_.get());
+        sino_uploaded_ = true;
+    }
 
-            recon_cv_.notify_one();
-        }
-    });
+    sino_initialized_ = true;
 
-    t.detach();
+    spdlog::debug("Uploading sinograms to GPU - finished");
 }
 
+void Application::reconstruct() {
+    std::lock_guard<std::mutex> lck(recon_mtx_);
+    // Sinograms uploaded during the last reconstruction are only reconstructed once.
+    if (!sino_uploaded_) return;
 
-void Application::startReconstructing() {
-
-    auto t = std::thread([&] {
-        while (!closing_) {
-            {
-                std::unique_lock<std::mutex> lck(recon_mtx_);
-                if (recon_cv_.wait_for(lck, 10ms, [&] { return sino_uploaded_; })) {
-
-                    if (volume_required_) {
-                        spdlog::debug("Reconstructing volume - started");
+    if (volume_required_) {
+        spdlog::debug("Reconstructing volume - started");
 
 #if defined(BENCHMARK)
-                        nvtx3::scoped_range sr("Reconstructing volume");
+        nvtx3::scoped_range sr("Reconstructing volume");
 #endif
+        LatencyTimer timer(volume_recon_time_);
 
-                        recon_->reconstructVolume(gpu_buffer_index_, volume_proxy_->buffer());
-                    }
-
-                    spdlog::debug("Reconstructing slices - started");
+        recon_->reconstructVolume(gpu_buffer_index_, volume_proxy_->buffer());
+    }
 
+    spdlog::debug("Reconstructing slices - started");
 
+    {
 #if defined(BENCHMARK)
-                    nvtx3::scoped_range sr("Reconstructing all slices");
+        nvtx3::scoped_range sr("Reconstructing all slices");
 #endif
 
-                    slice_mediator_->reconAll(recon_.get(), gpu_buffer_index_);
+        slice_mediator_->reconAll(recon_.get(), gpu_buffer_index_);
+    }
 
-                    sino_uploaded_ = false;
+    sino_uploaded_ = false;
 
-                    monitor_->countTomogram();
+    monitor_->countTomogram();
+    tomograms_reconstructed_.add();
 
-                    spdlog::debug("Reconstructing - finished");
+    spdlog::debug("Reconstructing - finished");
 
-                    if (volume_proxy_->prepareBuffer()) {
-                        spdlog::debug("Reconstructed volume dropped due to slowness of clients");
-                    }
+    if (volume_proxy_->prepareBuffer()) {
+        spdlog::debug("Reconstructed volume dropped due to slowness of clients");
+    }
+}
+
+void Application::reconstructOnDemand() {
+    std::lock_guard<std::mutex> lck(recon_mtx_);
+    if (!sino_initialized_) return;
 
-                } else {
-                    if (sino_initialized_) {
 #if defined(BENCHMARK)
-                        nvtx3::scoped_range sr("Reconstructing on-demand slices");
+    nvtx3::scoped_range sr("Reconstructing on-demand slices");
 #endif
-                        slice_mediator_->reconOnDemand(recon_.get(), gpu_buffer_index_);
-                    }
-
-                    continue;
-                }
-            }
-        }
 
-    });
-
-    t.detach();
+    slice_mediator_->reconOnDemand(recon_.get(), gpu_buffer_index_);
 }
 
 void Application::consume() {
+    pinThread(affinity_.daq);
+
     Projection<> proj;
     while (!closing_) {
         if (!daq_client_->next(proj)) continue;
 
+        if (recorder_ != nullptr) recorder_->push(proj);
+
         switch(proj.type) {
             case ProjectionType::PROJECTION: {
-                if (server_state_ == rpc::ServerState_State_PROCESSING) {
+                if (server_state_.get() == rpc::ServerState_State_PROCESSING) {
+                    // Compute the reciprocal while the first chunk is being filled. The flat
+                    // field in use is kept until the new one is ready.
+                    if (!reciprocal_computed_) {
+                        std::lock_guard lck(reciprocal_mtx_);
+                        if (!reciprocal_computed_ && (!darks_.empty() || !flats_.empty())) {
+                            if (flatField()) {
+                                refreshFlatField();
+                            } else if (tryComputeReciprocal() && stream_preprocessing_) {
+                                // Start streaming the first chunk.
+                                pipeline_->ingest();
+                            }
+                        }
+                    }
                     pushProjection(proj);
                 }
 
                 proj_mediator_->push(std::move(proj));
                 if (monitor_->numProjections() == 0) monitor_->resetPerf();
                 monitor_->countProjection();
+                projections_received_.add();
                 break;
             }
             case ProjectionType::DARK: {
                 std::lock_guard lck(reciprocal_mtx_);
-                if (server_state_ == rpc::ServerState_State_PROCESSING) {
+                if (server_state_.get() == rpc::ServerState_State_PROCESSING) {
                     maybeResetDarkAndFlatAcquisition();
                     pushDark(std::move(proj));
                 }
                 if (monitor_->numProjections() != 0) monitor_->reset();
                 monitor_->countDark();
+                darks_received_.add();
                 break;
             }
             case ProjectionType::FLAT: {
                 std::lock_guard lck(reciprocal_mtx_);
-                if (server_state_ == rpc::ServerState_State_PROCESSING) {
+                if (server_state_.get() == rpc::ServerState_State_PROCESSING) {
                     maybeResetDarkAndFlatAcquisition();
                     pushFlat(std::move(proj));
                 }
                 if (monitor_->numProjections() != 0) monitor_->reset();
                 monitor_->countFlat();
+                flats_received_.add();
                 break;
             }
             default:
                 throw std::runtime_error("Unexpected projection type");
         }
+
+        ++num_consumed_;
+        if (draining_) server_state_.notify();
     }
 }
 
+bool Application::daqDrained() const {
+    // A projection is counted as taken by the DAQ client when it leaves the queue. Therefore,
+    // none is in flight if nothing is queued and no more than the consumed ones have been taken.
+    size_t consumed = num_consumed_;
+    return daq_client_->numQueued() == 0 && daq_client_->numTaken() == consumed;
+}
+
 void Application::spin() {
-    startReconstructing();
-    startUploading();
-    startPreprocessing();
     startConsuming();
 
-    if (server_state_ == rpc::ServerState_State_UNKNOWN) {
-        server_state_ = rpc::ServerState_State_READY;
-    }
+    server_state_.transit(rpc::ServerState_State_UNKNOWN, rpc::ServerState_State_READY);
 
     daq_client_->spin();
     rpc_server_->spin();
@@ -343,6 +462,7 @@ void Application::setProjectionReq(size_t id) {
 
 void Application::setSliceReq(size_t timestamp, const Orientation& orientation) {
     slice_mediator_->update(timestamp, orientation);
+    pipeline_->requestOnDemand();
 }
 
 void Application::setVolumeReq(bool required) {
@@ -362,18 +482,18 @@ void Application::setScanMode(rpc::ScanMode_Mode mode, uint32_t update_interval)
 }
 
 void Application::startAcquiring() {
-    if (server_state_ == rpc::ServerState_State_ACQUIRING) {
+    if (server_state_.get() == rpc::ServerState_State_ACQUIRING) {
         spdlog::warn("Server already in state ACQUIRING");
         return;
     }
-    if (server_state_ == rpc::ServerState_State_PROCESSING) {
+    if (server_state_.get() == rpc::ServerState_State_PROCESSING) {
         spdlog::warn("Server already in state PROCESSING");
         return;
     }
 
     initParams();
 
-    server_state_ = rpc::ServerState_State_ACQUIRING;
+    server_state_.set(rpc::ServerState_State_ACQUIRING);
     spdlog::info("Preparing for acquiring data");
 
     monitor_.reset(new Monitor(0, group_size_));
@@ -382,14 +502,14 @@ void Application::startAcquiring() {
 }
 
 void Application::stopAcquiring() {
-    if (server_state_ != rpc::ServerState_State_ACQUIRING) {
+    if (server_state_.get() != rpc::ServerState_State_ACQUIRING) {
         spdlog::warn("Server not in state ACQUIRING");
         return;
     }
 
     daq_client_->setAcquiring(false);
 
-    server_state_ = rpc::ServerState_State_READY;
+    server_state_.set(rpc::ServerState_State_READY);
     spdlog::info("Stopping acquiring data");
 
     proj_mediator_->reset();
@@ -397,14 +517,14 @@ void Application::stopAcquiring() {
 }
 
 void Application::startProcessing() {
-    if (server_state_ == rpc::ServerState_State_PROCESSING) {
+    if (server_state_.get() == rpc::ServerState_State_PROCESSING) {
         spdlog::warn("Server already in state PROCESSING");
         return;
     }
 
     init();
 
-    server_state_ = rpc::ServerState_State_PROCESSING;
+    server_state_.set(rpc::ServerState_State_PROCESSING);
     spdlog::info("Preparing for acquiring and processing data:");
 
     if (scan_mode_ == rpc::ScanMode_Mode_CONTINUOUS) {
@@ -422,17 +542,21 @@ void Application::startProcessing() {
 }
 
 void Application::stopProcessing() {
-    if (server_state_ != rpc::ServerState_State_PROCESSING) {
+    if (server_state_.get() != rpc::ServerState_State_PROCESSING) {
         spdlog::warn("Server not in state PROCESSING");
         return;
     }
 
     daq_client_->setAcquiring(false);
 
-    // TODO: find a better solution to empty the DAQ buffer
-    std::this_thread::sleep_for(std::chrono::microseconds(1000));
+    // The projections received before stopping are still processed.
+    draining_ = true;
+    if (!server_state_.waitUntil([this](auto) { return daqDrained(); }, k_DAQ_DRAIN_TIMEOUT)) {
+        spdlog::warn("Timeout when draining the DAQ buffer: {} projections left", daq_client_->numQueued());
+    }
+    draining_ = false;
 
-    server_state_ = rpc::ServerState_State_READY;
+    server_state_.set(rpc::ServerState_State_READY);
     spdlog::info("Stopping acquiring and processing data");
 
     proj_mediator_->reset();
@@ -442,9 +566,9 @@ void Application::stopProcessing() {
 std::optional<rpc::ProjectionData> Application::getProjectionData(int timeout) {
     ProjectionMediator::DataType proj;
     if (proj_mediator_->waitAndPop(proj, timeout)) {
-        auto [y, x] = proj.data.shape();
+        auto [y, x] = proj.shape();
         auto mod = angle_count_ == 0 ? 1 : angle_count_;
-        return createProjectionDataPacket(proj.index % mod, x, y, proj.data);
+        return createProjectionDataPacket(proj.index % mod, x, y, proj.bytes(), x * y * sizeof(RawDtype));
     }
     return std::nullopt;
 }
@@ -505,6 +629,9 @@ void Application::init() {
 
     spdlog::info("[Init] - Projection size: {} ({}/{}) x {} ({}/{})",
                  col_count, orig_col_count_, ds_col, row_count, orig_row_count_, ds_row);
+    spdlog::info("[Init] - Downsampling mode: {} (SIMD: {})",
+                 imgproc_params_.downsampling_mode == DownsamplingMode::BINNING ? "binning" : "decimation",
+                 simd::isaName(simd::isa()));
     spdlog::info("[Init] - Number of projections per scan: {}", angle_count_);
 
     maybeInitFlatFieldBuffer(row_count, col_count);
@@ -513,7 +640,8 @@ void Application::init() {
 
     initReconstructor(col_count, row_count);
 
-    preproc_->init(raw_buffer_, col_count, row_count, imgproc_params_, paganin_cfg_);
+    // The workspace is first touched by the preprocessing CPUs.
+    runOn(affinity_.preprocessing, [&] { preproc_->init(col_count, row_count, imgproc_params_, paganin_cfg_); });
 
     spdlog::info("[Init] ------------------------------------------------------------");
 }
@@ -532,27 +660,33 @@ void Application::initParams() {
 
 void Application::maybeInitFlatFieldBuffer(uint32_t row_count, uint32_t col_count) {
     if (!darks_.empty()) {
-        auto& shape = darks_[0].shape();
+        auto& shape = darks_.shape();
         if (shape[0] != orig_row_count_ || shape[1] != orig_col_count_) {
-            darks_.clear();
+            darks_.reset();
             spdlog::debug("Dark image buffer reset");
         }
     }
 
     if (!flats_.empty()) {
-        auto& shape = flats_[0].shape();
+        auto& shape = flats_.shape();
         if (shape[0] != orig_row_count_ || shape[1] != orig_col_count_) {
-            flats_.clear();
+            flats_.reset();
             spdlog::debug("Flat image buffer reset");
         }
     }
 
-    auto shape = dark_avg_.shape();
-    if (shape[0] != row_count || shape[1] != col_count) {
-        dark_avg_.resize({row_count, col_count});
-        reciprocal_.resize({row_count, col_count});
-        spdlog::debug("Reciprocal buffer resized");
+    if (flat_field_refresh_.valid()) flat_field_refresh_.wait();
+    {
+        // The flat field of the last scan is discarded, but its memory is kept.
+        std::lock_guard lk(flat_field_mtx_);
+        if (!flat_field_back_) flat_field_back_ = std::move(flat_field_);
+        flat_field_.reset();
     }
+    if (!flat_field_back_) flat_field_back_ = std::make_shared<FlatField>();
+    while (flat_field_back_.use_count() > 1) std::this_thread::yield();
+    runOn(affinity_.preprocessing, [&] {
+        if (flat_field_back_->resize({row_count, col_count})) spdlog::debug("Reciprocal buffer resized");
+    });
 
     reciprocal_computed_ = false;
 }
@@ -563,8 +697,8 @@ void Application::maybeInitDataBuffer(uint32_t col_count, uint32_t row_count) {
 
     auto shape = raw_buffer_.shape();
     if (shape[0] != group_size_ || shape[1] != row_count || shape[2] != col_count) {
-        raw_buffer_.resize({group_size_, row_count, col_count});
-        sino_proxy_->reshapeBuffer({group_size_, row_count, col_count});
+        runOn(affinity_.preprocessing, [&] { raw_buffer_.resize({group_size_, row_count, col_count}); });
+        runOn(affinity_.upload, [&] { sino_proxy_->reshapeBuffer({group_size_, row_count, col_count}); });
         spdlog::debug("Reconstruction buffers resized");
     }
     sino_proxy_->setAngleCount(angle_count_);
@@ -617,27 +751,32 @@ void Application::initReconstructor(uint32_t col_count, uint32_t row_count) {
 }
 
 void Application::maybeResetDarkAndFlatAcquisition() {
+    // Data in the memory buffer are kept and processed with the current flat field until the
+    // new one is ready.
     if (reciprocal_computed_) {
-        raw_buffer_.reset();
-        darks_.clear();
-        flats_.clear();
+        darks_.reset();
+        flats_.reset();
         reciprocal_computed_ = false;
+        // The frame index of the projections could restart after the darks and flats.
+        raw_buffer_.expectRestart();
         spdlog::info("Re-collecting dark and flat images");
     }
 }
 
 void Application::pushDark(Projection<>&& proj) {
-    darks_.emplace_back(std::move(proj.data));
-    if (darks_.size() > k_MAX_NUM_DARKS) {
+    if (darks_.count() >= k_MAX_NUM_DARKS) {
         spdlog::warn("Maximum number of dark images received. Data ignored!");
+        return;
     }
+    darks_.push(proj.bytes(), proj.shape());
 }
 
 void Application::pushFlat(Projection<>&& proj) {
-    flats_.emplace_back(std::move(proj.data));
-    if (flats_.size() > k_MAX_NUM_FLATS) {
+    if (flats_.count() >= k_MAX_NUM_FLATS) {
         spdlog::warn("Maximum number of flat images received. Data ignored!");
+        return;
     }
+    flats_.push(proj.bytes(), proj.shape());
 }
 
 void Application::pushProjection(const Projection<>& proj) {
@@ -645,11 +784,18 @@ void Application::pushProjection(const Projection<>& proj) {
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
 
-    raw_buffer_.fill<RawDtype>(proj.index,
-                               reinterpret_cast<const char*>(proj.data.data()),
-                               proj.data.shape(),
-                               {imgproc_params_.downsampling_row, imgproc_params_.downsampling_col});
+    bool completed = raw_buffer_.fill<RawDtype>(
+            proj.index,
+            proj.bytes(),
+            proj.shape(),
+            {imgproc_params_.downsampling_row, imgproc_params_.downsampling_col},
+            imgproc_params_.downsampling_mode,
+            [this](size_t chunk_idx, size_t data_idx, const RawDtype* data) {
+                if (stream_preprocessing_) preproc_->streamProjection(chunk_idx, data_idx, data);
+            });
     spdlog::debug("Projection {} copied to the memory buffer", proj.index);
+
+    if (completed) pipeline_->ingest();
 }
 
 } // namespace recastx::recon
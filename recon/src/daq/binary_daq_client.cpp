@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <cstring>
+#include <memory>
+
+#include <spdlog/spdlog.h>
+
+#include "recon/daq/binary_daq_client.hpp"
+
+namespace recastx::recon {
+
+BinaryDaqClient::BinaryDaqClient(const std::string& endpoint, const std::string& socket_type, size_t concurrency,
+                                 const ZmqClientConfig& config)
+        : ZmqDaqClient(endpoint, socket_type, concurrency, config) {}
+
+std::optional<Projection<>>
+BinaryDaqClient::parse(const zmq::message_t& header, zmq::message_t&& data) {
+    if (header.size() != sizeof(BinaryFrameHeader)) {
+        spdlog::error("[DAQ client] Invalid header size: {}", header.size());
+        return std::nullopt;
+    }
+
+    BinaryFrameHeader h;
+    std::memcpy(&h, header.data(), sizeof h);
+    if (h.magic != BinaryFrameHeader::MAGIC || h.version != BinaryFrameHeader::VERSION) {
+        spdlog::error("[DAQ client] Invalid header: magic = {:#x}, version = {}", h.magic, h.version);
+        return std::nullopt;
+    }
+
+    if (h.dtype != BinaryFrameHeader::UINT16) {
+        spdlog::error("[DAQ client] Unsupported data type: {}", h.dtype);
+        return std::nullopt;
+    }
+
+    ProjectionType proj_type = parseProjectionType(h.scan_index);
+    if (proj_type == ProjectionType::UNKNOWN) {
+        spdlog::error("Unknown scan index: {}", h.scan_index);
+        return std::nullopt;
+    }
+
+    size_t num_rows = h.num_rows;
+    size_t num_cols = h.num_cols;
+    if (!validate(num_rows, num_cols)) return std::nullopt;
+
+    if (data.size() != sizeof(RawDtype) * num_rows * num_cols) {
+        spdlog::error("[DAQ client] Data size does not match the shape: {} / {} x {}",
+                      data.size(), num_rows, num_cols);
+        return std::nullopt;
+    }
+
+    auto msg = std::make_shared<zmq::message_t>(std::move(data));
+    const void* ptr = msg->data();
+    return Projection<>{proj_type, h.frame, num_cols, num_rows, std::move(msg), ptr};
+}
+
+} // namespace recastx::recon
\ No newline at end of file
@@ -0,0 +1,211 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include "recon/daq/replay_daq_client.hpp"
+
+namespace recastx::recon {
+
+namespace {
+
+uint64_t duration(uint64_t first, uint64_t last, size_t count) {
+    if (count <= 1 || last <= first) return 0;
+    // Add one average frame interval so that the next loop does not start with a burst.
+    return (last - first) + (last - first) / (count - 1);
+}
+
+} // namespace
+
+ReplayDaqClient::ReplayDaqClient(const std::string& path, double speed, bool loop, size_t concurrency)
+        : DaqClientInterface(concurrency), speed_(speed), loop_(loop) {
+    if (speed_ < 0) throw std::invalid_argument(fmt::format("Invalid replay speed: {}", speed_));
+
+    readIndex(rawStreamIndexPath(path));
+    mapData(path);
+    initLoop();
+
+    spdlog::info("[DAQ client] Replaying {} frames from {}", entries_.size(), path);
+    spdlog::info("[DAQ client] - Speed: {}, loop: {}",
+                 speed_ == 0. ? "unlimited" : fmt::format("{}x", speed_), loop_);
+}
+
+void ReplayDaqClient::spin() {
+    spdlog::info("[DAQ client] Starting DAQ client (replay)");
+}
+
+bool ReplayDaqClient::next(Projection<>& proj) {
+    // Return periodically so that the caller can check its own state.
+    if (!acquiring_.waitFor(true, 100)) return false;
+
+    const RawStreamIndexEntry* entry;
+    size_t loop;
+    uint64_t t;
+    if (!locate(cursor_++, entry, loop, t)) {
+        // Wait for the acquisition to be stopped instead of spinning at the end of the replay.
+        acquiring_.waitFor(false, 100);
+        return false;
+    }
+
+    if (speed_ > 0.) {
+        clock::time_point start;
+        {
+            std::lock_guard lck(mtx_);
+            start = start_;
+        }
+        auto deadline = start + std::chrono::nanoseconds(static_cast<uint64_t>(static_cast<double>(t) / speed_));
+        // Stopping the acquisition wakes up the waiting, which can be long if there is a gap
+        // in the recording.
+        if (acquiring_.waitUntil([](bool acquiring) { return !acquiring; }, deadline)) return false;
+    }
+
+    ProjectionType proj_type = parseProjectionType(entry->scan_index);
+    if (proj_type == ProjectionType::UNKNOWN) {
+        spdlog::error("Unknown scan index: {}", entry->scan_index);
+        return false;
+    }
+    if (!validate(entry->num_rows, entry->num_cols)) return false;
+
+    // The frame is counted as queued until it is taken, so that it is not missed when draining.
+    // A frame is not taken once the acquisition has been stopped.
+    ++pending_;
+    if (!acquiring_.get()) {
+        --pending_;
+        return false;
+    }
+    proj = Projection<>{proj_type, entry->frame + loop * loop_frame_span_, entry->num_cols, entry->num_rows,
+                        mapping_, static_cast<const char*>(mapping_.get()) + entry->offset};
+    ++taken_;
+    --pending_;
+    return true;
+}
+
+void ReplayDaqClient::setAcquiring(bool state) {
+    if (state) restart();
+    DaqClientInterface::setAcquiring(state);
+}
+
+void ReplayDaqClient::startAcquiring(uint32_t num_rows, uint32_t num_cols) {
+    restart();
+    DaqClientInterface::startAcquiring(num_rows, num_cols);
+}
+
+void ReplayDaqClient::readIndex(const std::string& path) {
+    std::ifstream fs(path, std::ios::binary);
+    if (!fs) throw std::runtime_error(fmt::format("Failed to open index file: {}", path));
+
+    RawStreamHeader header;
+    if (!fs.read(reinterpret_cast<char*>(&header), sizeof header)
+            || header.magic != RawStreamHeader::MAGIC
+            || header.version != RawStreamHeader::VERSION
+            || header.entry_size != sizeof(RawStreamIndexEntry)) {
+        throw std::runtime_error(fmt::format("Invalid index file: {}", path));
+    }
+    if (header.dtype != 2) {
+        throw std::runtime_error(fmt::format("Unsupported data type in {}: {}", path, header.dtype));
+    }
+
+    RawStreamIndexEntry entry;
+    while (fs.read(reinterpret_cast<char*>(&entry), sizeof entry)) entries_.push_back(entry);
+
+    if (entries_.empty()) throw std::runtime_error(fmt::format("No frame found in {}", path));
+}
+
+void ReplayDaqClient::mapData(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error(fmt::format("Failed to open data file {}: {}", path, std::strerror(errno)));
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error(fmt::format("Failed to read data file: {}", path));
+    }
+    file_size_ = static_cast<size_t>(st.st_size);
+
+    void* ptr = ::mmap(nullptr, file_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        throw std::runtime_error(fmt::format("Failed to map data file {}: {}", path, std::strerror(errno)));
+    }
+    ::madvise(ptr, file_size_, MADV_SEQUENTIAL);
+
+    // Projections returned by next() keep the mapping alive.
+    size_t size = file_size_;
+    mapping_ = std::shared_ptr<const void>(ptr, [size](const void* p) { ::munmap(const_cast<void*>(p), size); });
+
+    for (const auto& entry : entries_) {
+        if (entry.offset + sizeof(RawDtype) * entry.num_rows * entry.num_cols > file_size_) {
+            throw std::runtime_error(fmt::format("Frame {} is out of the range of {}", entry.frame, path));
+        }
+    }
+}
+
+void ReplayDaqClient::initLoop() {
+    uint64_t t_max = 0;
+    uint64_t proj_t_max = 0;
+    uint64_t frame_min = std::numeric_limits<uint64_t>::max();
+    uint64_t frame_max = 0;
+    t0_ = std::numeric_limits<uint64_t>::max();
+    proj_t0_ = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const auto& entry = entries_[i];
+        t0_ = std::min(t0_, entry.timestamp);
+        t_max = std::max(t_max, entry.timestamp);
+        if (entry.scan_index == static_cast<int>(ProjectionType::PROJECTION)) {
+            projections_.push_back(i);
+            proj_t0_ = std::min(proj_t0_, entry.timestamp);
+            proj_t_max = std::max(proj_t_max, entry.timestamp);
+            frame_min = std::min(frame_min, entry.frame);
+            frame_max = std::max(frame_max, entry.frame);
+        }
+    }
+
+    first_duration_ = duration(t0_, t_max, entries_.size());
+    if (projections_.empty()) {
+        if (loop_) spdlog::warn("[DAQ client] No projection to replay in loop");
+        loop_ = false;
+        return;
+    }
+    loop_duration_ = duration(proj_t0_, proj_t_max, projections_.size());
+    loop_frame_span_ = frame_max - frame_min + 1;
+}
+
+void ReplayDaqClient::restart() {
+    std::lock_guard lck(mtx_);
+    cursor_ = 0;
+    start_ = clock::now();
+}
+
+bool ReplayDaqClient::locate(size_t i, const RawStreamIndexEntry*& entry, size_t& loop, uint64_t& t) const {
+    if (i < entries_.size()) {
+        entry = &entries_[i];
+        loop = 0;
+        t = entry->timestamp - t0_;
+        return true;
+    }
+
+    if (!loop_) return false;
+
+    size_t j = i - entries_.size();
+    loop = 1 + j / projections_.size();
+    entry = &entries_[projections_[j % projections_.size()]];
+    t = first_duration_ + (loop - 1) * loop_duration_ + (entry->timestamp - proj_t0_);
+    return true;
+}
+
+} // namespace recastx::recon
\ No newline at end of file
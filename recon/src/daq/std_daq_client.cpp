@@ -6,8 +6,8 @@
  *
  * The full license is in the file LICENSE, distributed with this software.
 */
-#include <cassert>
 #include <iostream>
+#include <memory>
 
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
@@ -16,11 +16,27 @@
 
 namespace recastx::recon {
 
-StdDaqClient::StdDaqClient(const std::string& endpoint, const std::string& socket_type, size_t concurrency)
-        : ZmqDaqClient(endpoint, socket_type, concurrency) {}
+StdDaqClient::StdDaqClient(const std::string& endpoint, const std::string& socket_type, size_t concurrency,
+                           const ZmqClientConfig& config)
+        : ZmqDaqClient(endpoint, socket_type, concurrency, config) {}
+
+std::optional<Projection<>> StdDaqClient::parse(const zmq::message_t& header, zmq::message_t&& data) {
+    auto meta = parseMeta(header);
+    if (!meta) return std::nullopt;
+    return parseData(meta.value(), std::move(data));
+}
+
+std::optional<nlohmann::json> StdDaqClient::parseMeta(const zmq::message_t& msg) {
+    try {
+        return nlohmann::json::parse(msg.to_string());
+    } catch (const nlohmann::json::parse_error& ex) {
+        spdlog::error("[DAQ client] Failed to parse metadata: {}", ex.what());
+        return std::nullopt;
+    }
+}
 
 std::optional<Projection<>>
-StdDaqClient::parseData(const nlohmann::json& meta, const zmq::message_t& data) {
+StdDaqClient::parseData(const nlohmann::json& meta, zmq::message_t&& data) {
     size_t frame = meta["frame"];
     int scan_index = meta["image_attributes"]["scan_index"]; 
     ProjectionType proj_type = parseProjectionType(scan_index);
@@ -32,8 +48,16 @@ StdDaqClient::parseData(const nlohmann::json& meta, const zmq::message_t& data)
     size_t num_cols = meta["shape"][1];
     if (!validate(num_rows, num_cols)) return std::nullopt;
 
-    assert(data.size() == sizeof(RawDtype) * num_rows * num_cols);
-    return Projection<>{proj_type, frame, num_cols, num_rows, data.data(), data.size()};
+    if (data.size() != sizeof(RawDtype) * num_rows * num_cols) {
+        spdlog::error("[DAQ client] Data size does not match the shape: {} / {} x {}",
+                      data.size(), num_rows, num_cols);
+        return std::nullopt;
+    }
+
+    // The message is kept alive by the projection and released after being copied to the memory buffer.
+    auto msg = std::make_shared<zmq::message_t>(std::move(data));
+    const void* ptr = msg->data();
+    return Projection<>{proj_type, frame, num_cols, num_rows, std::move(msg), ptr};
 }
 
 } // namespace recastx::recon
\ No newline at end of file
@@ -6,8 +6,9 @@
  *
  * The full license is in the file LICENSE, distributed with this software.
 */
-#include <cassert>
 #include <chrono>
+#include <cstring>
+#include <functional>
 #include <iostream>
 
 #include <spdlog/spdlog.h>
@@ -17,26 +18,51 @@
 
 namespace recastx::recon {
 
-ZmqDaqClient::ZmqDaqClient(const std::string& endpoint, const std::string& socket_type, size_t concurrency)
+ZmqDaqClient::ZmqDaqClient(const std::string& endpoint, const std::string& socket_type, size_t concurrency,
+                           const ZmqClientConfig& config)
         : DaqClientInterface(concurrency),
-          buffer_(k_DAQ_BUFFER_SIZE),
-          context_(1),
-          socket_(context_, parseSocketType(socket_type)) {
-    socket_.set(zmq::sockopt::rcvtimeo, 100);
-    socket_.set(zmq::sockopt::rcvhwm, 1);
-    socket_.connect(endpoint);
-
-    if(socket_.get(zmq::sockopt::type) == static_cast<int>(zmq::socket_type::sub)) {
+          buffer_(k_DAQ_BUFFER_SIZE, QueuePolicy::BLOCK),
+          context_(config.io_threads),
+          pool_(config.pool_size > 0 ? std::make_unique<BufferPool<RawDtype>>(0, config.pool_size) : nullptr),
+          cpus_(config.cpus) {
+#if defined(ZMQ_THREAD_AFFINITY_CPU_ADD)
+    // Must be set before the I/O threads are started by the first socket.
+    for (auto cpu : cpus_.cpus()) zmq_ctx_set(context_.handle(), ZMQ_THREAD_AFFINITY_CPU_ADD, cpu);
+#endif
+
+    auto type = parseSocketType(socket_type);
+    // Every SUB socket receives a full copy of the data stream. Therefore, only PULL sockets
+    // can be used to share the data stream among multiple receiving threads.
+    size_t num_sockets = type == zmq::socket_type::sub ? 1 : concurrency_;
+    for (size_t i = 0; i < num_sockets; ++i) {
+        auto& socket = sockets_.emplace_back(context_, type);
+        socket.set(zmq::sockopt::rcvtimeo, 100);
+        socket.set(zmq::sockopt::rcvhwm, config.rcvhwm);
+        if (config.rcvbuf > 0) socket.set(zmq::sockopt::rcvbuf, config.rcvbuf);
+        if (type == zmq::socket_type::sub) socket.set(zmq::sockopt::subscribe, "");
+        socket.connect(endpoint);
+    }
+
+    if (type == zmq::socket_type::sub) {
         spdlog::info("[DAQ client] Connected to data server (PUB-SUB) at {}", endpoint);
-        socket_.set(zmq::sockopt::subscribe, "");
-    } else if (socket_.get(zmq::sockopt::type) == static_cast<int>(zmq::socket_type::pull)) {
-        spdlog::info("[DAQ client] Connected to data server (PUSH-PULL) {}", endpoint);
+        if (concurrency_ > 1) {
+            spdlog::warn("[DAQ client] Only one socket is used to receive data in PUB-SUB mode");
+        }
+    } else {
+        spdlog::info("[DAQ client] Connected to data server (PUSH-PULL) {} with {} sockets",
+                     endpoint, num_sockets);
     }
+    spdlog::info("[DAQ client] - ZMQ I/O threads: {}, receive high water mark: {}",
+                 config.io_threads, config.rcvhwm);
+    if (pool_) spdlog::info("[DAQ client] - Frame buffer pool size: {}", config.pool_size);
+    if (!cpus_.empty()) spdlog::info("[DAQ client] - CPUs: {}", cpus_.str());
 }
 
 ZmqDaqClient::~ZmqDaqClient() {
     running_ = false;
-    socket_.set(zmq::sockopt::linger, 200);
+    acquiring_.notify();
+    for (auto& t : threads_) t.join();
+    for (auto& socket : sockets_) socket.set(zmq::sockopt::linger, 200);
 }
 
 void ZmqDaqClient::spin() {
@@ -45,51 +71,60 @@ void ZmqDaqClient::spin() {
         return;
     }
 
-    spdlog::info("[DAQ client] Starting DAQ client (concurrency = {})", concurrency_);
+    spdlog::info("[DAQ client] Starting DAQ client (concurrency = {})", sockets_.size());
 
     running_ = true;
-    for (size_t i = 0; i < concurrency_; ++i) {
-        auto t = std::thread([&] {
-            zmq::message_t update;
-            std::optional<nlohmann::json> meta;
-            while (running_) {
-                if (!acquiring_) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    continue;
-                }
-
-                {
-                    std::lock_guard lk(mtx_);
-                    auto result = socket_.recv(update, zmq::recv_flags::none);
-                    if (!result) continue;
-
-                    assert(update.more());
-
-                    meta = parseMeta(update);
-                    if (!meta) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                        continue;
-                    }
-
-                    while (running_) {
-                        auto result = socket_.recv(update, zmq::recv_flags::none);
-                        if (result.has_value() || !acquiring_) break;
-                    }
-                }
-
-                assert(!update.more());
-
-                auto data = parseData(meta.value(), update);
-                if (!data) continue;
-
-                while (running_) {
-                    if (buffer_.tryPush(data.value())) break;
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                }
+    for (auto& socket : sockets_) {
+        threads_.emplace_back(&ZmqDaqClient::receive, this, std::ref(socket));
+    }
+}
+
+void ZmqDaqClient::receive(zmq::socket_t& socket) {
+    pinThread(cpus_);
+
+    zmq::message_t header;
+    zmq::message_t update;
+    while (running_) {
+        if (!acquiring_.get()) {
+            acquiring_.waitUntil([this](bool acquiring) { return acquiring || !running_; });
+            continue;
+        }
+
+        auto result = socket.recv(header, zmq::recv_flags::none);
+        if (!result) continue;
+
+        if (!header.more()) {
+            spdlog::error("[DAQ client] Received a single-part message");
+            continue;
+        }
+
+        bool received = false;
+        while (running_ && acquiring_.get()) {
+            if (socket.recv(update, zmq::recv_flags::none)) {
+                received = true;
+                break;
             }
-        });
+        }
+        if (!received) continue;
+
+        if (update.more()) {
+            spdlog::error("[DAQ client] Received a message with more than two parts");
+            // Drain the remaining parts.
+            while (update.more() && socket.recv(update, zmq::recv_flags::none)) {}
+            continue;
+        }
+
+        // Frames received after stopping are not queued, so that the buffer can be drained.
+        if (!acquiring_.get()) continue;
+
+        auto data = parse(header, std::move(update));
+        if (!data) continue;
 
-        t.detach();
+        if (pool_ && !recycle(data.value())) continue;
+
+        while (running_) {
+            if (buffer_.push(std::move(data.value()), 10)) break;
+        }
     }
 }
 
@@ -97,6 +132,14 @@ bool ZmqDaqClient::next(Projection<>& proj) {
     return buffer_.waitAndPop(proj, 100);
 }
 
+size_t ZmqDaqClient::numQueued() const {
+    return buffer_.size();
+}
+
+size_t ZmqDaqClient::numTaken() const {
+    return buffer_.popped();
+}
+
 void ZmqDaqClient::setAcquiring(bool state) {
     DaqClientInterface::setAcquiring(state);
     if (state) buffer_.reset();
@@ -104,18 +147,32 @@ void ZmqDaqClient::setAcquiring(bool state) {
 }
 
 void ZmqDaqClient::startAcquiring(uint32_t num_rows, uint32_t num_cols) {
+    if (pool_) {
+        pool_->resize(static_cast<size_t>(num_rows) * num_cols);
+        pool_->reserve();
+    }
     DaqClientInterface::startAcquiring(num_rows, num_cols);
     buffer_.reset();
     spdlog::debug("Zmq buffer reset!");
 }
 
-std::optional<nlohmann::json> ZmqDaqClient::parseMeta(const zmq::message_t& msg) {
-    try {
-        return nlohmann::json::parse(msg.to_string());
-    } catch (const nlohmann::json::parse_error& ex) {
-        spdlog::error("[DAQ client] Failed to parse metadata: {}", ex.what());
-        return std::nullopt;
-    }
+bool ZmqDaqClient::recycle(Projection<>& proj) {
+    auto [num_rows, num_cols] = proj.shape();
+    size_t size = num_rows * num_cols;
+    if (size == 0 || size != pool_->bufferSize()) return true;
+
+    // Wait for the consumers to release a buffer. Backpressure is passed on to the sender
+    // through the receive high water mark.
+    std::shared_ptr<RawDtype> buffer;
+    while (running_ && !buffer) buffer = pool_->acquire(10);
+    if (!buffer) return false;
+
+    // The received message is released in the receiving thread, so that only pooled memory is
+    // held by the projections in flight.
+    std::memcpy(buffer.get(), proj.bytes(), size * sizeof(RawDtype));
+    RawDtype* ptr = buffer.get();
+    proj = Projection<>{proj.type, proj.index, num_cols, num_rows, std::move(buffer), ptr};
+    return true;
 }
 
 zmq::socket_type ZmqDaqClient::parseSocketType(const std::string& socket_type) const {
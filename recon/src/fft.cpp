@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+
+extern "C" {
+#include <fftw3.h>
+}
+
+#include <spdlog/spdlog.h>
+
+#include "recon/fft.hpp"
+
+namespace recastx::recon {
+
+namespace {
+
+std::atomic<FftPlanning> planning { FftPlanning::ESTIMATE };
+
+std::mutex wisdom_mtx;
+std::string wisdom_file;
+std::string wisdom_saved;
+
+std::string exportWisdom() {
+    std::unique_ptr<char, decltype(&free)> s(fftwf_export_wisdom_to_string(), &free);
+    return s ? std::string(s.get()) : std::string();
+}
+
+} // namespace
+
+void setFftPlanning(FftPlanning mode) {
+    planning.store(mode, std::memory_order_relaxed);
+}
+
+FftPlanning fftPlanning() {
+    return planning.load(std::memory_order_relaxed);
+}
+
+unsigned fftPlanningFlags() {
+    switch (fftPlanning()) {
+        case FftPlanning::MEASURE:
+            return FFTW_MEASURE;
+        case FftPlanning::PATIENT:
+            return FFTW_PATIENT;
+        default:
+            return FFTW_ESTIMATE;
+    }
+}
+
+bool setFftWisdomFile(const std::string& path, size_t num_threads) {
+    std::lock_guard lk(wisdom_mtx);
+    wisdom_file = path.empty() ? "" : fmt::format("{}.{}", path, num_threads);
+    wisdom_saved.clear();
+    if (wisdom_file.empty()) return false;
+
+    if (!std::filesystem::exists(wisdom_file)) {
+        spdlog::info("[Init] - FFTW wisdom file {} does not exist", wisdom_file);
+        return false;
+    }
+    if (fftwf_import_wisdom_from_filename(wisdom_file.c_str()) == 0) {
+        spdlog::warn("[Init] - Failed to import FFTW wisdom from {}", wisdom_file);
+        return false;
+    }
+    wisdom_saved = exportWisdom();
+    spdlog::info("[Init] - FFTW wisdom imported from {}", wisdom_file);
+    return true;
+}
+
+void saveFftWisdom() {
+    std::lock_guard lk(wisdom_mtx);
+    if (wisdom_file.empty()) return;
+
+    auto wisdom = exportWisdom();
+    if (wisdom == wisdom_saved) return;
+
+    std::error_code ec;
+    auto parent = std::filesystem::path(wisdom_file).parent_path();
+    if (!parent.empty()) std::filesystem::create_directories(parent, ec);
+    if (fftwf_export_wisdom_to_filename(wisdom_file.c_str()) == 0) {
+        spdlog::warn("Failed to export FFTW wisdom to {}", wisdom_file);
+        return;
+    }
+    wisdom_saved = std::move(wisdom);
+    spdlog::info("FFTW wisdom exported to {}", wisdom_file);
+}
+
+} // namespace recastx::recon
\ No newline at end of file
@@ -15,8 +15,10 @@
 
 #include "common/version.hpp"
 #include "recon/application.hpp"
+#include "recon/fft.hpp"
 #include "recon/ramp_filter.hpp"
 #include "recon/reconstructor.hpp"
+#include "recon/recorder.hpp"
 #include "recon/daq/daq_factory.hpp"
 
 namespace po = boost::program_options;
@@ -30,6 +32,44 @@ std::pair<uint32_t, uint32_t> parseDownsampleFactor(
     return {row, col};
 }
 
+recastx::DownsamplingMode parseDownsampleMode(const po::variable_value& value) {
+    auto mode = value.as<std::string>();
+    if (mode == "decimation") return recastx::DownsamplingMode::DECIMATION;
+    if (mode == "binning") return recastx::DownsamplingMode::BINNING;
+    throw std::runtime_error("Downsampling mode must be either 'decimation' or 'binning'");
+}
+
+recastx::recon::HugePages parseHugePages(const po::variable_value& value) {
+    auto policy = value.as<std::string>();
+    if (policy == "none") return recastx::recon::HugePages::NONE;
+    if (policy == "transparent") return recastx::recon::HugePages::TRANSPARENT;
+    if (policy == "explicit") return recastx::recon::HugePages::EXPLICIT;
+    throw std::runtime_error("Huge pages must be one of 'none', 'transparent' and 'explicit'");
+}
+
+recastx::RampFilterPadding parseRampFilterPadding(const po::variable_value& value) {
+    auto padding = value.as<std::string>();
+    if (padding == "none") return recastx::RampFilterPadding::NONE;
+    if (padding == "zero") return recastx::RampFilterPadding::ZERO;
+    if (padding == "edge") return recastx::RampFilterPadding::EDGE;
+    throw std::runtime_error("Ramp filter padding must be one of 'none', 'zero' and 'edge'");
+}
+
+recastx::LogAccuracy parseLogAccuracy(const po::variable_value& value) {
+    auto accuracy = value.as<std::string>();
+    if (accuracy == "exact") return recastx::LogAccuracy::EXACT;
+    if (accuracy == "fast") return recastx::LogAccuracy::FAST;
+    throw std::runtime_error("Log accuracy must be either 'exact' or 'fast'");
+}
+
+recastx::recon::FftPlanning parseFftPlanning(const po::variable_value& value) {
+    auto mode = value.as<std::string>();
+    if (mode == "estimate") return recastx::recon::FftPlanning::ESTIMATE;
+    if (mode == "measure") return recastx::recon::FftPlanning::MEASURE;
+    if (mode == "patient") return recastx::recon::FftPlanning::PATIENT;
+    throw std::runtime_error("FFT planning must be one of 'estimate', 'measure' and 'patient'");
+}
+
 recastx::AngleRange parseAngleRange(const po::variable_value& value) {
     int angle_range = value.as<int>();
     if (angle_range == 180) return recastx::AngleRange::HALF;
@@ -59,6 +99,7 @@ int main(int argc, char** argv) {
          "start data processing automatically (without waiting for a trigger from the GUI client)")
     ;
 
+    bool daq_replay_loop = false;
     po::options_description communication_desc("Communication options");
     communication_desc.add_options()
         ("daq-protocol", po::value<std::string>()->default_value("tcp"), 
@@ -68,10 +109,33 @@ int main(int argc, char** argv) {
         ("daq-socket", po::value<std::string>()->default_value("pull"),
          "ZMQ socket type of the DAQ server. Options: sub/pull")
         ("daq-data-protocol", po::value<std::string>()->default_value("default"),
-         "DAQ data protocol")
+         "DAQ data protocol. Options: default (JSON header)/binary (fixed-layout binary header)/"
+         "replay (replay a recorded raw stream given by 'daq-replay-file')")
+        ("daq-io-threads", po::value<int>()->default_value(1),
+         "number of ZMQ I/O threads used by the DAQ client")
+        ("daq-rcvhwm", po::value<int>()->default_value(1),
+         "ZMQ receive high water mark of each DAQ socket. Increase it to avoid dropping "
+         "frames in bursts when using the PUB-SUB pattern")
+        ("daq-rcvbuf", po::value<int>()->default_value(-1),
+         "kernel receive buffer size (in bytes) of each DAQ socket. Use the OS default if not positive")
+        ("daq-pool-size", po::value<size_t>()->default_value(0),
+         "number of recycled frame buffers, which bounds the memory of the frames in flight. "
+         "If 0, the received messages are used directly without copying")
+        ("daq-replay-file", po::value<std::string>()->default_value(""),
+         "data file of the recorded raw stream to be replayed")
+        ("daq-replay-speed", po::value<double>()->default_value(1.),
+         "replay speed relative to the recording. 0 for as fast as possible")
+        ("daq-replay-loop", po::bool_switch(&daq_replay_loop),
+         "replay the projections repeatedly")
+        ("record-file", po::value<std::string>()->default_value(""),
+         "record the incoming raw stream to the given data file, which can be replayed later")
+        ("record-queue-size", po::value<size_t>()->default_value(256),
+         "maximum number of frames waiting to be written. Frames will be dropped if the disk cannot keep up")
         ("rpc-port", po::value<int>()->default_value(9971),
          "port of the gRPC server."
          "At TOMCAT, the valid port range is [9970, 9979]")
+        ("metrics-port", po::value<int>()->default_value(0),
+         "local port serving the pipeline metrics in the Prometheus text format. Disabled if 0")
     ;
 
     po::options_description geometry_desc("Geometry options");
@@ -87,6 +151,8 @@ int main(int argc, char** argv) {
          "downsampling factor along the column")
         ("downsample-row", po::value<uint32_t>(),
          "downsampling factor along the row")
+        ("downsample-mode", po::value<std::string>()->default_value("decimation"),
+         "downsampling mode: 'decimation' (pick every n-th pixel) or 'binning' (average n x n pixel blocks)")
         ("angles", po::value<size_t>()->default_value(0),
          "number of projections per scan")
         ("angle-range", po::value<int>()->default_value(180),
@@ -113,9 +179,21 @@ int main(int argc, char** argv) {
          "switch to Paganin filter")
         ("ramp-filter", po::value<std::string>()->default_value("shepp"),
          "supported filters are: shepp (Shepp-Logan), ramlak (Ram-Lak)")
+        ("ramp-filter-padding", po::value<std::string>()->default_value("none"),
+         "padding of the detector rows before ramp filtering: 'none', 'zero' or 'edge'. The rows are "
+         "padded to the next FFT-friendly length of at least twice the width")
+        ("fft-planning", po::value<std::string>()->default_value("estimate"),
+         "FFT planning: 'estimate' (instant), 'measure' or 'patient'. Measured plans are faster but "
+         "planning a new size takes seconds to minutes")
+        ("fft-wisdom", po::value<std::string>()->default_value(""),
+         "path prefix of the FFTW wisdom cache, suffixed with the number of image-processing threads. "
+         "Measured plans are loaded from it at startup and new ones are saved to it. Not cached if empty")
         ("disable-negative-log", po::bool_switch(&disable_minus_log),
          "Minus logarithm will not be applied to sinogram, "
          "e.g. when the raw data were generated from a phantom")
+        ("log-accuracy", po::value<std::string>()->default_value("exact"),
+         "accuracy of the minus logarithm: 'exact' or 'fast' (vectorised approximation with a "
+         "relative error below 2e-7)")
     ;
 
     po::options_description reconstruction_desc("Reconstruction options");
@@ -143,6 +221,7 @@ int main(int argc, char** argv) {
     ;
 
     bool pipeline_wait_on_slowness = false;
+    bool stream_preprocessing = false;
     po::options_description pipeline_desc("Pipeline options");
     pipeline_desc.add_options()
         ("imageproc-threads", po::value<uint32_t>(),
@@ -152,6 +231,22 @@ int main(int argc, char** argv) {
         ("wait-on-slowness", po::bool_switch(&pipeline_wait_on_slowness),
          "false for dropping the unprocessed data when there is a mismatch on performance in"
          "different parts of the pipeline")
+        ("stream-preprocessing", po::bool_switch(&stream_preprocessing),
+         "preprocess each projection as soon as it arrives instead of waiting for the whole group, "
+         "which reduces the latency by up to one group acquisition period")
+        ("huge-pages", po::value<std::string>()->default_value("transparent"),
+         "huge pages for the large buffers: 'none', 'transparent' or 'explicit' (reserved by "
+         "vm.nr_hugepages, fall back to 'transparent' if not available)")
+        ("cpu-daq", po::value<std::string>()->default_value(""),
+         "CPUs (e.g. 0-7,16-23) or NUMA node (e.g. node:0) of the data acquisition threads. "
+         "Not pinned if empty")
+        ("cpu-preprocessing", po::value<std::string>()->default_value(""),
+         "CPUs or NUMA node of the preprocessing threads. The raw and flat field buffers are "
+         "allocated on the same NUMA node. Not pinned if empty")
+        ("cpu-upload", po::value<std::string>()->default_value(""),
+         "CPUs or NUMA node of the sinogram uploading thread. Not pinned if empty")
+        ("cpu-recon", po::value<std::string>()->default_value(""),
+         "CPUs or NUMA node of the reconstruction thread. Not pinned if empty")
     ;
 
     po::options_description all_desc(
@@ -178,10 +273,26 @@ int main(int argc, char** argv) {
     auto daq_address = opts["daq-address"].as<std::string>();
     auto daq_socket_type = opts["daq-socket"].as<std::string>();
     auto daq_data_protocol = opts["daq-data-protocol"].as<std::string>();
+    recastx::recon::PipelineAffinity cpu_affinity {
+        recastx::recon::CpuSet::parse(opts["cpu-daq"].as<std::string>()),
+        recastx::recon::CpuSet::parse(opts["cpu-preprocessing"].as<std::string>()),
+        recastx::recon::CpuSet::parse(opts["cpu-upload"].as<std::string>()),
+        recastx::recon::CpuSet::parse(opts["cpu-recon"].as<std::string>())
+    };
+    recastx::recon::ZmqClientConfig daq_zmq_cfg {
+        opts["daq-io-threads"].as<int>(), opts["daq-rcvhwm"].as<int>(), opts["daq-rcvbuf"].as<int>(),
+        opts["daq-pool-size"].as<size_t>(), cpu_affinity.daq
+    };
+    auto daq_replay_file = opts["daq-replay-file"].as<std::string>();
+    auto daq_replay_speed = opts["daq-replay-speed"].as<double>();
+    auto record_file = opts["record-file"].as<std::string>();
+    auto record_queue_size = opts["record-queue-size"].as<size_t>();
     auto rpc_port = opts["rpc-port"].as<int>();
+    auto metrics_port = opts["metrics-port"].as<int>();
 
     auto [downsampling_row, downsampling_col] = parseDownsampleFactor(
         opts["downsample-row"], opts["downsample-col"], opts["downsample"]);
+    auto downsampling_mode = parseDownsampleMode(opts["downsample-mode"]);
     auto num_rows = opts["rows"].as<size_t>();
     auto num_cols = opts["cols"].as<size_t>();
     auto num_angles = opts["angles"].as<size_t>();
@@ -200,6 +311,8 @@ int main(int argc, char** argv) {
     auto raw_buffer_size = opts["raw-buffer-size"].as<size_t>();
 
     auto ramp_filter = opts["ramp-filter"].as<std::string>();
+    auto ramp_filter_padding = parseRampFilterPadding(opts["ramp-filter-padding"]);
+    auto log_accuracy = parseLogAccuracy(opts["log-accuracy"]);
 
     auto pixel_size = opts["pixel-size"].as<float>();
     auto lambda = opts["lambda"].as<float>();
@@ -213,18 +326,35 @@ int main(int argc, char** argv) {
     auto daq_concurrency = opts["daq-concurrency"].empty()
          ? recastx::recon::Application::defaultDaqConcurrency()
          : opts["daq-concurrency"].as<uint32_t>();
+    recastx::recon::setHugePages(parseHugePages(opts["huge-pages"]));
+    recastx::recon::setFftPlanning(parseFftPlanning(opts["fft-planning"]));
+    recastx::recon::setFftWisdomFile(opts["fft-wisdom"].as<std::string>(), imageproc_threads);
 
-    auto daq_client = recastx::recon::createDaqClient(
-        daq_data_protocol,
-        fmt::format("{}://{}", daq_protocol, daq_address),
-        daq_socket_type,
-        daq_concurrency);
+    auto daq_client = daq_data_protocol == "replay"
+        ? recastx::recon::createDaqClient(
+            daq_data_protocol,
+            daq_replay_file,
+            daq_replay_speed,
+            daq_replay_loop,
+            daq_concurrency)
+        : recastx::recon::createDaqClient(
+            daq_data_protocol,
+            fmt::format("{}://{}", daq_protocol, daq_address),
+            daq_socket_type,
+            daq_concurrency,
+            daq_zmq_cfg);
     recastx::recon::RampFilterFactory ramp_filter_factory;
     recastx::recon::AstraReconstructorFactory recon_factory;
     recastx::RpcServerConfig rpc_server_cfg {rpc_port};
     recastx::ImageprocParams imageproc_params {
-        imageproc_threads, downsampling_col, downsampling_row, 0, !disable_minus_log, { ramp_filter }
+        imageproc_threads, downsampling_col, downsampling_row, downsampling_mode, 0, !disable_minus_log,
+        { ramp_filter, ramp_filter_padding }, log_accuracy
     };
+    // The recorder must outlive the application.
+    std::unique_ptr<recastx::recon::Recorder> recorder;
+    if (!record_file.empty()) {
+        recorder = std::make_unique<recastx::recon::Recorder>(record_file, record_queue_size);
+    }
     recastx::recon::Application app(raw_buffer_size, imageproc_params,
                                     daq_client.get(), &ramp_filter_factory, &recon_factory, rpc_server_cfg);
 
@@ -235,6 +365,11 @@ int main(int argc, char** argv) {
     app.setReconGeometry(slice_size, volume_size, minx, maxx, miny, maxy, minz, maxz);
 
     app.setPipelinePolicy(pipeline_wait_on_slowness);
+    app.setStreamPreprocessing(stream_preprocessing);
+    app.setCpuAffinity(cpu_affinity);
+    if (metrics_port > 0) app.exposeMetrics(metrics_port);
+
+    if (recorder) app.setRecorder(recorder.get());
 
     if (auto_processing) {
         app.setScanMode(recastx::rpc::ScanMode_Mode_DYNAMIC);
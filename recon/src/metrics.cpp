@@ -0,0 +1,298 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include "recon/metrics.hpp"
+
+namespace recastx::recon {
+
+namespace details {
+
+size_t metricsShard() {
+    static std::atomic<size_t> next = 0;
+    thread_local size_t shard = next.fetch_add(1, std::memory_order_relaxed) % k_METRICS_SHARDS;
+    return shard;
+}
+
+} // namespace details
+
+namespace {
+
+std::string escapeLabelValue(const std::string& value) {
+    std::string ret;
+    ret.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\') ret += "\\\\";
+        else if (c == '"') ret += "\\\"";
+        else if (c == '\n') ret += "\\n";
+        else ret += c;
+    }
+    return ret;
+}
+
+std::string formatLabels(const Metrics::Labels& labels, const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) return "";
+
+    std::string ret = "{";
+    for (const auto& [key, value] : labels) {
+        if (ret.size() > 1) ret += ",";
+        ret += fmt::format("{}=\"{}\"", key, escapeLabelValue(value));
+    }
+    if (!extra.empty()) {
+        if (ret.size() > 1) ret += ",";
+        ret += extra;
+    }
+    ret += "}";
+    return ret;
+}
+
+const char* typeName(Metrics::Type type) {
+    switch (type) {
+        case Metrics::Type::COUNTER:
+            return "counter";
+        case Metrics::Type::GAUGE:
+            return "gauge";
+        case Metrics::Type::HISTOGRAM:
+            return "summary";
+    }
+    return "untyped";
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+uint64_t Counter::value() const {
+    uint64_t ret = 0;
+    for (const auto& shard : shards_) ret += shard.value.load(std::memory_order_relaxed);
+    return ret;
+}
+
+uint64_t Histogram::Snapshot::quantile(double q) const {
+    if (count == 0) return 0;
+
+    auto rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count)));
+    if (rank == 0) rank = 1;
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        cumulative += buckets[i];
+        if (cumulative >= rank) return bucketUpperBound(i);
+    }
+    return bucketUpperBound(buckets.size() - 1);
+}
+
+Histogram::Histogram() : shards_(new Shard[details::k_METRICS_SHARDS]) {}
+
+size_t Histogram::bucketIndex(uint64_t value) {
+    if (value < 2 * k_SUB_BUCKETS) return value;
+    size_t msb = 63 - __builtin_clzll(value);
+    size_t shift = msb - k_SUB_BUCKET_BITS;
+    return (shift + 1) * k_SUB_BUCKETS + ((value >> shift) - k_SUB_BUCKETS);
+}
+
+uint64_t Histogram::bucketUpperBound(size_t index) {
+    if (index < 2 * k_SUB_BUCKETS) return index;
+    size_t shift = index / k_SUB_BUCKETS - 1;
+    uint64_t lower = static_cast<uint64_t>(index % k_SUB_BUCKETS + k_SUB_BUCKETS) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snap;
+    snap.buckets.resize(k_NUM_BUCKETS, 0);
+    for (size_t s = 0; s < details::k_METRICS_SHARDS; ++s) {
+        const auto& shard = shards_[s];
+        for (size_t i = 0; i < k_NUM_BUCKETS; ++i) {
+            snap.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+        snap.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    // The count is derived from the buckets so that the snapshot is consistent in itself.
+    for (auto c : snap.buckets) snap.count += c;
+    return snap;
+}
+
+Metrics::Entry& Metrics::entry(const std::string& name, const std::string& help, Type type, const Labels& labels) {
+    auto [it, inserted] = families_.try_emplace(name, Family{help, type, {}});
+    if (!inserted && it->second.type != type) {
+        throw std::invalid_argument(fmt::format("Metric {} is registered with a different type", name));
+    }
+    auto& e = it->second.entries[formatLabels(labels)];
+    e.labels = labels;
+    return e;
+}
+
+Counter& Metrics::counter(const std::string& name, const std::string& help, const Labels& labels) {
+    std::lock_guard lk(mtx_);
+    auto& e = entry(name, help, Type::COUNTER, labels);
+    if (!e.counter) {
+        if (e.callback) throw std::invalid_argument(fmt::format("Metric {} is registered as a callback", name));
+        e.counter = std::make_unique<Counter>();
+    }
+    return *e.counter;
+}
+
+void Metrics::counter(const std::string& name, const std::string& help,
+                      std::function<double()> callback, const Labels& labels) {
+    std::lock_guard lk(mtx_);
+    auto& e = entry(name, help, Type::COUNTER, labels);
+    if (e.counter) throw std::invalid_argument(fmt::format("Metric {} is already registered", name));
+    e.callback = std::move(callback);
+}
+
+void Metrics::gauge(const std::string& name, const std::string& help,
+                    std::function<double()> callback, const Labels& labels) {
+    std::lock_guard lk(mtx_);
+    entry(name, help, Type::GAUGE, labels).callback = std::move(callback);
+}
+
+Histogram& Metrics::histogram(const std::string& name, const std::string& help, const Labels& labels) {
+    std::lock_guard lk(mtx_);
+    auto& e = entry(name, help, Type::HISTOGRAM, labels);
+    if (!e.histogram) e.histogram = std::make_unique<Histogram>();
+    return *e.histogram;
+}
+
+std::vector<Metrics::Sample> Metrics::collect() const {
+    std::lock_guard lk(mtx_);
+    std::vector<Sample> samples;
+    for (const auto& [name, family] : families_) {
+        for (const auto& [key, e] : family.entries) {
+            Sample& s = samples.emplace_back();
+            s.name = name;
+            s.help = family.help;
+            s.type = family.type;
+            s.labels = e.labels;
+            if (e.histogram) {
+                s.histogram = e.histogram->snapshot();
+            } else if (e.counter) {
+                s.value = static_cast<double>(e.counter->value());
+            } else if (e.callback) {
+                s.value = e.callback();
+            }
+        }
+    }
+    return samples;
+}
+
+std::string Metrics::exposition() const {
+    std::string ret;
+    std::string last;
+    for (const auto& s : collect()) {
+        if (s.name != last) {
+            ret += fmt::format("# HELP {} {}\n# TYPE {} {}\n", s.name, s.help, s.name, typeName(s.type));
+            last = s.name;
+        }
+
+        if (s.type != Type::HISTOGRAM) {
+            ret += fmt::format("{}{} {}\n", s.name, formatLabels(s.labels), s.value);
+            continue;
+        }
+
+        for (double q : k_QUANTILES) {
+            ret += fmt::format("{}{} {}\n", s.name, formatLabels(s.labels, fmt::format("quantile=\"{}\"", q)),
+                               static_cast<double>(s.histogram.quantile(q)) * Histogram::k_SECONDS);
+        }
+        ret += fmt::format("{}_sum{} {}\n", s.name, formatLabels(s.labels),
+                           static_cast<double>(s.histogram.sum) * Histogram::k_SECONDS);
+        ret += fmt::format("{}_count{} {}\n", s.name, formatLabels(s.labels), s.histogram.count);
+    }
+    return ret;
+}
+
+MetricsServer::MetricsServer(int port, const Metrics& metrics) : metrics_(metrics) {
+    fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) throw std::runtime_error(fmt::format("Failed to create metrics socket: {}", std::strerror(errno)));
+
+    int on = 1;
+    ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0 || ::listen(fd_, 4) != 0) {
+        std::string err = std::strerror(errno);
+        ::close(fd_);
+        throw std::runtime_error(fmt::format("Failed to serve metrics at port {}: {}", port, err));
+    }
+
+    running_ = true;
+    thread_ = std::thread(&MetricsServer::serve, this);
+
+    spdlog::info("Serving metrics at http://127.0.0.1:{}/metrics", this->port());
+}
+
+MetricsServer::~MetricsServer() {
+    running_ = false;
+    thread_.join();
+    ::close(fd_);
+}
+
+int MetricsServer::port() const {
+    sockaddr_in addr {};
+    socklen_t len = sizeof addr;
+    if (::getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0) return -1;
+    return ntohs(addr.sin_port);
+}
+
+void MetricsServer::serve() {
+    pollfd pfd {fd_, POLLIN, 0};
+    while (running_) {
+        // Check for shutdown periodically.
+        if (::poll(&pfd, 1, 100) <= 0) continue;
+
+        int conn = ::accept(fd_, nullptr, nullptr);
+        if (conn < 0) continue;
+        respond(conn);
+        ::close(conn);
+    }
+}
+
+void MetricsServer::respond(int conn) {
+    timeval timeout {1, 0};
+    ::setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
+    // Only the request line is of interest.
+    char buf[1024];
+    ssize_t n = ::recv(conn, buf, sizeof buf - 1, 0);
+    if (n <= 0) return;
+    buf[n] = '\0';
+
+    std::string request(buf);
+    std::string path = request.substr(0, request.find("\r\n"));
+    bool found = path.rfind("GET /metrics ", 0) == 0 || path.rfind("GET / ", 0) == 0;
+
+    std::string body = found ? metrics_.exposition() : "Not found\n";
+    sendAll(conn, fmt::format("HTTP/1.1 {}\r\n"
+                              "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                              "Content-Length: {}\r\n"
+                              "Connection: close\r\n\r\n{}",
+                              found ? "200 OK" : "404 Not Found", body.size(), body));
+}
+
+} // namespace recastx::recon
\ No newline at end of file
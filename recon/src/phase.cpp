@@ -6,7 +6,12 @@
  *
  * The full license is in the file LICENSE, distributed with this software.
 */
+#include <algorithm>
+#include <cmath>
+
+#include "recon/fft.hpp"
 #include "recon/phase.hpp"
+#include "recon/simd.hpp"
 
 
 namespace recastx::recon {
@@ -15,79 +20,106 @@ namespace details {
 
 std::vector<float> paganinFilter(float pixel_size, float lambda, float delta, float beta, float distance, 
                                  int num_cols, int num_rows) {
-    auto filter = std::vector<float>(num_rows * num_cols);
+    int num_freqs = num_cols / 2 + 1;
+    auto filter = std::vector<float>(num_rows * num_freqs);
 
-    auto dx = pixel_size / (2.0f * M_PI);
-    auto dy = dx;
-    auto mid_x = (num_cols + 1) / 2;
-    auto mid_y = (num_rows + 1) / 2;
+    // angular frequency steps
+    float dkx = 2.f * static_cast<float>(M_PI) / (pixel_size * num_cols);
+    float dky = 2.f * static_cast<float>(M_PI) / (pixel_size * num_rows);
+    float alpha = distance * lambda * delta / (4.f * static_cast<float>(M_PI) * beta);
+    float norm = 1.f / (static_cast<float>(num_cols) * num_rows); // unnormalized fft in fftw
 
     for (int i = 0; i < num_rows; ++i) {
-        for (int j = 0; j < num_cols; ++j) {
-            // TODO Is this is FFTW convention compared to numpy?
-            auto x = i < mid_x ? i : (2 * mid_x - i);
-            auto y = j < mid_y ? j : (2 * mid_y - j);
-            auto k_x = x * dx;
-            auto k_y = y * dy;
-            auto k_squared = k_x * k_x + k_y * k_y;
-            filter[i * num_cols + j] = (4.0f * beta * M_PI) / 1.0f + distance * lambda * delta * k_squared;
+        int y = i <= num_rows / 2 ? i : i - num_rows;
+        float k_y = y * dky;
+        for (int j = 0; j < num_freqs; ++j) {
+            float k_x = j * dkx;
+            float k_squared = k_x * k_x + k_y * k_y;
+            filter[i * num_freqs + j] = norm / (1.f + alpha * k_squared);
         }
     }
     return filter;
 }
 
-}; // details
+} // details
 
 Paganin::Paganin(float pixel_size, float lambda, float delta, float beta, float distance, 
-                 float* data, int num_cols, int num_rows): 
+                 float* data, int num_cols, int num_rows, int buffer_size, bool fast_log):
         pixel_size_(pixel_size), 
         lambda_(lambda),
         delta_(delta),
         beta_(beta),
         distance_(distance),
         num_cols_(num_cols),
-        num_rows_(num_rows)  {
-
-    freq_ = std::vector<std::vector<std::complex<float>>>(
-        1, std::vector<std::complex<float>>(num_cols_ * num_rows_));
-
-    fft2d_plan_ = fftwf_plan_dft_r2c_2d(
-        num_cols_,
-        num_rows_,
-        data,
-        reinterpret_cast<fftwf_complex*>(&freq_[0][0]),
-        FFTW_ESTIMATE);
-
-    ffti2d_plan_ = fftwf_plan_dft_c2r_2d(
-        num_cols_,
-        num_rows_,
-        reinterpret_cast<fftwf_complex*>(&freq_[0][0]),
-        data,
-        FFTW_ESTIMATE);
+        num_rows_(num_rows),
+        num_freqs_(num_cols / 2 + 1),
+        block_rows_(std::min(num_rows, k_BLOCK_ROWS)),
+        fast_log_(fast_log) {
+
+    freq_ = std::vector<SpectrumType>(buffer_size, SpectrumType(num_rows_ * num_freqs_));
+    auto freq = reinterpret_cast<fftwf_complex*>(freq_[0].data());
+
+    // The plans are executed on the images of different threads, which are not necessarily
+    // aligned like the one used for planning.
+    unsigned flags = fftPlanningFlags();
+    if ((static_cast<size_t>(num_cols_) * num_rows_) % 4 != 0) flags |= FFTW_UNALIGNED;
+
+    fft2d_plan_ = fftwf_plan_dft_r2c_2d(num_rows_, num_cols_, data, freq, flags);
+
+    ffti_col_plan_ = fftwf_plan_many_dft(1, &num_rows_, num_freqs_,
+                                         freq, nullptr, num_freqs_, 1,
+                                         freq, nullptr, num_freqs_, 1,
+                                         FFTW_BACKWARD, flags);
+    ffti_row_plan_ = fftwf_plan_many_dft_c2r(1, &num_cols_, block_rows_,
+                                             freq, nullptr, 1, num_freqs_,
+                                             data, nullptr, 1, num_cols_,
+                                             flags);
+    int tail = num_rows_ % block_rows_;
+    if (tail > 0) {
+        ffti_row_tail_plan_ = fftwf_plan_many_dft_c2r(1, &num_cols_, tail,
+                                                      freq, nullptr, 1, num_freqs_,
+                                                      data, nullptr, 1, num_cols_,
+                                                      flags);
+    }
 
     filter_ = details::paganinFilter(pixel_size_, lambda_, delta_, beta_, distance_, 
                                      num_cols_, num_rows_);
 }
 
-void Paganin::apply(float* data, int idx) {
-    // take fft of proj
-    // FIXME: cause segmentation fault in unittest
-    fftwf_execute_dft_r2c(fft2d_plan_, 
-                          data,
-                          reinterpret_cast<fftwf_complex*>(&freq_[idx][0]));
+Paganin::~Paganin() {
+    for (auto plan : {fft2d_plan_, ffti_col_plan_, ffti_row_plan_, ffti_row_tail_plan_}) {
+        if (plan != nullptr) fftwf_destroy_plan(plan);
+    }
+}
 
-    // filter the proj in 2D
-    for (int i = 0; i < num_rows_ * num_cols_; ++i) freq_[idx][i] *= filter_[i];
+void Paganin::apply(float* data, int buffer_index) {
+    auto& spectrum = freq_[buffer_index];
+    auto freq = reinterpret_cast<fftwf_complex*>(spectrum.data());
 
-    // ifft the proj
-    fftwf_execute_dft_c2r(ffti2d_plan_,
-                          reinterpret_cast<fftwf_complex*>(&freq_[idx][0]),
-                          data);
+    // take fft of proj
+    fftwf_execute_dft_r2c(fft2d_plan_, data, freq);
 
-    // log and scale
-    for (int i = 0; i < num_rows_ * num_cols_; ++i) {
-        data[i] = data[i] <= 0.0f ? 0.0f : -std::log(data[i]);
-        data[i] *= lambda_ / (4.0 * M_PI * beta_);
+    // filter the proj in 2D
+    for (size_t i = 0; i < spectrum.size(); ++i) spectrum[i] *= filter_[i];
+
+    // ifft the proj, and log and scale each block of rows
+    fftwf_execute_dft(ffti_col_plan_, freq, freq);
+
+    const float scale = lambda_ / (4.f * static_cast<float>(M_PI) * beta_);
+    for (int r = 0; r < num_rows_; r += block_rows_) {
+        int n = std::min(block_rows_, num_rows_ - r);
+        float* rows = &data[r * num_cols_];
+        fftwf_execute_dft_c2r(n == block_rows_ ? ffti_row_plan_ : ffti_row_tail_plan_,
+                              &freq[r * num_freqs_], rows);
+
+        if (fast_log_) {
+            simd::negativeLog(rows, n * num_cols_, scale);
+        } else {
+            for (int i = 0; i < n * num_cols_; ++i) {
+                float v = rows[i];
+                rows[i] = v <= 0.f ? 0.f : -scale * std::log(v);
+            }
+        }
     }
 }
 
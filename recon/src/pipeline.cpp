@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include "recon/pipeline.hpp"
+
+namespace recastx::recon {
+
+Pipeline::Pipeline(Stages stages)
+        : stages_(std::move(stages)),
+          arena_(k_CONCURRENCY, 0) {
+    using namespace oneapi::tbb::flow;
+
+    // The tasks of the graph run in the arena it is constructed in.
+    arena_.execute([&] {
+        graph_ = std::make_unique<graph>();
+
+        ingest_ = std::make_unique<queue_node<Token>>(*graph_);
+
+        staging_ = std::make_unique<limiter_node<Token>>(*graph_, 1);
+
+        release_ = std::make_unique<broadcast_node<Token>>(*graph_);
+
+        preprocess_ = std::make_unique<SplitNode>(
+                *graph_, serial, [this](const Token&, SplitNode::output_ports_type& ports) {
+            ScopedPin pin(affinity_.preprocessing);
+            // Chunks completed from now on need another run.
+            ingest_pending_ = false;
+            if (stages_.preprocess()) {
+                std::get<0>(ports).try_put(Token());
+            } else {
+                std::get<1>(ports).try_put(Token());
+            }
+        });
+
+        upload_ = std::make_unique<SplitNode>(
+                *graph_, serial, [this](const Token&, SplitNode::output_ports_type& ports) {
+            ScopedPin pin(affinity_.upload);
+            bool fetched = stages_.fetch();
+            // The next chunk can be handed off while this one is being uploaded.
+            std::get<1>(ports).try_put(Token());
+            if (!fetched) return;
+            stages_.upload();
+            std::get<0>(ports).try_put(Token());
+        });
+
+        reconstruct_ = std::make_unique<function_node<Token>>(
+                *graph_, serial, [this](const Token&) {
+            ScopedPin pin(affinity_.reconstruction);
+            stages_.reconstruct();
+            return Token();
+        });
+
+        on_demand_ = std::make_unique<function_node<Token>>(
+                *graph_, serial, [this](const Token&) {
+            ScopedPin pin(affinity_.reconstruction);
+            on_demand_pending_ = false;
+            stages_.reconstructOnDemand();
+            return Token();
+        });
+
+        make_edge(*ingest_, *staging_);
+        make_edge(*staging_, *preprocess_);
+        make_edge(output_port<0>(*preprocess_), *upload_);
+        make_edge(output_port<1>(*preprocess_), *release_);
+        make_edge(output_port<0>(*upload_), *reconstruct_);
+        make_edge(output_port<1>(*upload_), *release_);
+        make_edge(*release_, staging_->decrementer());
+    });
+}
+
+Pipeline::~Pipeline() {
+    wait();
+}
+
+void Pipeline::ingest() {
+    if (!ingest_pending_.exchange(true)) ingest_->try_put(Token());
+}
+
+void Pipeline::requestOnDemand() {
+    if (!on_demand_pending_.exchange(true)) on_demand_->try_put(Token());
+}
+
+void Pipeline::wait() {
+    arena_.execute([&] { graph_->wait_for_all(); });
+}
+
+} // namespace recastx::recon
\ No newline at end of file
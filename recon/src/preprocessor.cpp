@@ -6,26 +6,87 @@
  *
  * The full license is in the file LICENSE, distributed with this software.
 */
+#include <thread>
+
 #include "common/scoped_timer.hpp"
+#include "recon/fft.hpp"
 #include "recon/preprocessor.hpp"
 #include "recon/preprocessing.hpp"
+#include "recon/simd.hpp"
 
 namespace recastx::recon {
 
+namespace details {
+
+class PinningObserver : public oneapi::tbb::task_scheduler_observer {
+
+    CpuSet cpus_;
+    // Affinity of a worker before it joined the arena.
+    static thread_local CpuSet prev_;
+
+  public:
+
+    PinningObserver(oneapi::tbb::task_arena& arena, CpuSet cpus)
+            : oneapi::tbb::task_scheduler_observer(arena), cpus_(std::move(cpus)) {
+        observe(true);
+    }
+
+    ~PinningObserver() override { observe(false); }
+
+    // Threads which only join the arena to stream projections keep their own CPUs.
+    void on_scheduler_entry(bool is_worker) override {
+        if (!is_worker) return;
+        prev_ = threadAffinity();
+        pinThread(cpus_);
+    }
+
+    // The workers are shared with the other arenas.
+    void on_scheduler_exit(bool is_worker) override {
+        if (is_worker && !prev_.empty()) pinThread(prev_);
+    }
+};
+
+thread_local CpuSet PinningObserver::prev_;
+
+} // details
+
 Preprocessor::Preprocessor(FilterFactory *ramp_filter_factory, uint32_t num_threads)
         : num_threads_(num_threads),
     arena_(oneapi::tbb::task_arena(num_threads_)),
     ramp_filter_factory_(ramp_filter_factory) {
 }
 
-void Preprocessor::init(RawBufferType& buffer, size_t col_count, size_t row_count,
+Preprocessor::~Preprocessor() = default;
+
+void Preprocessor::setCpuAffinity(const CpuSet& cpus) {
+    observer_.reset();
+    if (cpus.empty()) return;
+    observer_ = std::make_unique<details::PinningObserver>(arena_, cpus);
+    spdlog::info("[Init] - Image-processing CPUs: {}", cpus.str());
+}
+
+void Preprocessor::init(size_t col_count, size_t row_count,
           const ImageprocParams& imgproc_params,
           const std::optional<PaganinParams>& paganin_cfg) {
-    initFilter(imgproc_params, buffer, col_count, row_count);
-    initPaganin(paganin_cfg, buffer, col_count, row_count);
+    stopStreaming();
+    last_chunk_ = k_NO_CHUNK;
+    streamed_chunk_ = k_NO_CHUNK;
+    row_count_ = row_count;
+    col_count_ = col_count;
+
+    workspace_.resize({num_threads_, row_count, col_count});
+    workspace_.prefault();
+    fast_log_ = imgproc_params.log_accuracy == LogAccuracy::FAST;
+    initFilter(imgproc_params, col_count, row_count);
+    initPaganin(paganin_cfg, col_count, row_count);
+    // Keep the plans measured for new sizes for the next start.
+    saveFftWisdom();
     minus_log_ = imgproc_params.minus_log;
+    tile_rows_ = details::tileRows(row_count, col_count, ramp_filter_->rowAlignment(), details::l2CacheSize());
 
     spdlog::info("[Init] - Ramp filter: {}", imgproc_params.ramp_filter.name);
+    spdlog::info("[Init] - Rows per preprocessing tile: {}", tile_rows_);
+    spdlog::info("[Init] - Logarithm: {}", fast_log_ ? "fast" : "exact");
     spdlog::info("[Init] - Number of image-processing threads: {}", num_threads_);
 }
 
@@ -43,51 +104,130 @@ void Preprocessor::process(RawBufferType& raw_buffer,
 #endif
 
     auto& projs = raw_buffer.front();
+    last_chunk_ = raw_buffer.frontChunk();
+    // Projections which have been streamed into the same buffer are skipped.
+    bool skip = streamed_chunk_ == last_chunk_ && stream_sino_ == sino_buffer && streamed_.size() == chunk_size;
+    streamed_chunk_ = k_NO_CHUNK;
 
     using namespace oneapi;
     arena_.execute([&]{
         tbb::parallel_for(tbb::blocked_range<int>(0, static_cast<int>(chunk_size)),
                           [&](const tbb::blocked_range<int> &block) {
+                              int thread_idx = tbb::this_task_arena::current_thread_index();
                               for (auto i = block.begin(); i != block.end(); ++i) {
-                                  float* p = &projs[i * num_pixels];
-
-                                  flatField(p, num_pixels, dark_avg, reciprocal);
+                                  if (skip && streamed_[i]) continue;
+                                  processProjection(&projs[i * num_pixels], sino_buffer, i, chunk_size,
+                                                    dark_avg, reciprocal, offset, thread_idx);
+                              }
+        });
+    });
+}
 
-                                  if (paganin_) {
-                                      paganin_->apply(p, i % num_threads_);
-                                  } else if (minus_log_) {
-                                      negativeLog(p, num_pixels);
-                                  }
+void Preprocessor::startStreaming(ProDtype* sino_buffer,
+                                  size_t chunk_size,
+                                  std::shared_ptr<const FlatField> flat_field,
+                                  int32_t offset) {
+    assert(!streaming());
+    streamed_.assign(chunk_size, 0);
+    stream_sino_ = sino_buffer;
+    stream_flat_field_ = std::move(flat_field);
+    stream_offset_ = offset;
+    streamed_chunk_ = k_NO_CHUNK;
+    stream_chunk_.store(last_chunk_ == k_NO_CHUNK ? k_ANY_CHUNK : last_chunk_ + 1);
+}
 
-                                  // FIXME: performance drops significantly if any dimension is not a produce of
-                                  //        powers of small primes!!!
-                                  ramp_filter_->apply(p, tbb::this_task_arena::current_thread_index());
+std::shared_ptr<const FlatField> Preprocessor::stopStreaming() {
+    size_t chunk_idx = stream_chunk_.exchange(k_NO_CHUNK);
+    // Pairs with the check of 'stream_chunk_' in streamProjection().
+    while (stream_users_.load() != 0) std::this_thread::yield();
+    streamed_chunk_ = chunk_idx;
+    return std::move(stream_flat_field_);
+}
 
-                                  // TODO: Add FDK scaler for cone beam
+bool Preprocessor::streamProjection(size_t chunk_idx, size_t data_idx, const RawDtype* src) {
+    stream_users_.fetch_add(1);
+    size_t expected = k_ANY_CHUNK;
+    stream_chunk_.compare_exchange_strong(expected, chunk_idx);
+    if (stream_chunk_.load() != chunk_idx || data_idx >= streamed_.size()) {
+        stream_users_.fetch_sub(1);
+        return false;
+    }
 
-                                  copyToSinogram(sino_buffer, projs, i, chunk_size, row_count, col_count, offset);
-                              }
-        });
+    // Join the arena to get a workspace of its own, or wait for one.
+    arena_.execute([&] {
+        int thread_idx = oneapi::tbb::this_task_arena::current_thread_index();
+        processProjection(src, stream_sino_, data_idx, streamed_.size(),
+                          stream_flat_field_->dark_avg, stream_flat_field_->reciprocal, stream_offset_,
+                          thread_idx);
     });
+    streamed_[data_idx] = 1;
+
+    stream_users_.fetch_sub(1);
+    return true;
+}
+
+void Preprocessor::processProjection(const RawDtype* src,
+                                     ProDtype* sino_buffer,
+                                     size_t idx,
+                                     size_t chunk_size,
+                                     const ProImageData& dark_avg,
+                                     const ProImageData& reciprocal,
+                                     int32_t offset,
+                                     int thread_idx) {
+    size_t row_count = row_count_;
+    size_t col_count = col_count_;
+    size_t num_pixels = row_count * col_count;
+    float* p = &workspace_[thread_idx * num_pixels];
+
+    if (paganin_) {
+        flatField(p, src, num_pixels, dark_avg, reciprocal);
+        paganin_->apply(p, thread_idx);
+        ramp_filter_->apply(p, thread_idx);
+        copyToSinogram(sino_buffer, p, idx, chunk_size, row_count, col_count, offset);
+        return;
+    }
+
+    // Process the projection in tiles of rows, so that it is read once from the raw buffer and
+    // written once to the sinograms.
+    for (size_t r = 0; r < row_count; r += tile_rows_) {
+        size_t n = std::min(tile_rows_, row_count - r);
+        size_t begin = r * col_count;
+        if (minus_log_ && fast_log_) {
+            flatField(p, src + begin, n * col_count, &dark_avg[begin], &reciprocal[begin], false);
+            simd::negativeLog(p, n * col_count);
+        } else {
+            flatField(p, src + begin, n * col_count, &dark_avg[begin], &reciprocal[begin], minus_log_);
+        }
+
+        ramp_filter_->applyRows(p, static_cast<int>(n), thread_idx);
+
+        // TODO: Add FDK scaler for cone beam
+
+        // The rows are flipped in the sinograms.
+        copyToSinogram(sino_buffer + (row_count - r - n) * chunk_size * col_count,
+                       p, idx, chunk_size, n, col_count, offset);
+    }
 }
 
 void Preprocessor::initPaganin(const std::optional<PaganinParams> &params,
-                               RawBufferType &buffer,
                                size_t col_count,
                                size_t row_count) {
     if (params.has_value()) {
         auto &p = params.value();
         paganin_ = std::make_unique<Paganin>(
-                p.pixel_size, p.lambda, p.delta, p.beta, p.distance, &buffer.front()[0], col_count, row_count);
+                p.pixel_size, p.lambda, p.delta, p.beta, p.distance, workspace_.data(), col_count, row_count,
+                num_threads_, fast_log_);
+    } else {
+        paganin_.reset();
     }
 }
 
 void Preprocessor::initFilter(const ImageprocParams &params,
-                              RawBufferType &buffer,
                               size_t col_count,
                               size_t row_count) {
     ramp_filter_ = ramp_filter_factory_->create(
-            params.ramp_filter.name, &buffer.front()[0], col_count, row_count, params.num_threads);
+            params.ramp_filter.name, workspace_.data(), col_count, row_count, params.num_threads,
+            params.ramp_filter.padding);
 }
 
 } // namespace recastx::recon
\ No newline at end of file
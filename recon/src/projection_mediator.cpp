@@ -10,10 +10,10 @@
 
 namespace recastx::recon {
 
-ProjectionMediator::ProjectionMediator(int capacity)
+ProjectionMediator::ProjectionMediator(size_t capacity)
      : monitor_every_{1}, 
        proj_id_{0},
-       queue_(capacity) {
+       queue_(capacity, QueuePolicy::DROP_OLDEST) {
 }
 
 void ProjectionMediator::push(DataType proj) {
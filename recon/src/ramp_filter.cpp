@@ -6,46 +6,141 @@
  *
  * The full license is in the file LICENSE, distributed with this software.
 */
-#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <tuple>
 
+#include "recon/fft.hpp"
 #include "recon/ramp_filter.hpp"
 
 namespace recastx::recon {
 
-RampFilter::RampFilter(float* data, int num_cols, int num_rows, int buffer_size)
-         : num_cols_(num_cols), num_rows_(num_rows)  {
-    freq_ = std::vector<std::vector<std::complex<float>>>(
-        buffer_size, std::vector<std::complex<float>>(num_cols_));
+namespace details {
 
-    fft_plan_ = fftwf_plan_dft_r2c_1d(
-        num_cols_, 
-        data,
-        reinterpret_cast<fftwf_complex*>(&freq_[0][0]),
-        FFTW_ESTIMATE);
+int nextSmoothLength(int n) {
+    for (int m = std::max(n, 1); ; ++m) {
+        int k = m;
+        for (int p : {2, 3, 5, 7}) {
+            while (k % p == 0) k /= p;
+        }
+        if (k == 1) return m;
+    }
+}
 
-    ffti_plan_ = fftwf_plan_dft_c2r_1d(
-        num_cols_,
-        reinterpret_cast<fftwf_complex*>(&freq_[0][0]),
-        data, 
-        FFTW_ESTIMATE);
+} // namespace details
+
+namespace {
+
+std::pair<fftwf_plan, fftwf_plan> planRows(float* data, std::complex<float>* freq,
+                                           int n, int num_freqs, int num_rows, unsigned flags) {
+    auto out = reinterpret_cast<fftwf_complex*>(freq);
+    auto fft = fftwf_plan_many_dft_r2c(1, &n, num_rows,
+                                       data, nullptr, 1, n,
+                                       out, nullptr, 1, num_freqs,
+                                       flags);
+    auto ffti = fftwf_plan_many_dft_c2r(1, &n, num_rows,
+                                        out, nullptr, 1, num_freqs,
+                                        data, nullptr, 1, n,
+                                        flags);
+    return {fft, ffti};
 }
 
-void RampFilter::apply(float *data, int buffer_index) {
-    for (int r = 0; r < num_rows_; ++r) {
-        auto idx = r * num_cols_;
+} // namespace
+
+RampFilter::RampFilter(float* data, int num_cols, int num_rows, int buffer_size, RampFilterPadding padding)
+         : num_cols_(num_cols),
+           num_rows_(num_rows),
+           padding_(padding),
+           padded_cols_(paddedLength(num_cols, padding)),
+           num_freqs_(padded_cols_ / 2 + 1),
+           block_rows_(std::min(num_rows, k_BLOCK_ROWS))  {
+    freq_ = std::vector<SpectrumType>(buffer_size, SpectrumType(block_rows_ * num_freqs_));
+
+    unsigned flags = fftPlanningFlags();
+    float* rows = data;
+    if (padding_ == RampFilterPadding::NONE) {
+        // The plans are executed on the images of different threads, which are not necessarily
+        // aligned like the one used for planning.
+        if ((static_cast<size_t>(num_cols_) * num_rows_) % 4 != 0) flags |= FFTW_UNALIGNED;
+    } else {
+        padded_ = std::vector<RowsType>(buffer_size, RowsType(block_rows_ * padded_cols_));
+        rows = padded_[0].data();
+    }
+
+    std::tie(fft_plan_, ffti_plan_) = planRows(rows, freq_[0].data(), padded_cols_, num_freqs_, block_rows_, flags);
+    int tail = num_rows_ % block_rows_;
+    if (tail > 0) {
+        std::tie(fft_tail_plan_, ffti_tail_plan_) = planRows(
+            rows, freq_[0].data(), padded_cols_, num_freqs_, tail, flags);
+    }
+}
+
+RampFilter::~RampFilter() {
+    for (auto plan : {fft_plan_, ffti_plan_, fft_tail_plan_, ffti_tail_plan_}) {
+        if (plan != nullptr) fftwf_destroy_plan(plan);
+    }
+}
 
-        fftwf_execute_dft_r2c(fft_plan_, 
-                              &data[idx],
-                              reinterpret_cast<fftwf_complex*>(&freq_[buffer_index][0]));
+void RampFilter::padRows(const float* src, float* dst, int n) const {
+    int pad = padded_cols_ - num_cols_;
+    for (int i = 0; i < n; ++i) {
+        const float* s = src + i * num_cols_;
+        float* d = dst + i * padded_cols_;
+        std::copy(s, s + num_cols_, d);
+        if (padding_ == RampFilterPadding::EDGE) {
+            // The padding wraps around to the left of the row in the periodic transform.
+            int right = pad / 2;
+            std::fill(d + num_cols_, d + num_cols_ + right, s[num_cols_ - 1]);
+            std::fill(d + num_cols_ + right, d + padded_cols_, s[0]);
+        } else {
+            std::fill(d + num_cols_, d + padded_cols_, 0.f);
+        }
+    }
+}
 
-        for (int c = 0; c < num_cols_; ++c) freq_[buffer_index][c] *= filter_[c];
+void RampFilter::apply(float *data, int buffer_index) {
+    applyRows(data, num_rows_, buffer_index);
+}
 
-        fftwf_execute_dft_c2r(ffti_plan_,
-                              reinterpret_cast<fftwf_complex*>(&freq_[buffer_index][0]),
-                              &data[idx]);
+void RampFilter::applyRows(float *data, int num_rows, int buffer_index) {
+    auto freq = reinterpret_cast<fftwf_complex*>(freq_[buffer_index].data());
+    auto& spectrum = freq_[buffer_index];
+    bool padded = padding_ != RampFilterPadding::NONE;
+    for (int r = 0; r < num_rows; r += block_rows_) {
+        int n = std::min(block_rows_, num_rows - r);
+        bool full = n == block_rows_;
+        assert(full || n == num_rows_ % block_rows_);
+        float* src = &data[r * num_cols_];
+        float* rows = src;
+        if (padded) {
+            rows = padded_[buffer_index].data();
+            padRows(src, rows, n);
+        }
+
+        fftwf_execute_dft_r2c(full ? fft_plan_ : fft_tail_plan_, rows, freq);
+
+        // The spectrum of a real signal is Hermitian and only the first half is stored.
+        for (int i = 0; i < n; ++i) {
+            auto row = &spectrum[i * num_freqs_];
+            for (int c = 0; c < num_freqs_; ++c) row[c] *= filter_[c];
+        }
+
+        fftwf_execute_dft_c2r(full ? ffti_plan_ : ffti_tail_plan_, freq, rows);
+
+        if (padded) {
+            for (int i = 0; i < n; ++i) {
+                std::copy_n(rows + i * padded_cols_, num_cols_, src + i * num_cols_);
+            }
+        }
     }
 }
 
+int RampFilter::paddedLength(int num_cols, RampFilterPadding padding) {
+    if (padding == RampFilterPadding::NONE) return num_cols;
+    return details::nextSmoothLength(2 * num_cols);
+}
+
 RampFilter::DataType RampFilter::frequency(int n) {
     auto ret = std::vector<float>(n);
     int mid = (n + 1) / 2;
@@ -55,13 +150,14 @@ RampFilter::DataType RampFilter::frequency(int n) {
 }
 
 
-RamlakFilter::RamlakFilter(float* data, int num_cols, int num_rows, int buffer_size)
-        : RampFilter(data, num_cols, num_rows, buffer_size)  {
+RamlakFilter::RamlakFilter(float* data, int num_cols, int num_rows, int buffer_size,
+                           RampFilterPadding padding)
+        : RampFilter(data, num_cols, num_rows, buffer_size, padding)  {
     initFilter();
 }
 
 void RamlakFilter::initFilter() {
-    filter_ = RamlakFilter::generate(num_cols_);
+    filter_ = RamlakFilter::generate(padded_cols_);
 }
 
 RampFilter::DataType RamlakFilter::generate(int n) {
@@ -72,13 +168,14 @@ RampFilter::DataType RamlakFilter::generate(int n) {
 }
 
 
-SheppFilter::SheppFilter(float* data, int num_cols, int num_rows, int buffer_size)
-        : RampFilter(data, num_cols, num_rows, buffer_size)  {
+SheppFilter::SheppFilter(float* data, int num_cols, int num_rows, int buffer_size,
+                         RampFilterPadding padding)
+        : RampFilter(data, num_cols, num_rows, buffer_size, padding)  {
     initFilter();
 }
 
 void SheppFilter::initFilter() {
-    filter_ = SheppFilter::generate(num_cols_);
+    filter_ = SheppFilter::generate(padded_cols_);
 }
 
 RampFilter::DataType SheppFilter::generate(int n) {
@@ -109,11 +206,12 @@ RampFilter::DataType SheppFilter::generate(int n) {
 
 std::unique_ptr<Filter> 
 RampFilterFactory::create(const std::string& name, 
-                          float* data, int num_cols, int num_rows, int buffer_size) {
+                          float* data, int num_cols, int num_rows, int buffer_size,
+                          RampFilterPadding padding) {
     
-    if (name == "shepp") return std::make_unique<SheppFilter>(data, num_cols, num_rows, buffer_size);
+    if (name == "shepp") return std::make_unique<SheppFilter>(data, num_cols, num_rows, buffer_size, padding);
 
-    if (name == "ramlak") return std::make_unique<RamlakFilter>(data, num_cols, num_rows, buffer_size);
+    if (name == "ramlak") return std::make_unique<RamlakFilter>(data, num_cols, num_rows, buffer_size, padding);
     
     throw std::invalid_argument("Unknown ramp filter: " + name);
 }
@@ -0,0 +1,188 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include "recon/recorder.hpp"
+
+namespace recastx::recon {
+
+namespace {
+
+size_t entrySize(const RawStreamIndexEntry& entry) {
+    return sizeof(RawDtype) * entry.num_rows * entry.num_cols;
+}
+
+} // namespace
+
+Recorder::Recorder(const std::string& path, size_t queue_size, size_t block_size)
+        : path_(path),
+          queue_(queue_size, QueuePolicy::DROP_NEWEST),
+          block_size_((std::max(block_size, K_ALIGNMENT) + K_ALIGNMENT - 1) / K_ALIGNMENT * K_ALIGNMENT),
+          block_(static_cast<char*>(std::aligned_alloc(K_ALIGNMENT, block_size_)), std::free) {
+    if (!block_) throw std::bad_alloc();
+
+    openFiles();
+
+    writer_ = std::thread(&Recorder::write, this);
+
+    spdlog::info("[Recorder] Recording raw stream to {} (direct I/O: {})", path_, direct_io_);
+}
+
+Recorder::~Recorder() {
+    running_ = false;
+    writer_.join();
+
+    ::close(data_fd_);
+    ::close(index_fd_);
+
+    spdlog::info("[Recorder] {} frames recorded to {}, {} frames dropped",
+                 num_recorded_, path_, num_dropped_);
+}
+
+bool Recorder::push(const Projection<>& proj) {
+    if (!failed_) {
+        auto ts = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        // Projections received from the DAQ client refer to the received message. Therefore,
+        // no image data is copied here.
+        if (queue_.tryPush({proj, static_cast<uint64_t>(ts)})) return true;
+    }
+
+    if (num_dropped_++ == 0) spdlog::warn("[Recorder] Cannot keep up with the data rate. Frames will be dropped");
+    return false;
+}
+
+void Recorder::openFiles() {
+    data_fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (data_fd_ >= 0) {
+        direct_io_ = true;
+    } else if (errno == EINVAL) {
+        // The file system does not support O_DIRECT. Rely on the write-behind of the page cache.
+        data_fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (data_fd_ < 0) {
+        throw std::runtime_error(fmt::format("Failed to open data file {}: {}", path_, std::strerror(errno)));
+    }
+
+    auto index_path = rawStreamIndexPath(path_);
+    index_fd_ = ::open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (index_fd_ < 0) {
+        ::close(data_fd_);
+        throw std::runtime_error(fmt::format("Failed to open index file {}: {}", index_path, std::strerror(errno)));
+    }
+
+    RawStreamHeader header;
+    header.entry_size = sizeof(RawStreamIndexEntry);
+    if (!writeAll(index_fd_, reinterpret_cast<const char*>(&header), sizeof header)) {
+        ::close(data_fd_);
+        ::close(index_fd_);
+        throw std::runtime_error(fmt::format("Failed to write index file: {}", index_path));
+    }
+}
+
+void Recorder::write() {
+    Frame frame;
+    while (running_ || !queue_.empty()) {
+        if (!queue_.waitAndPop(frame, 100)) continue;
+
+        if (failed_) {
+            ++num_dropped_;
+        } else {
+            append(frame);
+            ++num_recorded_;
+        }
+        // Release the message.
+        frame.proj = Projection<>{};
+    }
+
+    flush(true);
+}
+
+void Recorder::append(const Frame& frame) {
+    auto [num_rows, num_cols] = frame.proj.shape();
+
+    RawStreamIndexEntry entry;
+    entry.offset = flushed_ + block_fill_;
+    entry.frame = frame.proj.index;
+    entry.scan_index = static_cast<int32_t>(frame.proj.type);
+    entry.num_rows = static_cast<uint32_t>(num_rows);
+    entry.num_cols = static_cast<uint32_t>(num_cols);
+    entry.timestamp = frame.timestamp;
+    pending_.push_back(entry);
+
+    const char* src = frame.proj.bytes();
+    size_t remaining = entrySize(entry);
+    while (remaining > 0 && !failed_) {
+        size_t n = std::min(remaining, block_size_ - block_fill_);
+        std::memcpy(block_.get() + block_fill_, src, n);
+        block_fill_ += n;
+        src += n;
+        remaining -= n;
+        if (block_fill_ == block_size_) flush(false);
+    }
+}
+
+void Recorder::flush(bool final) {
+    if (failed_ || block_fill_ == 0) return;
+
+    size_t size = block_fill_;
+    if (final && direct_io_) {
+        // The size of a direct write must be aligned. The padding is truncated afterwards.
+        size = (block_fill_ + K_ALIGNMENT - 1) / K_ALIGNMENT * K_ALIGNMENT;
+        std::memset(block_.get() + block_fill_, 0, size - block_fill_);
+    }
+
+    bool padded = size != block_fill_;
+    if (!writeAll(data_fd_, block_.get(), size)) return;
+    flushed_ += block_fill_;
+    block_fill_ = 0;
+
+    if (padded && ::ftruncate(data_fd_, static_cast<off_t>(flushed_)) != 0) {
+        spdlog::error("[Recorder] Failed to truncate data file: {}", std::strerror(errno));
+    }
+
+    writeIndex();
+}
+
+bool Recorder::writeAll(int fd, const char* buf, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, buf, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            spdlog::error("[Recorder] Failed to write to {}: {}. Recording stopped", path_, std::strerror(errno));
+            failed_ = true;
+            return false;
+        }
+        buf += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void Recorder::writeIndex() {
+    // Only frames which have been completely written are indexed.
+    auto it = pending_.begin();
+    while (it != pending_.end() && it->offset + entrySize(*it) <= flushed_) ++it;
+    if (it == pending_.begin()) return;
+
+    writeAll(index_fd_,
+             reinterpret_cast<const char*>(pending_.data()),
+             static_cast<size_t>(it - pending_.begin()) * sizeof(RawStreamIndexEntry));
+    pending_.erase(pending_.begin(), it);
+}
+
+} // namespace recastx::recon
\ No newline at end of file
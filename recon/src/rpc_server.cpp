@@ -18,6 +18,37 @@ namespace recastx::recon {
 
 using namespace std::string_literals;
 
+BytesSentCounter::BytesSentCounter(Metrics& metrics, std::string stream)
+        : metrics_(metrics), stream_(std::move(stream)) {}
+
+std::string BytesSentCounter::peerHost(const std::string& peer) {
+    if (peer.rfind("ipv4:", 0) != 0 && peer.rfind("ipv6:", 0) != 0) return peer;
+    auto pos = peer.rfind(':');
+    if (pos <= 4) return peer.substr(5);
+    return peer.substr(5, pos - 5);
+}
+
+Counter& BytesSentCounter::counter(const std::string& host) {
+    std::lock_guard lk(mtx_);
+    auto it = counters_.find(host);
+    if (it != counters_.end()) return *it->second;
+
+    if (counters_.size() >= k_MAX_HOSTS) {
+        if (!other_) other_ = &metrics_.counter("recon_bytes_sent_total", "Bytes of data sent to the clients.",
+                                                {{"client", "other"}, {"stream", stream_}});
+        return *other_;
+    }
+
+    auto& c = metrics_.counter("recon_bytes_sent_total", "Bytes of data sent to the clients.",
+                               {{"client", host}, {"stream", stream_}});
+    counters_[host] = &c;
+    return c;
+}
+
+void BytesSentCounter::add(const grpc::ServerContext* context, size_t num_bytes) {
+    counter(peerHost(context->peer())).add(num_bytes);
+}
+
 ControlService::ControlService(Application* app) : app_(app) {}
 
 grpc::Status ControlService::StartAcquiring(grpc::ServerContext* /*context*/,
@@ -85,6 +116,41 @@ grpc::Status ControlService::SetScanMode(grpc::ServerContext* /*context*/,
     return grpc::Status::OK;
 }
 
+grpc::Status ControlService::GetMetrics(grpc::ServerContext* /*context*/,
+                                        const google::protobuf::Empty* /*req*/,
+                                        rpc::MetricsData* data) {
+    for (const auto& sample : app_->metrics().collect()) {
+        auto* metric = data->add_metrics();
+        metric->set_name(sample.name);
+        for (const auto& [key, value] : sample.labels) (*metric->mutable_labels())[key] = value;
+
+        if (sample.type != Metrics::Type::HISTOGRAM) {
+            metric->set_type(sample.type == Metrics::Type::COUNTER ? rpc::Metric_Type_COUNTER
+                                                                   : rpc::Metric_Type_GAUGE);
+            metric->set_value(sample.value);
+            continue;
+        }
+
+        const auto& hist = sample.histogram;
+        metric->set_type(rpc::Metric_Type_HISTOGRAM);
+        metric->set_count(hist.count);
+        // Recorded in microseconds but exported in seconds as in the text exposition.
+        metric->set_sum(static_cast<double>(hist.sum) * Histogram::k_SECONDS);
+        for (double q : Metrics::k_QUANTILES) {
+            auto* quantile = metric->add_quantiles();
+            quantile->set_quantile(q);
+            quantile->set_value(static_cast<double>(hist.quantile(q)) * Histogram::k_SECONDS);
+        }
+        for (size_t i = 0; i < hist.buckets.size(); ++i) {
+            if (hist.buckets[i] == 0) continue;
+            auto* bucket = metric->add_buckets();
+            bucket->set_upper_bound(static_cast<double>(Histogram::bucketUpperBound(i)) * Histogram::k_SECONDS);
+            bucket->set_count(hist.buckets[i]);
+        }
+    }
+    return grpc::Status::OK;
+}
+
 
 ImageprocService::ImageprocService(Application* app) : app_(app) {}
 
@@ -110,7 +176,8 @@ grpc::Status ImageprocService::SetRampFilter(grpc::ServerContext* /*context*/,
 }
 
 
-ProjectionTransferService::ProjectionTransferService(Application* app) : app_(app) {}
+ProjectionTransferService::ProjectionTransferService(Application* app)
+        : app_(app), bytes_sent_(app->metrics(), "projection") {}
 
 grpc::Status ProjectionTransferService::SetProjectionGeometry(grpc::ServerContext* /*context*/,
                                                               const rpc::ProjectionGeometry* geometry,
@@ -147,12 +214,13 @@ grpc::Status ProjectionTransferService::SetProjection(grpc::ServerContext* /*con
 }
 
 grpc::Status ProjectionTransferService::GetProjectionData(
-        grpc::ServerContext* /*context*/,
+        grpc::ServerContext* context,
         const google::protobuf::Empty*,
         grpc::ServerWriter<rpc::ProjectionData>* writer) {
     auto proj = app_->getProjectionData(100);
     if (proj) {
         writer->Write(proj.value());
+        bytes_sent_.add(context, proj->ByteSizeLong());
         spdlog::debug("Projection data sent");
     }
 
@@ -160,7 +228,8 @@ grpc::Status ProjectionTransferService::GetProjectionData(
 }
 
 
-ReconstructionService::ReconstructionService(Application* app) : app_(app) {}
+ReconstructionService::ReconstructionService(Application* app)
+        : app_(app), bytes_sent_(app->metrics(), "recon") {}
 
 grpc::Status ReconstructionService::SetReconGeometry(grpc::ServerContext* /*context*/,
                                                      const rpc::ReconGeometry* geometry,
@@ -208,9 +277,11 @@ grpc::Status ReconstructionService::SetVolume(grpc::ServerContext* /*context*/,
     return grpc::Status::OK;
 }
 
-grpc::Status ReconstructionService::GetReconData(grpc::ServerContext* /*context*/,
+grpc::Status ReconstructionService::GetReconData(grpc::ServerContext* context,
                                                  const google::protobuf::Empty*,
                                                  grpc::ServerWriter<rpc::ReconData>* writer) {
+    size_t num_bytes = 0;
+
     // - Do not block because slice request needs to be responsive
     // - If the number of the logical threads are more than the number of the physical threads, 
     //   the volume_data could always have value.
@@ -221,12 +292,14 @@ grpc::Status ReconstructionService::GetReconData(grpc::ServerContext* /*context*
         if (app_->hasVolume()) {
             for (const auto& item : volume_data) {
                 writer->Write(item);
+                num_bytes += item.ByteSizeLong();
             }
             spdlog::debug("Volume data sent");
         }
         
         for (const auto& item : slice_data) {
             writer->Write(item);
+            num_bytes += item.ByteSizeLong();
             auto ts = item.slice().timestamp();
             spdlog::debug("Slice data {} ({}) sent", sliceIdFromTimestamp(ts), ts);
         }
@@ -236,12 +309,14 @@ grpc::Status ReconstructionService::GetReconData(grpc::ServerContext* /*context*
         if (!slice_data.empty()) {
             for (const auto& item : slice_data) {
                 writer->Write(item);
+                num_bytes += item.ByteSizeLong();
                 auto ts = item.slice().timestamp();
                 spdlog::debug("On-demand slice data {} ({}) sent", sliceIdFromTimestamp(ts), ts);
             }
         }
     }
 
+    if (num_bytes > 0) bytes_sent_.add(context, num_bytes);
     return grpc::Status::OK;
 }
 
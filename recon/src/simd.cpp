@@ -0,0 +1,388 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RECON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#include "recon/simd.hpp"
+
+namespace recastx::recon::simd {
+
+namespace {
+
+std::atomic<Isa>& currentIsa() {
+    static std::atomic<Isa> isa { detectIsa() };
+    return isa;
+}
+
+namespace scalar {
+
+void convert(float* dst, const uint16_t* src, size_t n, size_t stride) {
+    for (size_t i = 0; i < n; ++i) dst[i] = static_cast<float>(src[i * stride]);
+}
+
+void accumulate(float* dst, const uint16_t* src, size_t n) {
+    for (size_t i = 0; i < n; ++i) dst[i] += static_cast<float>(src[i]);
+}
+
+void reduce(float* dst, const float* src, size_t n, size_t factor, float scale) {
+    for (size_t i = 0; i < n; ++i) {
+        float v = 0.f;
+        for (size_t k = 0; k < factor; ++k) v += src[k];
+        dst[i] = v * scale;
+        src += factor;
+    }
+}
+
+// Coefficients of the polynomial approximation of log(1 + x) - x + x^2 / 2 for x in
+// [sqrt(0.5) - 1, sqrt(2) - 1), from the Cephes library.
+constexpr float k_LOG_P[] = {7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f,
+                             -1.2420140846e-1f, 1.4249322787e-1f, -1.6668057665e-1f,
+                             2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f};
+constexpr float k_SQRT_HALF = 0.707106781186547524f;
+// ln(2) split into a part which is exact in float and the remainder
+constexpr float k_LN2_HI = 0.693359375f;
+constexpr float k_LN2_LO = -2.12194440e-4f;
+constexpr float k_MIN_NORMAL = 1.17549435e-38f;
+
+inline float approxLog(float v) {
+    v = std::max(v, k_MIN_NORMAL);
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(float));
+    // v = m * 2^e with m in [0.5, 1)
+    auto e = static_cast<float>(static_cast<int>(bits >> 23) - 126);
+    bits = (bits & 0x007FFFFF) | 0x3F000000;
+    float m;
+    std::memcpy(&m, &bits, sizeof(float));
+    float x;
+    if (m < k_SQRT_HALF) {
+        e -= 1.f;
+        x = m + m - 1.f;
+    } else {
+        x = m - 1.f;
+    }
+
+    float z = x * x;
+    float y = k_LOG_P[0];
+    for (size_t k = 1; k < std::size(k_LOG_P); ++k) y = y * x + k_LOG_P[k];
+    y = y * x * z + k_LN2_LO * e - 0.5f * z;
+    return x + y + k_LN2_HI * e;
+}
+
+void negativeLog(float* data, size_t n, float scale) {
+    for (size_t i = 0; i < n; ++i) {
+        float v = data[i];
+        data[i] = v <= 0.f ? 0.f : -scale * approxLog(v);
+    }
+}
+
+} // namespace scalar
+
+#ifdef RECON_SIMD_X86
+
+namespace avx2 {
+
+__attribute__((target("avx2")))
+void convert(float* dst, const uint16_t* src, size_t n, size_t stride) {
+    size_t i = 0;
+    if (stride == 1) {
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(v)));
+        }
+    } else if (stride == 2) {
+        // The even pixels are the lower halves of the 32-bit lanes. The last vector must not
+        // read beyond src[(n - 1) * stride].
+        const __m256i mask = _mm256_set1_epi32(0xFFFF);
+        for (; i + 8 < n; i += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+            _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_and_si256(v, mask)));
+        }
+    } else {
+        // Each gather reads 32 bits, i.e. the pixel and its right neighbour.
+        const __m256i mask = _mm256_set1_epi32(0xFFFF);
+        const __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                               _mm256_set1_epi32(static_cast<int>(stride)));
+        for (; i + 8 < n; i += 8) {
+            auto base = reinterpret_cast<const int*>(src + i * stride);
+            __m256i v = _mm256_i32gather_epi32(base, idx, 2);
+            _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_and_si256(v, mask)));
+        }
+    }
+    scalar::convert(dst + i, src + i * stride, n - i, stride);
+}
+
+__attribute__((target("avx2")))
+void accumulate(float* dst, const uint16_t* src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m256 acc = _mm256_loadu_ps(dst + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(acc, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(v))));
+    }
+    scalar::accumulate(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void reduce(float* dst, const float* src, size_t n, size_t factor, float scale) {
+    size_t i = 0;
+    const __m256 s = _mm256_set1_ps(scale);
+    if (factor == 1) {
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), s));
+        }
+    } else if (factor == 2) {
+        for (; i + 8 <= n; i += 8) {
+            __m256 a = _mm256_loadu_ps(src + 2 * i);
+            __m256 b = _mm256_loadu_ps(src + 2 * i + 8);
+            // [a01, a23, b01, b23, a45, a67, b45, b67] -> [a01, a23, a45, a67, b01, b23, b45, b67]
+            __m256d h = _mm256_castps_pd(_mm256_hadd_ps(a, b));
+            __m256 v = _mm256_castpd_ps(_mm256_permute4x64_pd(h, 0b11011000));
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(v, s));
+        }
+    }
+    scalar::reduce(dst + i, src + i * factor, n - i, factor, scale);
+}
+
+__attribute__((target("avx2")))
+void negativeLog(float* data, size_t n, float scale) {
+    size_t i = 0;
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 sqrt_half = _mm256_set1_ps(scalar::k_SQRT_HALF);
+    const __m256 min_normal = _mm256_set1_ps(scalar::k_MIN_NORMAL);
+    const __m256 neg_scale = _mm256_set1_ps(-scale);
+    const __m256i mantissa = _mm256_set1_epi32(0x007FFFFF);
+    const __m256i half_exponent = _mm256_set1_epi32(0x3F000000);
+    const __m256i bias = _mm256_set1_epi32(126);
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(data + i);
+        __m256 valid = _mm256_cmp_ps(v, zero, _CMP_GT_OQ);
+        __m256i bits = _mm256_castps_si256(_mm256_max_ps(v, min_normal));
+
+        __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), bias));
+        __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, mantissa), half_exponent));
+        __m256 lt = _mm256_cmp_ps(m, sqrt_half, _CMP_LT_OQ);
+        e = _mm256_sub_ps(e, _mm256_and_ps(lt, one));
+        __m256 x = _mm256_add_ps(_mm256_sub_ps(m, one), _mm256_and_ps(lt, m));
+
+        __m256 z = _mm256_mul_ps(x, x);
+        __m256 y = _mm256_set1_ps(scalar::k_LOG_P[0]);
+        for (size_t k = 1; k < std::size(scalar::k_LOG_P); ++k) {
+            y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(scalar::k_LOG_P[k]));
+        }
+        y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+        y = _mm256_add_ps(y, _mm256_mul_ps(e, _mm256_set1_ps(scalar::k_LN2_LO)));
+        y = _mm256_sub_ps(y, _mm256_mul_ps(z, half));
+        __m256 ret = _mm256_add_ps(_mm256_add_ps(x, y), _mm256_mul_ps(e, _mm256_set1_ps(scalar::k_LN2_HI)));
+
+        _mm256_storeu_ps(data + i, _mm256_and_ps(valid, _mm256_mul_ps(ret, neg_scale)));
+    }
+    scalar::negativeLog(data + i, n - i, scale);
+}
+
+} // namespace avx2
+
+// GCC 12 reports the _mm512_undefined_*() placeholders in the AVX-512 intrinsics as
+// maybe-uninitialized, which is a false positive.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace avx512 {
+
+__attribute__((target("avx512f")))
+void convert(float* dst, const uint16_t* src, size_t n, size_t stride) {
+    size_t i = 0;
+    if (stride == 1) {
+        for (; i + 16 <= n; i += 16) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            _mm512_storeu_ps(dst + i, _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(v)));
+        }
+    } else if (stride == 2) {
+        const __m512i mask = _mm512_set1_epi32(0xFFFF);
+        for (; i + 16 < n; i += 16) {
+            __m512i v = _mm512_loadu_si512(src + 2 * i);
+            _mm512_storeu_ps(dst + i, _mm512_cvtepi32_ps(_mm512_and_si512(v, mask)));
+        }
+    } else {
+        const __m512i mask = _mm512_set1_epi32(0xFFFF);
+        const __m512i idx = _mm512_mullo_epi32(
+            _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+            _mm512_set1_epi32(static_cast<int>(stride)));
+        for (; i + 16 < n; i += 16) {
+            __m512i v = _mm512_i32gather_epi32(idx, src + i * stride, 2);
+            _mm512_storeu_ps(dst + i, _mm512_cvtepi32_ps(_mm512_and_si512(v, mask)));
+        }
+    }
+    scalar::convert(dst + i, src + i * stride, n - i, stride);
+}
+
+__attribute__((target("avx512f")))
+void accumulate(float* dst, const uint16_t* src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m512 acc = _mm512_loadu_ps(dst + i);
+        _mm512_storeu_ps(dst + i, _mm512_add_ps(acc, _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(v))));
+    }
+    scalar::accumulate(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+void reduce(float* dst, const float* src, size_t n, size_t factor, float scale) {
+    size_t i = 0;
+    const __m512 s = _mm512_set1_ps(scale);
+    if (factor == 1) {
+        for (; i + 16 <= n; i += 16) {
+            _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_loadu_ps(src + i), s));
+        }
+    } else if (factor == 2) {
+        const __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+        const __m512i odd = _mm512_add_epi32(even, _mm512_set1_epi32(1));
+        for (; i + 16 <= n; i += 16) {
+            __m512 a = _mm512_loadu_ps(src + 2 * i);
+            __m512 b = _mm512_loadu_ps(src + 2 * i + 16);
+            __m512 v = _mm512_add_ps(_mm512_permutex2var_ps(a, even, b), _mm512_permutex2var_ps(a, odd, b));
+            _mm512_storeu_ps(dst + i, _mm512_mul_ps(v, s));
+        }
+    }
+    scalar::reduce(dst + i, src + i * factor, n - i, factor, scale);
+}
+
+__attribute__((target("avx512f")))
+void negativeLog(float* data, size_t n, float scale) {
+    size_t i = 0;
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one = _mm512_set1_ps(1.f);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 sqrt_half = _mm512_set1_ps(scalar::k_SQRT_HALF);
+    const __m512 min_normal = _mm512_set1_ps(scalar::k_MIN_NORMAL);
+    const __m512 neg_scale = _mm512_set1_ps(-scale);
+    const __m512i mantissa = _mm512_set1_epi32(0x007FFFFF);
+    const __m512i half_exponent = _mm512_set1_epi32(0x3F000000);
+    const __m512i bias = _mm512_set1_epi32(126);
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_loadu_ps(data + i);
+        __mmask16 valid = _mm512_cmp_ps_mask(v, zero, _CMP_GT_OQ);
+        __m512i bits = _mm512_castps_si512(_mm512_max_ps(v, min_normal));
+
+        __m512 e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23), bias));
+        __m512 m = _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(bits, mantissa), half_exponent));
+        __mmask16 lt = _mm512_cmp_ps_mask(m, sqrt_half, _CMP_LT_OQ);
+        e = _mm512_mask_sub_ps(e, lt, e, one);
+        __m512 x = _mm512_sub_ps(m, one);
+        x = _mm512_mask_add_ps(x, lt, x, m);
+
+        __m512 z = _mm512_mul_ps(x, x);
+        __m512 y = _mm512_set1_ps(scalar::k_LOG_P[0]);
+        for (size_t k = 1; k < std::size(scalar::k_LOG_P); ++k) {
+            y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(scalar::k_LOG_P[k]));
+        }
+        y = _mm512_mul_ps(_mm512_mul_ps(y, x), z);
+        y = _mm512_add_ps(y, _mm512_mul_ps(e, _mm512_set1_ps(scalar::k_LN2_LO)));
+        y = _mm512_sub_ps(y, _mm512_mul_ps(z, half));
+        __m512 ret = _mm512_add_ps(_mm512_add_ps(x, y), _mm512_mul_ps(e, _mm512_set1_ps(scalar::k_LN2_HI)));
+
+        _mm512_storeu_ps(data + i, _mm512_maskz_mul_ps(valid, ret, neg_scale));
+    }
+    scalar::negativeLog(data + i, n - i, scale);
+}
+
+} // namespace avx512
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // RECON_SIMD_X86
+
+} // namespace
+
+Isa detectIsa() {
+#ifdef RECON_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return Isa::AVX512;
+    if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+#endif
+    return Isa::SCALAR;
+}
+
+Isa isa() {
+    return currentIsa().load(std::memory_order_relaxed);
+}
+
+Isa setIsa(Isa isa) {
+    Isa best = detectIsa();
+    if (static_cast<int>(isa) > static_cast<int>(best)) isa = best;
+    currentIsa().store(isa, std::memory_order_relaxed);
+    return isa;
+}
+
+const char* isaName(Isa isa) {
+    switch (isa) {
+        case Isa::AVX512: return "AVX-512";
+        case Isa::AVX2: return "AVX2";
+        default: return "scalar";
+    }
+}
+
+void convert(float* dst, const uint16_t* src, size_t n, size_t stride) {
+#ifdef RECON_SIMD_X86
+    switch (isa()) {
+        case Isa::AVX512: return avx512::convert(dst, src, n, stride);
+        case Isa::AVX2: return avx2::convert(dst, src, n, stride);
+        default: break;
+    }
+#endif
+    scalar::convert(dst, src, n, stride);
+}
+
+void accumulate(float* dst, const uint16_t* src, size_t n) {
+#ifdef RECON_SIMD_X86
+    switch (isa()) {
+        case Isa::AVX512: return avx512::accumulate(dst, src, n);
+        case Isa::AVX2: return avx2::accumulate(dst, src, n);
+        default: break;
+    }
+#endif
+    scalar::accumulate(dst, src, n);
+}
+
+void reduce(float* dst, const float* src, size_t n, size_t factor, float scale) {
+#ifdef RECON_SIMD_X86
+    switch (isa()) {
+        case Isa::AVX512: return avx512::reduce(dst, src, n, factor, scale);
+        case Isa::AVX2: return avx2::reduce(dst, src, n, factor, scale);
+        default: break;
+    }
+#endif
+    scalar::reduce(dst, src, n, factor, scale);
+}
+
+void negativeLog(float* data, size_t n, float scale) {
+#ifdef RECON_SIMD_X86
+    switch (isa()) {
+        case Isa::AVX512: return avx512::negativeLog(data, n, scale);
+        case Isa::AVX2: return avx2::negativeLog(data, n, scale);
+        default: break;
+    }
+#endif
+    scalar::negativeLog(data, n, scale);
+}
+
+} // namespace recastx::recon::simd
\ No newline at end of file
@@ -7,6 +7,7 @@
  * The full license is in the file LICENSE, distributed with this software.
 */
 #include <cassert>
+#include <optional>
 
 #include "common/utils.hpp"
 #include "recon/slice_mediator.hpp"
@@ -23,6 +24,20 @@ void SliceMediator::resize(const SliceBuffer<float>::ShapeType& shape) {
     ondemand_slices_.resize(shape);
 }
 
+void SliceMediator::registerMetrics(Metrics& metrics) {
+    recon_time_ = &metrics.histogram("recon_slice_reconstruction_seconds",
+                                     "Time to reconstruct a slice.", {{"mode", "all"}});
+    ondemand_recon_time_ = &metrics.histogram("recon_slice_reconstruction_seconds",
+                                              "Time to reconstruct a slice.", {{"mode", "on_demand"}});
+
+    metrics.counter("recon_triple_buffer_dropped_total",
+                    "Reconstructed data overwritten before being sent to the clients.",
+                    [this] { return all_slices_.numDropped(); }, {{"buffer", "slices"}});
+    metrics.counter("recon_triple_buffer_dropped_total",
+                    "Reconstructed data overwritten before being sent to the clients.",
+                    [this] { return ondemand_slices_.numDropped(); }, {{"buffer", "on_demand_slices"}});
+}
+
 void SliceMediator::update(size_t timestamp, const Orientation& orientation) {
     spdlog::debug("Update slice ({}) orientation: {}, {}, {}, {}, {}, {}, {}, {}, {}", timestamp,
                   orientation[0], orientation[1], orientation[2],
@@ -49,6 +64,8 @@ void SliceMediator::reconAll(Reconstructor* recon, int gpu_buffer_index) {
 
         for (const auto& [sid, param] : params_) {
             auto& slice = all_slices_.back()[sid];
+            std::optional<LatencyTimer> timer;
+            if (recon_time_) timer.emplace(*recon_time_);
             recon->reconstructSlice(param.second, gpu_buffer_index, std::get<2>(slice));
             std::get<1>(slice) = param.first;
         }
@@ -69,6 +86,8 @@ void SliceMediator::reconOnDemand(Reconstructor* recon, int gpu_buffer_index) {
             for (auto sid : updated_) {
                 auto& slice = ondemand_slices_.back()[sid];
                 auto& param = params_[sid];
+                std::optional<LatencyTimer> timer;
+                if (ondemand_recon_time_) timer.emplace(*ondemand_recon_time_);
                 recon->reconstructSlice(param.second, gpu_buffer_index, std::get<2>(slice));
                 std::get<1>(slice) = param.first;
                 std::get<0>(slice) = true;
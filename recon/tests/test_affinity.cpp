@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <filesystem>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "recon/affinity.hpp"
+
+namespace recastx::recon::test {
+
+using ::testing::ElementsAre;
+
+TEST(CpuSetTest, TestParse) {
+    EXPECT_TRUE(CpuSet::parse("").empty());
+    EXPECT_THAT(CpuSet::parse("3").cpus(), ElementsAre(3));
+    EXPECT_THAT(CpuSet::parse("5,1,3,1").cpus(), ElementsAre(1, 3, 5));
+    EXPECT_THAT(CpuSet::parse("0-3,8,10-11").cpus(), ElementsAre(0, 1, 2, 3, 8, 10, 11));
+
+    EXPECT_THROW(CpuSet::parse("a"), std::invalid_argument);
+    EXPECT_THROW(CpuSet::parse("1,"), std::invalid_argument);
+    EXPECT_THROW(CpuSet::parse("-1"), std::invalid_argument);
+    EXPECT_THROW(CpuSet::parse("3-1"), std::invalid_argument);
+    EXPECT_THROW(CpuSet::parse("1-2x"), std::invalid_argument);
+    EXPECT_THROW(CpuSet::parse("node:a"), std::invalid_argument);
+}
+
+TEST(CpuSetTest, TestNumaNode) {
+    if (!std::filesystem::exists("/sys/devices/system/node/node0/cpulist")) {
+        GTEST_SKIP() << "NUMA topology is not available";
+    }
+    auto cpus = CpuSet::parse("node:0");
+    EXPECT_FALSE(cpus.empty());
+    EXPECT_EQ(cpus.cpus(), CpuSet::numaNode(0).cpus());
+
+    EXPECT_THROW(CpuSet::numaNode(100000), std::invalid_argument);
+}
+
+TEST(CpuSetTest, TestStr) {
+    EXPECT_EQ(CpuSet().str(), "any");
+    EXPECT_EQ(CpuSet({2}).str(), "2");
+    EXPECT_EQ(CpuSet({0, 1, 2, 3, 8, 10, 11}).str(), "0-3,8,10-11");
+    EXPECT_EQ(CpuSet::parse(CpuSet({4, 5, 6, 9}).str()).cpus(), CpuSet({4, 5, 6, 9}).cpus());
+}
+
+#if defined(__linux__)
+
+TEST(PinThreadTest, TestPinThread) {
+    int cpu = sched_getcpu();
+    ASSERT_GE(cpu, 0);
+
+    EXPECT_TRUE(pinThread({}));
+
+    int pinned = -1;
+    runOn(CpuSet({cpu}), [&] {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        ASSERT_EQ(sched_getaffinity(0, sizeof(set), &set), 0);
+        EXPECT_EQ(CPU_COUNT(&set), 1);
+        EXPECT_TRUE(CPU_ISSET(cpu, &set));
+        pinned = sched_getcpu();
+    });
+    EXPECT_EQ(pinned, cpu);
+}
+
+TEST(PinThreadTest, TestScopedPin) {
+    std::thread([] {
+        auto prev = threadAffinity();
+        ASSERT_FALSE(prev.empty());
+        {
+            ScopedPin pin(CpuSet({prev.cpus()[0]}));
+            EXPECT_EQ(threadAffinity().cpus(), std::vector<int>{prev.cpus()[0]});
+        }
+        EXPECT_EQ(threadAffinity().cpus(), prev.cpus());
+    }).join();
+}
+
+#endif
+
+TEST(PinThreadTest, TestRunOnInline) {
+    auto id = std::this_thread::get_id();
+    std::thread::id called;
+    runOn({}, [&] { called = std::this_thread::get_id(); });
+    EXPECT_EQ(called, id);
+}
+
+} // namespace recastx::recon::test
\ No newline at end of file
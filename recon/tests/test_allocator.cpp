@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "recon/allocator.hpp"
+#include "recon/tensor.hpp"
+
+namespace recastx::recon::test {
+
+using ::testing::ElementsAre;
+using ::testing::Each;
+
+class AlignedAllocatorTest : public testing::Test {
+
+  protected:
+
+    void TearDown() override {
+        setHugePages(HugePages::TRANSPARENT);
+    }
+};
+
+TEST_F(AlignedAllocatorTest, TestAlignment) {
+    for (size_t n : {1, 3, 100, 1000, 1 << 20, (1 << 20) + 1}) {
+        std::vector<float, AlignedAllocator<float>> v(n);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(v.data()) % 64, 0u) << n;
+        // Large allocations are aligned to the huge page size.
+        if (n * sizeof(float) >= details::k_HUGE_PAGE_SIZE) {
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(v.data()) % details::k_HUGE_PAGE_SIZE, 0u) << n;
+        }
+        v.back() = 1.f;
+    }
+}
+
+TEST_F(AlignedAllocatorTest, TestHugePages) {
+    for (auto policy : {HugePages::NONE, HugePages::TRANSPARENT, HugePages::EXPLICIT}) {
+        setHugePages(policy);
+        EXPECT_EQ(hugePages(), policy);
+
+        // Explicit huge pages fall back to transparent huge pages if none is reserved.
+        size_t n = details::k_HUGE_PAGE_SIZE + 100;
+        std::vector<uint8_t, AlignedAllocator<uint8_t>> v(n);
+        prefault(v.data(), n);
+        std::fill(v.begin(), v.end(), 1);
+        EXPECT_EQ(v[0], 1);
+        EXPECT_EQ(v[n - 1], 1);
+    }
+}
+
+TEST_F(AlignedAllocatorTest, TestPrefault) {
+    std::vector<int, AlignedAllocator<int>> v(5000);
+    std::iota(v.begin(), v.end(), 0);
+    prefault(v.data(), v.size() * sizeof(int));
+    for (size_t i = 0; i < v.size(); ++i) ASSERT_EQ(v[i], static_cast<int>(i));
+
+    prefault(nullptr, 0);
+}
+
+TEST_F(AlignedAllocatorTest, TestAlignedTensor) {
+    AlignedTensor<float, 2> t1({2, 3}, {1, 2, 3, 4, 5, 6});
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(t1.data()) % 64, 0u);
+
+    AlignedTensor<float, 2> t2({2, 3});
+    std::fill(t2.begin(), t2.end(), 1.f);
+    t2.prefault();
+    AlignedTensor<float, 2> sum = t1 + t2;
+    EXPECT_THAT(sum, ElementsAre(2, 3, 4, 5, 6, 7));
+
+    AlignedTensor<float, 2> t3(std::move(t1));
+    EXPECT_THAT(t3, ElementsAre(1, 2, 3, 4, 5, 6));
+    EXPECT_EQ(t1.size(), 0);
+
+    t3.resize({4, 3}, 0.f);
+    EXPECT_THAT(std::vector<float>(t3.begin() + 6, t3.end()), Each(0.f));
+}
+
+} // namespace recastx::recon::test
\ No newline at end of file
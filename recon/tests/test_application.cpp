@@ -6,6 +6,7 @@
  *
  * The full license is in the file LICENSE, distributed with this software.
 */
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <vector>
@@ -26,6 +27,7 @@ using ::testing::FloatNear;
 class MockDaqClient : public DaqClientInterface {
 
     ThreadSafeQueue<Projection<>> buffer_;
+    std::atomic<size_t> taken_ = 0;
 
   public:
 
@@ -36,9 +38,13 @@ class MockDaqClient : public DaqClientInterface {
     void setAcquiring(bool state) override {}
 
     [[nodiscard]] virtual bool next(Projection<>& proj) override {
-        return buffer_.waitAndPop(proj, 100);
+        if (!buffer_.waitAndPop(proj, 100)) return false;
+        ++taken_;
+        return true;
     }
 
+    [[nodiscard]] size_t numTaken() const override { return taken_; }
+
     template<typename... Args>
     void push(Args&&... args) {
         buffer_.tryPush(Projection<>(std::forward<Args>(args)...));
@@ -55,7 +61,11 @@ class MockRampFilter : public Filter {
     MockRampFilter(int num_cols, int num_rows) : num_cols_(num_cols), num_rows_(num_rows), Filter() {}
 
     void apply(float* data, int buffer_index) override {
-        for (int i = 0; i < num_cols_ * num_rows_; ++i) {
+        applyRows(data, num_rows_, buffer_index);
+    }
+
+    void applyRows(float* data, int num_rows, int buffer_index) override {
+        for (int i = 0; i < num_cols_ * num_rows; ++i) {
             data[i] += 1.f;
         }
     }
@@ -64,7 +74,8 @@ class MockRampFilter : public Filter {
 class MockRampFilterFactory : public FilterFactory {
 
     std::unique_ptr<Filter> create(const std::string& name, 
-                                   float* data, int num_cols, int num_rows, int buffer_size) override {
+                                   float* data, int num_cols, int num_rows, int buffer_size,
+                                   RampFilterPadding padding) override {
         return std::make_unique<MockRampFilter>(num_cols, num_rows);
     }
 };
@@ -140,7 +151,7 @@ class ApplicationTest : public testing::Test {
 
     const RpcServerConfig rpc_cfg {12347};
     const ImageprocParams imgproc_params {
-        threads_, downsampling_col_, downsampling_row_, 0, true, {filter_name_}
+        threads_, downsampling_col_, downsampling_row_, DownsamplingMode::DECIMATION, 0, true, {filter_name_}
     };
 
     Application app_;
@@ -206,7 +217,6 @@ class ApplicationTest : public testing::Test {
 
 TEST_F(ApplicationTest, TestPushProjection) {
     app_.startConsuming();
-    app_.startPreprocessing();
     app_.startProcessing();
 
     pushDarks(num_darks_);
@@ -235,7 +245,6 @@ TEST_F(ApplicationTest, TestPushProjection) {
 
 TEST_F(ApplicationTest, TestMemoryBufferReset) {
     app_.startConsuming();
-    app_.startPreprocessing();
     app_.startProcessing();
 
     pushDarks(num_darks_);
@@ -245,17 +254,16 @@ TEST_F(ApplicationTest, TestMemoryBufferReset) {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
     EXPECT_EQ(app_.rawBuffer().occupied(), 2);
 
-    // test reset when darks or flats received after projections
+    // data are kept when darks or flats received after projections
     pushDarks(num_darks_);
     pushFlats(num_flats_);
-    pushProjection(0, 1);
+    pushProjection(1, 2);
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    EXPECT_EQ(app_.rawBuffer().occupied(), 1);
+    EXPECT_EQ(app_.rawBuffer().occupied(), 2);
 }
 
 TEST_F(ApplicationTest, TestPushProjectionUnordered) {
     app_.startConsuming();
-    app_.startPreprocessing();
     app_.startProcessing();
     
     pushDarks(num_darks_);
@@ -289,9 +297,6 @@ TEST_F(ApplicationTest, TestPushProjectionUnordered) {
 
 TEST_F(ApplicationTest, TestReconstructing) {
     app_.startConsuming();
-    app_.startPreprocessing();
-    app_.startReconstructing();
-    app_.startReconstructingOnDemand();
     app_.startProcessing();
 
     pushDarks(num_darks_);
@@ -305,27 +310,28 @@ TEST_F(ApplicationTest, TestReconstructing) {
     EXPECT_EQ(dynamic_cast<const MockReconstructor*>(app_.reconstructor())->numSlices(), 0);
 }
 
-// FIXME: fix Paganin
 TEST_F(ApplicationTest, TestWithPagagin) {
-    // float pixel_size = 1.0f;
-    // float lambda = 1.23984193e-9f;
-    // float delta = 1.e-8f;
-    // float beta = 1.e-10f;
-    // float distance = 40.f;
-    // app_.setPaganinParams(pixel_size, lambda, delta, beta, distance);
+    float pixel_size = 1.0f;
+    float lambda = 1.23984193e-9f;
+    float delta = 1.e-8f;
+    float beta = 1.e-10f;
+    float distance = 40.f;
+    app_.setPaganinParams(pixel_size, lambda, delta, beta, distance);
 
     app_.startConsuming();
-    app_.startPreprocessing();
     app_.startProcessing();
     
-    // pushDarks(num_darks_);
-    // pushFlats(num_flats_);
-    // pushProjection(0, num_angles_);
+    pushDarks(num_darks_);
+    pushFlats(num_flats_);
+    pushProjection(0, num_angles_);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    EXPECT_EQ(dynamic_cast<const MockReconstructor*>(app_.reconstructor())->numUploads(), 1);
 }
 
 TEST_F(ApplicationTest, TestDownsampling) {
     app_.startConsuming();
-    app_.startPreprocessing();
     app_.startProcessing();
 
     pushDarks(num_darks_);
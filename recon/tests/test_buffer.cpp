@@ -6,6 +6,9 @@
  *
  * The full license is in the file LICENSE, distributed with this software.
 */
+#include <atomic>
+#include <thread>
+
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
@@ -53,7 +56,9 @@ TEST(TripleTensorBufferTest, TestPrepareAndFetch) {
     ASSERT_FALSE(b2f.prepare());
     ASSERT_FALSE(b2f.tryPrepare(1));
     EXPECT_THAT(b2f.ready(), Pointwise(FloatNear(1e-6), data2));
+    ASSERT_EQ(b2f.numDropped(), 0);
     ASSERT_TRUE(b2f.prepare());
+    ASSERT_EQ(b2f.numDropped(), 1);
     b2f.fetch(0);
     ASSERT_TRUE(b2f.tryPrepare(1));
 }
@@ -168,6 +173,81 @@ TEST(MemoryBufferTestUtils, TestCopyToBuffer) {
     }
 }
 
+TEST(MemoryBufferTestUtils, TestCopyToBufferBinning) {
+    {
+        ProDtype dst[6];
+        std::array<size_t, 2> dst_shape {2, 3};
+        auto src = _produceRawData({1, 3, 2, 4, 3, 5,
+                                                  1, 3, 2, 4, 3, 5,
+                                                  4, 6, 5, 7, 6, 8,
+                                                  4, 6, 5, 7, 6, 8});
+        details::copyToBuffer<ProDtype, RawDtype>(
+            dst, dst_shape, src.data(), {4, 6}, {2, 2}, DownsamplingMode::BINNING);
+        EXPECT_THAT(dst, Pointwise(FloatNear(1e-6), {2., 3., 4., 5., 6., 7.}));
+    }
+    {
+        ProDtype dst[20] = {0.f};
+        std::array<size_t, 2> dst_shape {4, 5};
+        auto src = _produceRawData({6, 0, 5, 1, 4, 2, 1,
+                                                  6, 0, 5, 1, 4, 2, 1,
+                                                  3, 1, 2, 2, 1, 3, 1,
+                                                  3, 1, 2, 2, 1, 3, 1,
+                                                  1, 1, 1, 1, 1, 1, 1});
+        details::copyToBuffer<ProDtype, RawDtype>(
+            dst, dst_shape, src.data(), {5, 7}, {2, 2}, DownsamplingMode::BINNING);
+        EXPECT_THAT(dst, Pointwise(FloatNear(1e-6), {0., 0., 0., 0., 0.,
+                                                     0., 3., 3., 3., 0.,
+                                                     0., 2., 2., 2., 0.,
+                                                     0., 0., 0., 0., 0.}));
+    }
+    {
+        // Rows long enough to exercise the vectorised kernels.
+        constexpr size_t rows = 6, cols = 99;
+        std::vector<RawDtype> data(rows * cols);
+        std::iota(data.begin(), data.end(), 0);
+        auto src = _produceRawData(std::move(data));
+        std::vector<ProDtype> dst(2 * 33);
+        details::copyToBuffer<ProDtype, RawDtype>(
+            dst.data(), {2, 33}, src.data(), {rows, cols}, {3, 3}, DownsamplingMode::BINNING);
+        for (size_t i = 0; i < 2; ++i) {
+            for (size_t j = 0; j < 33; ++j) {
+                // The mean of the 3 x 3 block is its central pixel.
+                EXPECT_FLOAT_EQ(dst[i * 33 + j], static_cast<float>((3 * i + 1) * cols + 3 * j + 1));
+            }
+        }
+    }
+}
+
+TEST(MemoryBufferTestUtils, TestCopyRawToBuffer) {
+    {
+        RawDtype dst[6];
+        auto src = _produceRawData({1, 2, 3, 4, 5, 6});
+        details::copyToBuffer<RawDtype, RawDtype>(dst, {2, 3}, src.data(), {2, 3}, {1, 1});
+        EXPECT_THAT(dst, ElementsAre(1, 2, 3, 4, 5, 6));
+    }
+    {
+        RawDtype dst[16] = {0};
+        auto src = _produceRawData({1, 1, 2, 1, 3, 1,
+                                                  1, 1, 2, 1, 3, 1,
+                                                  4, 1, 5, 1, 6, 1,
+                                                  4, 1, 5, 1, 6, 1});
+        details::copyToBuffer<RawDtype, RawDtype>(dst, {4, 4}, src.data(), {4, 6}, {2, 2});
+        EXPECT_THAT(dst, ElementsAre(0, 0, 0, 0,
+                                     1, 2, 3, 0,
+                                     4, 5, 6, 0,
+                                     0, 0, 0, 0));
+    }
+    {
+        // The block averages are rounded.
+        RawDtype dst[3];
+        auto src = _produceRawData({1, 2, 2, 2, 65535, 65535,
+                                                  1, 2, 3, 2, 65535, 65534});
+        details::copyToBuffer<RawDtype, RawDtype>(
+            dst, {1, 3}, src.data(), {2, 6}, {2, 2}, DownsamplingMode::BINNING);
+        EXPECT_THAT(dst, ElementsAre(2, 2, 65535));
+    }
+}
+
 
 class MemoryBufferTest : public testing::Test {
 
@@ -199,8 +279,9 @@ TEST_F(MemoryBufferTest, TestGeneral) {
     buffer_.fill<RawDtype>(0, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
     ASSERT_EQ(buffer_.occupied(), 1);
     buffer_.fill<RawDtype>(1, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
-    buffer_.fill<RawDtype>(2, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
-    buffer_.fill<RawDtype>(3, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
+    EXPECT_FALSE(buffer_.fill<RawDtype>(2, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1}));
+    // The last frame completes the chunk.
+    EXPECT_TRUE(buffer_.fill<RawDtype>(3, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1}));
 
     ASSERT_TRUE(buffer_.fetch(-1));
     EXPECT_THAT(buffer_.front(),
@@ -222,6 +303,7 @@ TEST_F(MemoryBufferTest, TestBufferFull) {
         buffer_.fill<RawDtype>(4 + j, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
     }
     ASSERT_EQ(buffer_.occupied(), 1); // group 0 was dropped
+    EXPECT_EQ(buffer_.numDroppedChunks(), 1);
     EXPECT_THAT(buffer_.ready(),
                 Pointwise(FloatNear(1e-6), {6., 5., 4., 3., 2., 1.,
                                             6., 5., 4., 3., 2., 1.,
@@ -233,6 +315,7 @@ TEST_F(MemoryBufferTest, TestBufferFull) {
         buffer_.fill<RawDtype>(4 * (capacity_ + 2) + j, _produceRawData({4, 5, 6, 7, 8, 9}).data(), {2, 3}, {1, 1});
     }
     ASSERT_EQ(buffer_.occupied(), 3);
+    EXPECT_EQ(buffer_.numDroppedChunks(), 2);
 
     for (size_t j = 0; j < shape_[0]-1; ++j) {
         buffer_.fill<RawDtype>(4 * (capacity_ + 1) + j, _produceRawData({1, 3, 5, 7, 9, 11}).data(), {2, 3}, {1, 1});
@@ -241,6 +324,7 @@ TEST_F(MemoryBufferTest, TestBufferFull) {
 
     buffer_.fill<RawDtype>(4 * (capacity_ + 2) + shape_[0] - 1, _produceRawData({9, 8, 7, 6, 5, 4}).data(), {2, 3}, {1, 1});
     ASSERT_EQ(buffer_.occupied(), 1); // group 3 was dropped
+    EXPECT_EQ(buffer_.numDroppedChunks(), 4);
     buffer_.fetch(-1);
     EXPECT_THAT(buffer_.front(),
                 Pointwise(FloatNear(1e-6), {4., 5., 6., 7., 8., 9.,
@@ -251,23 +335,208 @@ TEST_F(MemoryBufferTest, TestBufferFull) {
 
 TEST_F(MemoryBufferTest, TestSameDataReceivedRepeatedly) {
     for (size_t i = 0; i < 8; ++i) {
-        // Attempt to fill the 1st group.
+        // Duplicated data do not complete a chunk.
+        for (size_t j = 0; j < shape_[0] - 1; ++j) {
+            buffer_.fill<RawDtype>(4 * i + 1, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+        }
+        ASSERT_FALSE(buffer_.isReady());
+        ASSERT_EQ(buffer_.occupied(), 1);
+
         for (size_t j = 0; j < shape_[0]; ++j) {
-            buffer_.fill<RawDtype>(j, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+            if (j == 1) continue;
+            buffer_.fill<RawDtype>(4 * i + j, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
         }
-        if (i % 2 == 0) buffer_.fetch(-1);
+        ASSERT_TRUE(buffer_.fetch(10));
+        EXPECT_THAT(buffer_.front(),
+                    Pointwise(FloatNear(1e-6), {6., 5., 4., 3., 2., 1.,
+                                                1., 2., 3., 4., 5., 6.,
+                                                6., 5., 4., 3., 2., 1.,
+                                                6., 5., 4., 3., 2., 1.}));
+
+        // Data of a fetched chunk are outdated.
+        for (size_t j = 0; j < shape_[0]; ++j) {
+            buffer_.fill<RawDtype>(4 * i + j, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+        }
+        ASSERT_EQ(buffer_.occupied(), 0);
+        ASSERT_FALSE(buffer_.fetch(10));
+    }
+}
 
-        // Attempt to fill half of the second group.
-        for (size_t j = 0; j < shape_[0] / 2; ++j) {
-            buffer_.fill<RawDtype>(4 + j, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+TEST_F(MemoryBufferTest, TestIndexRestart) {
+    for (size_t i = 0; i < 2 * shape_[0] * capacity_; ++i) {
+        buffer_.fill<RawDtype>(i, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+        if (i % shape_[0] == shape_[0] - 1) {
+            ASSERT_TRUE(buffer_.fetch(10));
         }
-        if (i % 2 == 1) {
-            buffer_.fetch(-1);
-            ASSERT_EQ(buffer_.occupied(), 0);
-        } else {
-            ASSERT_EQ(buffer_.occupied(), 1);
+    }
+
+    // A backward jump beyond the capacity restarts the chunk index.
+    for (size_t j = 0; j < shape_[0]; ++j) {
+        buffer_.fill<RawDtype>(j, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
+    }
+    ASSERT_TRUE(buffer_.fetch(10));
+    EXPECT_THAT(buffer_.front(),
+                Pointwise(FloatNear(1e-6), {6., 5., 4., 3., 2., 1.,
+                                            6., 5., 4., 3., 2., 1.,
+                                            6., 5., 4., 3., 2., 1.,
+                                            6., 5., 4., 3., 2., 1.}));
+}
+
+TEST_F(MemoryBufferTest, TestExpectedIndexRestart) {
+    for (size_t i = 0; i < shape_[0] * capacity_; ++i) {
+        buffer_.fill<RawDtype>(i, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+        if (i % shape_[0] == shape_[0] - 1) {
+            ASSERT_TRUE(buffer_.fetch(10));
+        }
+    }
+    size_t last_chunk = buffer_.frontChunk();
+
+    // A backward jump within the capacity is only a restart if it is expected.
+    EXPECT_FALSE(buffer_.fill<RawDtype>(0, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1}));
+    ASSERT_EQ(buffer_.occupied(), 0);
+
+    buffer_.expectRestart();
+    for (size_t j = 0; j < shape_[0]; ++j) {
+        buffer_.fill<RawDtype>(j, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
+    }
+    ASSERT_TRUE(buffer_.fetch(10));
+    // The chunk index keeps increasing.
+    EXPECT_GT(buffer_.frontChunk(), last_chunk);
+    EXPECT_THAT(buffer_.front(),
+                Pointwise(FloatNear(1e-6), {6., 5., 4., 3., 2., 1.,
+                                            6., 5., 4., 3., 2., 1.,
+                                            6., 5., 4., 3., 2., 1.,
+                                            6., 5., 4., 3., 2., 1.}));
+}
+
+TEST_F(MemoryBufferTest, TestExpectedIndexRestartCancelled) {
+    for (size_t i = 0; i < shape_[0] * capacity_; ++i) {
+        buffer_.fill<RawDtype>(i, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+        if (i % shape_[0] == shape_[0] - 1) {
+            ASSERT_TRUE(buffer_.fetch(10));
         }
     }
+
+    // The frame index keeps increasing after the restart is expected.
+    buffer_.expectRestart();
+    size_t index = shape_[0] * capacity_;
+    buffer_.fill<RawDtype>(index, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
+    ASSERT_EQ(buffer_.occupied(), 1);
+
+    // A late frame is ignored instead of restarting the chunk index.
+    EXPECT_FALSE(buffer_.fill<RawDtype>(index - 1, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1}));
+    ASSERT_EQ(buffer_.occupied(), 1);
+
+    for (size_t j = 1; j < shape_[0]; ++j) {
+        buffer_.fill<RawDtype>(index + j, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
+    }
+    ASSERT_TRUE(buffer_.fetch(10));
+    EXPECT_EQ(buffer_.frontChunk(), static_cast<size_t>(capacity_));
+    EXPECT_EQ(buffer_.numDroppedChunks(), 0);
+}
+
+TEST_F(MemoryBufferTest, TestExpectedIndexRestartWithPendingChunk) {
+    for (size_t i = 0; i < shape_[0]; ++i) {
+        buffer_.fill<RawDtype>(20 + i, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+    }
+    // chunk 5 is ready and chunk 6 is being filled
+    for (size_t i = 0; i < shape_[0] - 1; ++i) {
+        buffer_.fill<RawDtype>(24 + i, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+    }
+    ASSERT_EQ(buffer_.occupied(), 2);
+
+    buffer_.expectRestart();
+    for (size_t j = 0; j < shape_[0] - 1; ++j) {
+        buffer_.fill<RawDtype>(j, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
+    }
+    ASSERT_EQ(buffer_.occupied(), 3);
+
+    // The ready chunk is handed off.
+    ASSERT_TRUE(buffer_.fetch(10));
+    EXPECT_EQ(buffer_.frontChunk(), 5);
+    EXPECT_THAT(buffer_.front(),
+                Pointwise(FloatNear(1e-6), {1., 2., 3., 4., 5., 6.,
+                                            1., 2., 3., 4., 5., 6.,
+                                            1., 2., 3., 4., 5., 6.,
+                                            1., 2., 3., 4., 5., 6.}));
+    EXPECT_EQ(buffer_.numDroppedChunks(), 0);
+
+    // The chunk before the restart is dropped when the first one after it is ready.
+    EXPECT_TRUE(buffer_.fill<RawDtype>(shape_[0] - 1, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1}));
+    EXPECT_EQ(buffer_.numDroppedChunks(), 1);
+    ASSERT_TRUE(buffer_.fetch(10));
+    EXPECT_EQ(buffer_.frontChunk(), 7);
+    EXPECT_THAT(buffer_.front(),
+                Pointwise(FloatNear(1e-6), {6., 5., 4., 3., 2., 1.,
+                                            6., 5., 4., 3., 2., 1.,
+                                            6., 5., 4., 3., 2., 1.,
+                                            6., 5., 4., 3., 2., 1.}));
+}
+
+TEST_F(MemoryBufferTest, TestFillCallback) {
+    std::vector<std::array<size_t, 2>> filled;
+    auto on_filled = [&](size_t chunk_idx, size_t data_idx, const float* data) {
+        // The chunk is not ready before the last callback returns.
+        EXPECT_FALSE(buffer_.isReady());
+        EXPECT_EQ(data[0], static_cast<float>(data_idx + 1));
+        filled.push_back({chunk_idx, data_idx});
+    };
+
+    for (size_t j : {5, 4, 7, 6, 6}) {
+        auto v = static_cast<RawDtype>(j - 3);
+        buffer_.fill<RawDtype>(j, _produceRawData({v, 0, 0, 0, 0, 0}).data(), {2, 3}, {1, 1},
+                               DownsamplingMode::DECIMATION, on_filled);
+    }
+    // The duplicated projection is not passed on.
+    ASSERT_EQ(filled.size(), 4);
+    EXPECT_EQ(filled[0], (std::array<size_t, 2>{1, 1}));
+    EXPECT_EQ(filled[3], (std::array<size_t, 2>{1, 2}));
+
+    ASSERT_TRUE(buffer_.fetch(10));
+    EXPECT_EQ(buffer_.frontChunk(), 1);
+}
+
+TEST(MemoryBufferRawTest, TestGeneral) {
+    MemoryBuffer<RawDtype, 3> buffer(2);
+    buffer.resize({2, 2, 3});
+
+    buffer.fill<RawDtype>(0, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+    buffer.fill<RawDtype>(1, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
+
+    ASSERT_TRUE(buffer.fetch(-1));
+    EXPECT_THAT(buffer.front(), ElementsAre(1, 2, 3, 4, 5, 6, 6, 5, 4, 3, 2, 1));
+}
+
+TEST_F(MemoryBufferTest, TestRecycleSlotInUse) {
+    std::atomic<bool> filling = false;
+    std::atomic<bool> release = false;
+    std::thread t1([&] {
+        buffer_.fill<RawDtype>(0, _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1},
+                               DownsamplingMode::DECIMATION, [&](size_t, size_t, const float*) {
+            filling = true;
+            while (!release) std::this_thread::yield();
+        });
+    });
+    while (!filling) std::this_thread::yield();
+
+    // Chunk 3 takes over the slot of chunk 0, which is still in use.
+    std::thread t2([&] {
+        buffer_.fill<RawDtype>(3 * shape_[0], _produceRawData({1, 2, 3, 4, 5, 6}).data(), {2, 3}, {1, 1});
+    });
+    while (buffer_.occupied() != 3) std::this_thread::yield();
+
+    // The other chunks can be filled and fetched in the meanwhile.
+    for (size_t j = 0; j < shape_[0]; ++j) {
+        buffer_.fill<RawDtype>(2 * shape_[0] + j, _produceRawData({6, 5, 4, 3, 2, 1}).data(), {2, 3}, {1, 1});
+    }
+    ASSERT_TRUE(buffer_.fetch(1000));
+    EXPECT_EQ(buffer_.frontChunk(), 2);
+
+    release = true;
+    t1.join();
+    t2.join();
+    EXPECT_EQ(buffer_.occupied(), 1);
+    EXPECT_EQ(buffer_.numDroppedChunks(), 2);
 }
 
 TEST_F(MemoryBufferTest, TestReshape) {
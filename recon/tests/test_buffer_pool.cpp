@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "recon/buffer_pool.hpp"
+
+namespace recastx::recon::test {
+
+TEST(BufferPoolTest, TestRecycling) {
+    BufferPool<uint16_t> pool(1000, 2);
+    ASSERT_EQ(pool.numFree(), 0);
+    pool.reserve();
+    ASSERT_EQ(pool.numFree(), 2);
+    ASSERT_EQ(pool.numAllocated(), 2);
+
+    uint16_t* ptr;
+    {
+        auto buf1 = pool.acquire();
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(buf1.get()) % 64, 0);
+        auto buf2 = pool.acquire();
+        ptr = buf2.get();
+        ASSERT_EQ(pool.numFree(), 0);
+        // no more than 'capacity' buffers are allocated
+        ASSERT_EQ(pool.acquire(10), nullptr);
+        buf2.reset();
+        ASSERT_EQ(pool.numFree(), 1);
+        auto buf3 = pool.acquire(10);
+        ASSERT_EQ(buf3.get(), ptr);
+    }
+    ASSERT_EQ(pool.numFree(), 2);
+    ASSERT_EQ(pool.numAllocated(), 2);
+
+    std::vector<std::shared_ptr<uint16_t>> bufs {pool.acquire(), pool.acquire()};
+    ASSERT_THAT(bufs, ::testing::Contains(::testing::Property(&std::shared_ptr<uint16_t>::get, ptr)));
+}
+
+TEST(BufferPoolTest, TestWaitForRelease) {
+    BufferPool<uint16_t> pool(1000, 1);
+    auto buf = pool.acquire();
+    uint16_t* ptr = buf.get();
+
+    auto t = std::thread([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        buf.reset();
+    });
+    auto buf2 = pool.acquire(1000);
+    t.join();
+    ASSERT_EQ(buf2.get(), ptr);
+}
+
+TEST(BufferPoolTest, TestResize) {
+    BufferPool<float> pool(10, 4);
+    pool.reserve();
+    auto buf = pool.acquire();
+    ASSERT_EQ(pool.numFree(), 3);
+
+    pool.resize(20);
+    ASSERT_EQ(pool.bufferSize(), 20);
+    ASSERT_EQ(pool.numFree(), 0);
+    ASSERT_EQ(pool.numAllocated(), 0);
+
+    buf = pool.acquire();
+    buf.reset();
+    ASSERT_EQ(pool.numFree(), 1);
+
+    // a buffer acquired before resizing does not return to the pool, even if the size is restored
+    buf = pool.acquire();
+    pool.resize(10);
+    pool.reserve();
+    buf.reset();
+    ASSERT_EQ(pool.numFree(), 4);
+    ASSERT_EQ(pool.numAllocated(), 4);
+}
+
+TEST(BufferPoolTest, TestOutlivePool) {
+    std::shared_ptr<int> buf;
+    {
+        BufferPool<int> pool(10, 1);
+        buf = pool.acquire();
+        buf.get()[9] = 1;
+    }
+    ASSERT_EQ(buf.get()[9], 1);
+    buf.reset();
+}
+
+} // namespace recastx::recon::test
\ No newline at end of file
@@ -6,12 +6,19 @@
  *
  * The full license is in the file LICENSE, distributed with this software.
 */
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
 #include <thread>
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
 #include "recon/daq/daq_factory.hpp"
+#include "recon/daq/std_daq_client.hpp"
+#include "recon/daq/binary_daq_client.hpp"
+#include "recon/daq/replay_daq_client.hpp"
 
 namespace recastx::recon::test {
 
@@ -24,4 +31,243 @@ TEST(DaqClientTest, TestStdDaqClient) {
     EXPECT_THROW(createDaqClient("default", endpoint, "push"), std::invalid_argument);
 }
 
+TEST(DaqClientTest, TestBinaryDaqClient) {
+    std::string endpoint = "tcp://localhost:5555";
+    EXPECT_NO_THROW(createDaqClient("binary", endpoint, "pull"));
+    EXPECT_NO_THROW(createDaqClient("binary", endpoint, "sub", 2, ZmqClientConfig{}));
+}
+
+TEST(DaqClientTest, TestStdDaqClientPushPull) {
+    std::string endpoint = "tcp://127.0.0.1:5557";
+    zmq::context_t context;
+    zmq::socket_t sender(context, zmq::socket_type::push);
+    sender.bind(endpoint);
+
+    size_t num_rows = 4, num_cols = 3;
+    // Use pooled buffers
+    ZmqClientConfig config;
+    config.rcvhwm = 10;
+    config.pool_size = 4;
+    StdDaqClient client(endpoint, "pull", 2, config);
+    client.spin();
+    client.startAcquiring(num_rows, num_cols);
+
+    {
+        // data size does not match the shape
+        nlohmann::json meta;
+        meta["frame"] = 100;
+        meta["image_attributes"]["scan_index"] = 2;
+        meta["shape"] = {num_rows, num_cols};
+        std::vector<RawDtype> data(num_rows * num_cols - 1);
+        sender.send(zmq::buffer(meta.dump()), zmq::send_flags::sndmore);
+        sender.send(zmq::buffer(data.data(), data.size() * sizeof(RawDtype)), zmq::send_flags::none);
+    }
+
+    size_t num_frames = 10;
+    for (size_t i = 0; i < num_frames; ++i) {
+        nlohmann::json meta;
+        meta["frame"] = i;
+        meta["image_attributes"]["scan_index"] = 2;
+        meta["shape"] = {num_rows, num_cols};
+        std::vector<RawDtype> data(num_rows * num_cols, static_cast<RawDtype>(i));
+        sender.send(zmq::buffer(meta.dump()), zmq::send_flags::sndmore);
+        sender.send(zmq::buffer(data.data(), data.size() * sizeof(RawDtype)), zmq::send_flags::none);
+    }
+
+    std::set<size_t> received;
+    Projection<> proj;
+    for (size_t i = 0; i < num_frames; ++i) {
+        bool ready = false;
+        for (int j = 0; j < 10 && !ready; ++j) ready = client.next(proj);
+        ASSERT_TRUE(ready);
+        EXPECT_TRUE(proj.isView());
+        EXPECT_EQ(proj.type, ProjectionType::PROJECTION);
+        EXPECT_THAT(proj.shape(), ::testing::ElementsAre(num_rows, num_cols));
+        auto ptr = reinterpret_cast<const RawDtype*>(proj.bytes());
+        EXPECT_THAT(std::vector<RawDtype>(ptr, ptr + num_rows * num_cols),
+                    ::testing::Each(static_cast<RawDtype>(proj.index)));
+        received.insert(proj.index);
+    }
+    EXPECT_EQ(received.size(), num_frames);
+    EXPECT_EQ(received.count(100), 0);
+}
+
+TEST(DaqClientTest, TestBinaryDaqClientPushPull) {
+    std::string endpoint = "tcp://127.0.0.1:5558";
+    zmq::context_t context;
+    zmq::socket_t sender(context, zmq::socket_type::push);
+    sender.bind(endpoint);
+
+    size_t num_rows = 4, num_cols = 3;
+    BinaryDaqClient client(endpoint, "pull");
+    client.spin();
+    client.startAcquiring(num_rows, num_cols);
+
+    auto send = [&](const BinaryFrameHeader& h, size_t num_pixels) {
+        char buf[sizeof(BinaryFrameHeader)];
+        std::memcpy(buf, &h, sizeof h);
+        std::vector<RawDtype> data(num_pixels, static_cast<RawDtype>(h.frame));
+        sender.send(zmq::buffer(buf, sizeof buf), zmq::send_flags::sndmore);
+        sender.send(zmq::buffer(data.data(), data.size() * sizeof(RawDtype)), zmq::send_flags::none);
+    };
+
+    BinaryFrameHeader h;
+    h.num_rows = num_rows;
+    h.num_cols = num_cols;
+
+    // invalid messages are dropped
+    h.frame = 100;
+    h.magic = 0;
+    send(h, num_rows * num_cols);
+    h.magic = BinaryFrameHeader::MAGIC;
+    h.dtype = BinaryFrameHeader::FLOAT32;
+    send(h, num_rows * num_cols);
+    h.dtype = BinaryFrameHeader::UINT16;
+    h.scan_index = 3;
+    send(h, num_rows * num_cols);
+    h.scan_index = 0;
+    send(h, num_rows * num_cols - 1);
+
+    h.scan_index = 1;
+    h.frame = 5;
+    send(h, num_rows * num_cols);
+
+    Projection<> proj;
+    bool ready = false;
+    for (int j = 0; j < 10 && !ready; ++j) ready = client.next(proj);
+    ASSERT_TRUE(ready);
+    EXPECT_EQ(proj.type, ProjectionType::FLAT);
+    EXPECT_EQ(proj.index, 5);
+    EXPECT_THAT(proj.shape(), ::testing::ElementsAre(num_rows, num_cols));
+    auto ptr = reinterpret_cast<const RawDtype*>(proj.bytes());
+    EXPECT_THAT(std::vector<RawDtype>(ptr, ptr + num_rows * num_cols), ::testing::Each(5));
+
+    EXPECT_FALSE(client.next(proj));
+}
+
+class ReplayDaqClientTest : public testing::Test {
+
+  protected:
+
+    std::string path_ = (std::filesystem::temp_directory_path() / "recastx_test_replay.raw").string();
+    size_t num_rows_ = 4;
+    size_t num_cols_ = 3;
+
+    ReplayDaqClientTest() {
+        std::ofstream data(path_, std::ios::binary);
+        std::ofstream index(rawStreamIndexPath(path_), std::ios::binary);
+        RawStreamHeader header;
+        header.entry_size = sizeof(RawStreamIndexEntry);
+        index.write(reinterpret_cast<const char*>(&header), sizeof header);
+
+        // 1 dark, 1 flat and 3 projections with an interval of 20 ms
+        std::vector<std::pair<int, uint64_t>> frames {{0, 0}, {1, 0}, {2, 0}, {2, 1}, {2, 2}};
+        uint64_t offset = 0;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            auto [scan_index, frame] = frames[i];
+            std::vector<RawDtype> img(num_rows_ * num_cols_, static_cast<RawDtype>(10 * scan_index + frame));
+            data.write(reinterpret_cast<const char*>(img.data()), img.size() * sizeof(RawDtype));
+
+            RawStreamIndexEntry entry;
+            entry.offset = offset;
+            entry.frame = frame;
+            entry.scan_index = scan_index;
+            entry.num_rows = num_rows_;
+            entry.num_cols = num_cols_;
+            entry.timestamp = 1000 + i * 20'000'000;
+            index.write(reinterpret_cast<const char*>(&entry), sizeof entry);
+            offset += img.size() * sizeof(RawDtype);
+        }
+        // incomplete entry
+        index.write("abc", 3);
+    }
+
+    ~ReplayDaqClientTest() override {
+        std::filesystem::remove(path_);
+        std::filesystem::remove(rawStreamIndexPath(path_));
+    }
+};
+
+TEST_F(ReplayDaqClientTest, TestFactory) {
+    EXPECT_NO_THROW(createDaqClient("replay", path_, 0., true, 2));
+    EXPECT_THROW(createDaqClient("replay", path_ + ".none", 0., true, 2), std::runtime_error);
+    EXPECT_THROW(createDaqClient("replay", path_, -1., true, 2), std::invalid_argument);
+}
+
+TEST_F(ReplayDaqClientTest, TestReplay) {
+    ReplayDaqClient client(path_, 0., true);
+    EXPECT_EQ(client.size(), 5);
+    client.spin();
+
+    Projection<> proj;
+    EXPECT_FALSE(client.next(proj));
+
+    client.startAcquiring(num_rows_, num_cols_);
+    std::vector<std::pair<ProjectionType, size_t>> expected {
+        {ProjectionType::DARK, 0}, {ProjectionType::FLAT, 0},
+        {ProjectionType::PROJECTION, 0}, {ProjectionType::PROJECTION, 1}, {ProjectionType::PROJECTION, 2},
+        {ProjectionType::PROJECTION, 3}, {ProjectionType::PROJECTION, 4}, {ProjectionType::PROJECTION, 5},
+        {ProjectionType::PROJECTION, 6}
+    };
+    for (auto [type, frame] : expected) {
+        ASSERT_TRUE(client.next(proj));
+        EXPECT_EQ(proj.type, type);
+        EXPECT_EQ(proj.index, frame);
+        EXPECT_TRUE(proj.isView());
+        EXPECT_THAT(proj.shape(), ::testing::ElementsAre(num_rows_, num_cols_));
+        auto ptr = reinterpret_cast<const RawDtype*>(proj.bytes());
+        EXPECT_EQ(ptr[num_rows_ * num_cols_ - 1], 10 * static_cast<int>(type) + frame % 3);
+    }
+
+    // restart
+    client.startAcquiring(num_rows_, num_cols_);
+    ASSERT_TRUE(client.next(proj));
+    EXPECT_EQ(proj.type, ProjectionType::DARK);
+
+    // shape mismatch
+    client.startAcquiring(num_rows_ + 1, num_cols_);
+    EXPECT_FALSE(client.next(proj));
+}
+
+TEST_F(ReplayDaqClientTest, TestNoLoop) {
+    ReplayDaqClient client(path_);
+    client.setAcquiring(true);
+    Projection<> proj;
+    for (size_t i = 0; i < 5; ++i) ASSERT_TRUE(client.next(proj));
+    EXPECT_FALSE(client.next(proj));
+}
+
+TEST_F(ReplayDaqClientTest, TestPacing) {
+    ReplayDaqClient client(path_, 2., false);
+    client.setAcquiring(true);
+    Projection<> proj;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < 5; ++i) ASSERT_TRUE(client.next(proj));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    // 4 intervals of 20 ms at 2x speed
+    EXPECT_GE(elapsed, std::chrono::milliseconds(40));
+    // generous upper bound for loaded CI machines
+    EXPECT_LT(elapsed, std::chrono::seconds(1));
+}
+
+TEST_F(ReplayDaqClientTest, TestStopWhilePacing) {
+    // The interval of 20 ms becomes 20 s.
+    ReplayDaqClient client(path_, 1e-3, false);
+    client.setAcquiring(true);
+    Projection<> proj;
+    ASSERT_TRUE(client.next(proj));
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread t([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        client.setAcquiring(false);
+    });
+    // Woken up by stopping the acquisition and the frame is not taken.
+    EXPECT_FALSE(client.next(proj));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    t.join();
+    EXPECT_EQ(client.numTaken(), 1);
+    EXPECT_EQ(client.numQueued(), 0);
+}
+
 } // namespace recastx::recon::test
\ No newline at end of file
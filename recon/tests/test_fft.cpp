@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <filesystem>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+extern "C" {
+#include <fftw3.h>
+}
+
+#include "recon/fft.hpp"
+
+namespace recastx::recon::test {
+
+class FftTest : public testing::Test {
+
+  protected:
+
+    std::filesystem::path wisdom_ = std::filesystem::temp_directory_path() / "recastx_test_fft" / "wisdom";
+
+    void SetUp() override {
+        std::filesystem::remove_all(wisdom_.parent_path());
+    }
+
+    void TearDown() override {
+        setFftPlanning(FftPlanning::ESTIMATE);
+        setFftWisdomFile("", 1);
+        std::filesystem::remove_all(wisdom_.parent_path());
+    }
+};
+
+TEST_F(FftTest, TestPlanningFlags) {
+    EXPECT_EQ(fftPlanning(), FftPlanning::ESTIMATE);
+    EXPECT_EQ(fftPlanningFlags(), FFTW_ESTIMATE);
+
+    setFftPlanning(FftPlanning::MEASURE);
+    EXPECT_EQ(fftPlanning(), FftPlanning::MEASURE);
+    EXPECT_EQ(fftPlanningFlags(), FFTW_MEASURE);
+
+    setFftPlanning(FftPlanning::PATIENT);
+    EXPECT_EQ(fftPlanningFlags(), FFTW_PATIENT);
+}
+
+TEST_F(FftTest, TestWisdomFile) {
+    auto file = wisdom_.string() + ".4";
+
+    EXPECT_FALSE(setFftWisdomFile(wisdom_.string(), 4));
+    saveFftWisdom();
+    ASSERT_TRUE(std::filesystem::exists(file));
+
+    std::vector<float> data(30);
+    std::vector<fftwf_complex> freq(16);
+    auto plan = fftwf_plan_dft_r2c_1d(30, data.data(), freq.data(), FFTW_MEASURE);
+    fftwf_destroy_plan(plan);
+    auto size = std::filesystem::file_size(file);
+    saveFftWisdom();
+    EXPECT_GT(std::filesystem::file_size(file), size);
+
+    EXPECT_TRUE(setFftWisdomFile(wisdom_.string(), 4));
+    EXPECT_FALSE(setFftWisdomFile(wisdom_.string(), 8));
+}
+
+} // namespace recastx::recon::test
\ No newline at end of file
@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "recon/metrics.hpp"
+
+namespace recastx::recon::test {
+
+using ::testing::HasSubstr;
+
+namespace {
+
+std::string httpGet(int port, const std::string& path) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0) {
+        ::close(fd);
+        return "";
+    }
+
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ::send(fd, request.data(), request.size(), 0);
+
+    std::string response;
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::recv(fd, buf, sizeof buf, 0)) > 0) response.append(buf, n);
+    ::close(fd);
+    return response;
+}
+
+} // namespace
+
+TEST(MetricsTest, TestCounter) {
+    Counter counter;
+    EXPECT_EQ(counter.value(), 0);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] { for (int j = 0; j < 1000; ++j) counter.add(); });
+    }
+    for (auto& t : threads) t.join();
+    counter.add(10);
+    EXPECT_EQ(counter.value(), 4010);
+}
+
+TEST(MetricsTest, TestHistogramBuckets) {
+    // exact below 2 * k_SUB_BUCKETS
+    for (uint64_t v = 0; v < 2 * Histogram::k_SUB_BUCKETS; ++v) {
+        EXPECT_EQ(Histogram::bucketIndex(v), v);
+        EXPECT_EQ(Histogram::bucketUpperBound(v), v);
+    }
+
+    // buckets are contiguous and the relative error is bounded
+    size_t prev = Histogram::bucketIndex(2 * Histogram::k_SUB_BUCKETS - 1);
+    for (uint64_t v = 2 * Histogram::k_SUB_BUCKETS; v < 100000; ++v) {
+        size_t idx = Histogram::bucketIndex(v);
+        ASSERT_TRUE(idx == prev || idx == prev + 1) << v;
+        uint64_t upper = Histogram::bucketUpperBound(idx);
+        ASSERT_GE(upper, v);
+        ASSERT_LE(upper - v, v / Histogram::k_SUB_BUCKETS) << v;
+        prev = idx;
+    }
+
+    EXPECT_EQ(Histogram::bucketIndex(Histogram::k_MAX_VALUE), Histogram::k_NUM_BUCKETS - 1);
+    EXPECT_EQ(Histogram::bucketUpperBound(Histogram::k_NUM_BUCKETS - 1), Histogram::k_MAX_VALUE);
+}
+
+TEST(MetricsTest, TestHistogram) {
+    Histogram hist;
+    EXPECT_EQ(hist.snapshot().count, 0);
+    EXPECT_EQ(hist.snapshot().quantile(0.5), 0);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&] { for (uint64_t v = 1; v <= 1000; ++v) hist.record(v); });
+    }
+    for (auto& t : threads) t.join();
+    hist.record(Histogram::k_MAX_VALUE + 1);
+
+    auto snap = hist.snapshot();
+    EXPECT_EQ(snap.count, 4001);
+    EXPECT_EQ(snap.sum, 4 * 500500 + Histogram::k_MAX_VALUE);
+    EXPECT_NEAR(static_cast<double>(snap.quantile(0.5)), 500., 500. / Histogram::k_SUB_BUCKETS);
+    EXPECT_NEAR(static_cast<double>(snap.quantile(0.99)), 990., 990. / Histogram::k_SUB_BUCKETS);
+    EXPECT_EQ(snap.quantile(1.), Histogram::k_MAX_VALUE);
+}
+
+TEST(MetricsTest, TestExposition) {
+    Metrics metrics;
+
+    auto& c1 = metrics.counter("recon_bytes_sent_total", "Bytes sent.", {{"client", "a"}});
+    auto& c2 = metrics.counter("recon_bytes_sent_total", "Bytes sent.", {{"client", "b\"c"}});
+    EXPECT_EQ(&metrics.counter("recon_bytes_sent_total", "Bytes sent.", {{"client", "a"}}), &c1);
+    c1.add(3);
+    c2.add(5);
+
+    size_t depth = 7;
+    metrics.gauge("recon_queue_depth", "Queue depth.", [&] { return depth; });
+
+    auto& hist = metrics.histogram("recon_upload_seconds", "Upload time.");
+    hist.record(1000);
+    hist.record(2000);
+
+    EXPECT_THROW(metrics.histogram("recon_queue_depth", "Queue depth."), std::invalid_argument);
+
+    auto samples = metrics.collect();
+    ASSERT_EQ(samples.size(), 4);
+
+    auto text = metrics.exposition();
+    EXPECT_THAT(text, HasSubstr("# TYPE recon_bytes_sent_total counter\n"));
+    EXPECT_THAT(text, HasSubstr("recon_bytes_sent_total{client=\"a\"} 3\n"));
+    EXPECT_THAT(text, HasSubstr("recon_bytes_sent_total{client=\"b\\\"c\"} 5\n"));
+    EXPECT_THAT(text, HasSubstr("# TYPE recon_queue_depth gauge\nrecon_queue_depth 7\n"));
+    EXPECT_THAT(text, HasSubstr("# TYPE recon_upload_seconds summary\n"));
+    EXPECT_THAT(text, HasSubstr("recon_upload_seconds{quantile=\"0.5\"} 0.001"));
+    EXPECT_THAT(text, HasSubstr("recon_upload_seconds_sum 0.003\n"));
+    EXPECT_THAT(text, HasSubstr("recon_upload_seconds_count 2\n"));
+
+    depth = 2;
+    EXPECT_THAT(metrics.exposition(), HasSubstr("recon_queue_depth 2\n"));
+}
+
+TEST(MetricsTest, TestServer) {
+    Metrics metrics;
+    metrics.counter("recon_tomograms_total", "Tomograms.").add(2);
+
+    MetricsServer server(0, metrics);
+    ASSERT_GT(server.port(), 0);
+
+    auto response = httpGet(server.port(), "/metrics");
+    EXPECT_THAT(response, HasSubstr("HTTP/1.1 200 OK"));
+    EXPECT_THAT(response, HasSubstr("recon_tomograms_total 2\n"));
+
+    EXPECT_THAT(httpGet(server.port(), "/unknown"), HasSubstr("HTTP/1.1 404 Not Found"));
+}
+
+} // namespace recastx::recon::test
\ No newline at end of file
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <cmath>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <oneapi/tbb.h>
+
+#include "recon/phase.hpp"
+
+namespace recastx::recon::test {
+
+using ::testing::Each;
+using ::testing::FloatNear;
+using ::testing::Pointwise;
+
+class PaganinTest : public testing::Test {
+
+  protected:
+
+    float pixel_size_ = 1.e-6f;
+    float lambda_ = 1.23984193e-10f;
+    float delta_ = 1.e-7f;
+    float beta_ = 1.e-9f;
+    float distance_ = 0.1f;
+
+    int cols_ = 7;
+    int rows_ = 19;
+    int pixels_ = rows_ * cols_;
+};
+
+TEST_F(PaganinTest, TestFilter) {
+    auto filter = details::paganinFilter(pixel_size_, lambda_, delta_, beta_, distance_, cols_, rows_);
+    ASSERT_EQ(filter.size(), rows_ * (cols_ / 2 + 1));
+
+    float norm = 1.f / pixels_;
+    EXPECT_FLOAT_EQ(filter[0], norm);
+    for (float v : filter) EXPECT_LE(v, norm);
+    // symmetric in the rows
+    for (int i = 1; i < rows_; ++i) {
+        for (int j = 0; j < cols_ / 2 + 1; ++j) {
+            EXPECT_FLOAT_EQ(filter[i * (cols_ / 2 + 1) + j], filter[(rows_ - i) * (cols_ / 2 + 1) + j]);
+        }
+    }
+}
+
+TEST_F(PaganinTest, TestUniformImage) {
+    std::vector<float> data(pixels_, 0.5f);
+    Paganin paganin(pixel_size_, lambda_, delta_, beta_, distance_, data.data(), cols_, rows_, 1);
+    std::fill(data.begin(), data.end(), 0.5f);
+    paganin.apply(data.data(), 0);
+
+    float expected = -lambda_ / (4.f * static_cast<float>(M_PI) * beta_) * std::log(0.5f);
+    EXPECT_THAT(data, Each(FloatNear(expected, 1e-4f * expected)));
+}
+
+TEST_F(PaganinTest, TestFastLog) {
+    std::vector<float> src(pixels_);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = 0.5f + 0.1f * static_cast<float>((i * 3) % 7);
+
+    std::vector<float> workspace(pixels_);
+    std::vector<float> expected(src);
+    Paganin(pixel_size_, lambda_, delta_, beta_, distance_, workspace.data(), cols_, rows_, 1)
+        .apply(expected.data(), 0);
+
+    std::vector<float> data(src);
+    Paganin(pixel_size_, lambda_, delta_, beta_, distance_, workspace.data(), cols_, rows_, 1, true)
+        .apply(data.data(), 0);
+    for (size_t i = 0; i < data.size(); ++i) {
+        EXPECT_NEAR(data[i], expected[i], 1e-6f * std::abs(expected[i]) + 1e-12f) << i;
+    }
+}
+
+TEST_F(PaganinTest, TestConcurrentApply) {
+    int num_threads = 4;
+    int num_images = 16;
+    std::vector<float> src(num_images * pixels_);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = 0.5f + 0.1f * static_cast<float>((i * 7) % 5);
+
+    std::vector<float> expected(src);
+    std::vector<float> workspace(pixels_);
+    Paganin serial(pixel_size_, lambda_, delta_, beta_, distance_, workspace.data(), cols_, rows_, 1);
+    for (int i = 0; i < num_images; ++i) serial.apply(&expected[i * pixels_], 0);
+
+    std::vector<float> data(src);
+    Paganin paganin(pixel_size_, lambda_, delta_, beta_, distance_, workspace.data(), cols_, rows_, num_threads);
+    oneapi::tbb::task_arena arena(num_threads);
+    arena.execute([&] {
+        oneapi::tbb::parallel_for(0, num_images, [&](int i) {
+            paganin.apply(&data[i * pixels_], oneapi::tbb::this_task_arena::current_thread_index());
+        });
+    });
+    EXPECT_THAT(data, Pointwise(FloatNear(1e-5), expected));
+}
+
+} // namespace recastx::recon::test
\ No newline at end of file
@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "recon/pipeline.hpp"
+
+namespace recastx::recon::test {
+
+TEST(PipelineTest, TestStages) {
+    std::atomic<int> chunks = 0;
+    std::atomic<int> handed_off = 0;
+    std::atomic<int> fetched = 0;
+    std::atomic<int> uploaded = 0;
+    std::atomic<int> reconstructed = 0;
+    std::atomic<int> max_staged = 0;
+
+    Pipeline pipeline({
+        [&] {
+            // Take all the complete chunks at once.
+            if (chunks.exchange(0) == 0) return false;
+            int staged = ++handed_off - fetched;
+            if (staged > max_staged) max_staged = staged;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            return true;
+        },
+        [&] {
+            if (fetched == handed_off) return false;
+            ++fetched;
+            return true;
+        },
+        [&] {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            ++uploaded;
+        },
+        [&] { ++reconstructed; },
+        [] {}
+    });
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; ++i) {
+        producers.emplace_back([&] {
+            for (int j = 0; j < 50; ++j) {
+                ++chunks;
+                pipeline.ingest();
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    pipeline.wait();
+
+    EXPECT_EQ(chunks, 0);
+    EXPECT_GT(handed_off, 0);
+    // The staging buffer is always released before the next hand-off.
+    EXPECT_EQ(max_staged, 1);
+    EXPECT_EQ(fetched, handed_off);
+    EXPECT_EQ(uploaded, handed_off);
+    EXPECT_EQ(reconstructed, uploaded);
+}
+
+TEST(PipelineTest, TestNothingHandedOff) {
+    std::atomic<int> preprocessed = 0;
+    std::atomic<int> fetched = 0;
+
+    Pipeline pipeline({
+        [&] { ++preprocessed; return false; },
+        [&] { ++fetched; return false; },
+        [] {},
+        [] {},
+        [] {}
+    });
+
+    for (int i = 0; i < 3; ++i) {
+        pipeline.ingest();
+        pipeline.wait();
+    }
+    // The staging token is returned if nothing is handed off.
+    EXPECT_EQ(preprocessed, 3);
+    EXPECT_EQ(fetched, 0);
+}
+
+TEST(PipelineTest, TestOnDemand) {
+    std::atomic<int> count = 0;
+
+    {
+        Pipeline pipeline({
+            [] { return false; },
+            [] { return false; },
+            [] {},
+            [] {},
+            [&] { ++count; }
+        });
+
+        pipeline.requestOnDemand();
+        pipeline.wait();
+        EXPECT_EQ(count, 1);
+
+        pipeline.requestOnDemand();
+        // The pending requests are drained on destruction.
+    }
+    EXPECT_EQ(count, 2);
+}
+
+} // namespace recastx::recon::test
\ No newline at end of file
@@ -6,6 +6,9 @@
  *
  * The full license is in the file LICENSE, distributed with this software.
 */
+#include <cmath>
+#include <numeric>
+
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
@@ -17,6 +20,7 @@ namespace recastx::recon::test {
 using ::testing::ElementsAreArray;
 using ::testing::Pointwise;
 using ::testing::FloatNear;
+using ::testing::Each;
 
 
 TEST(TestPreprocessing, TestCopyToBuffer) {
@@ -93,6 +97,42 @@ TEST(TestPreprocessing, TestCopyToBuffer) {
     }
 }
 
+TEST(TestPreprocessing, TestCopyToBufferBinning) {
+    {
+        ProImageData src ({4, 4}, {
+            0, 1, 2, 3,
+            1, 2, 3, 4,
+            2, 3, 4, 5,
+            3, 4, 5, 6
+        });
+        ProImageData dst ({2, 2});
+        details::copyToBuffer(dst, src, {2, 2}, DownsamplingMode::BINNING);
+        EXPECT_THAT(dst, ElementsAreArray({
+            1, 3,
+            3, 5
+        }));
+    }
+    {
+        ProImageData src ({7, 5}, {
+            0, 1, 2, 3, 4,
+            1, 2, 3, 4, 5,
+            2, 3, 4, 5, 6,
+            3, 4, 5, 6, 7,
+            4, 5, 6, 7, 8,
+            5, 6, 7, 8, 9,
+            6, 7, 8, 9, 10,
+        });
+        ProImageData dst ({4, 3});
+        details::copyToBuffer(dst, src, {2, 2}, DownsamplingMode::BINNING);
+        EXPECT_THAT(dst, ElementsAreArray({
+            1, 3, 0,
+            3, 5, 0,
+            5, 7, 0,
+            0, 0, 0
+        }));
+    }
+}
+
 TEST(TestPreprocessing, TestComputeReciprocal) {
 
     using ValueType = RawImageData::ValueType;
@@ -151,6 +191,137 @@ TEST(TestPreprocessing, TestComputeReciprocal) {
     }
 }
 
+TEST(TestPreprocessing, TestImageAccumulator) {
+    using ValueType = RawImageData::ValueType;
+    std::array<size_t, 2> shape {4, 3};
+    std::vector<RawImageData> images;
+    images.emplace_back(shape, std::vector<ValueType>{4, 1, 1, 2, 0, 9, 7, 4, 3, 8, 6, 8});
+    images.emplace_back(shape, std::vector<ValueType>{1, 7, 3, 0, 6, 6, 0, 8, 1, 8, 4, 2});
+    images.emplace_back(shape, std::vector<ValueType>{2, 4, 6, 0, 9, 5, 8, 3, 4, 2, 2, 65535});
+
+    ImageAccumulator acc;
+    EXPECT_TRUE(acc.empty());
+    for (const auto& img : images) acc.push(reinterpret_cast<const char*>(img.data()), shape);
+    EXPECT_EQ(acc.count(), 3);
+    EXPECT_THAT(acc.shape(), ElementsAreArray(shape));
+
+    Tensor<float, 2> avg;
+    acc.average(avg);
+    EXPECT_THAT(avg, Pointwise(FloatNear(1e-6), math::average<float>(images)));
+
+    // Restart with another shape.
+    std::vector<ValueType> img(6, 5);
+    acc.push(reinterpret_cast<const char*>(img.data()), {2, 3});
+    EXPECT_EQ(acc.count(), 1);
+    acc.average(avg);
+    EXPECT_THAT(avg, ElementsAreArray({5.f, 5.f, 5.f, 5.f, 5.f, 5.f}));
+
+    acc.reset();
+    EXPECT_TRUE(acc.empty());
+    acc.push(reinterpret_cast<const char*>(img.data()), {2, 3});
+    acc.push(reinterpret_cast<const char*>(img.data()), {2, 3});
+    acc.average(avg);
+    EXPECT_THAT(avg, ElementsAreArray({5.f, 5.f, 5.f, 5.f, 5.f, 5.f}));
+}
+
+TEST(TestPreprocessing, TestComputeReciprocalFromAccumulators) {
+    using ValueType = RawImageData::ValueType;
+    std::array<size_t, 2> shape {4, 3};
+    std::vector<RawImageData> darks;
+    darks.emplace_back(shape, std::vector<ValueType>{4, 1, 1, 2, 0, 9, 7, 4, 3, 8, 6, 8});
+    darks.emplace_back(shape, std::vector<ValueType>{1, 7, 3, 0, 6, 6, 0, 8, 1, 8, 4, 2});
+    std::vector<RawImageData> flats;
+    flats.emplace_back(shape, std::vector<ValueType>{1, 9, 5, 1, 7, 9, 0, 6, 7, 1, 5, 6});
+    flats.emplace_back(shape, std::vector<ValueType>{2, 4, 8, 1, 3, 9, 5, 6, 1, 1, 1, 7});
+    flats.emplace_back(shape, std::vector<ValueType>{9, 9, 4, 1, 6, 8, 6, 9, 2, 4, 9, 4});
+
+    ImageAccumulator dark_acc;
+    ImageAccumulator flat_acc;
+    for (const auto& img : darks) dark_acc.push(reinterpret_cast<const char*>(img.data()), shape);
+    for (const auto& img : flats) flat_acc.push(reinterpret_cast<const char*>(img.data()), shape);
+
+    for (auto mode : {DownsamplingMode::DECIMATION, DownsamplingMode::BINNING}) {
+        ProImageData dark_avg_expected({2, 1});
+        ProImageData reciprocal_expected({2, 1});
+        computeReciprocal(darks, flats, dark_avg_expected, reciprocal_expected, {2, 2}, mode);
+
+        ProImageData dark_avg({2, 1});
+        ProImageData reciprocal({2, 1});
+        computeReciprocal(dark_acc, flat_acc, dark_avg, reciprocal, {2, 2}, mode);
+        EXPECT_THAT(dark_avg, Pointwise(FloatNear(1e-6), dark_avg_expected));
+        EXPECT_THAT(reciprocal, Pointwise(FloatNear(1e-6), reciprocal_expected));
+    }
+
+    {
+        ImageAccumulator empty;
+        ProImageData dark_avg(shape);
+        ProImageData reciprocal(shape);
+        computeReciprocal(empty, flat_acc, dark_avg, reciprocal, {1, 1});
+        EXPECT_THAT(dark_avg, Each(0.f));
+        computeReciprocal(dark_acc, empty, dark_avg, reciprocal, {1, 1});
+        EXPECT_THAT(reciprocal, Each(1.f));
+    }
+}
+
+TEST(TestPreprocessing, TestFlatField) {
+    ProImageData dark ({2, 2}, {1, 2, 3, 4});
+    ProImageData reciprocal ({2, 2}, {0.5, 1, 0.25, 2});
+    std::vector<RawDtype> src {3, 2, 7, 5};
+    std::vector<float> dst(4);
+    flatField(dst.data(), src.data(), src.size(), dark, reciprocal);
+    EXPECT_THAT(dst, ElementsAreArray({1, 0, 1, 2}));
+}
+
+TEST(TestPreprocessing, TestFusedFlatField) {
+    ProImageData dark ({2, 2}, {1, 2, 3, 4});
+    ProImageData reciprocal ({2, 2}, {0.5, 1, 0.25, 2});
+    std::vector<RawDtype> src {3, 2, 7, 5};
+    std::vector<float> dst(4);
+    flatField(dst.data(), src.data(), src.size(), dark.data(), reciprocal.data(), false);
+    EXPECT_THAT(dst, ElementsAreArray({1, 0, 1, 2}));
+
+    // only the last two pixels
+    flatField(dst.data(), src.data() + 2, 2, dark.data() + 2, reciprocal.data() + 2, true);
+    EXPECT_THAT(dst, Pointwise(FloatNear(1e-6), {0.f, -std::log(2.f), 1.f, 2.f}));
+}
+
+TEST(TestPreprocessing, TestTileRows) {
+    // 2 + 3 * 4 bytes per pixel
+    EXPECT_EQ(details::tileRows(2048, 2048, 16, 1 << 20), 16);
+    EXPECT_EQ(details::tileRows(2048, 1000, 16, 1 << 20), 32);
+    EXPECT_EQ(details::tileRows(2048, 100, 16, 1 << 20), 368);
+    // at least one aligned block
+    EXPECT_EQ(details::tileRows(2048, 1 << 20, 16, 1 << 20), 16);
+    EXPECT_EQ(details::tileRows(10, 100, 16, 1 << 20), 10);
+    EXPECT_EQ(details::tileRows(1000, 1000, 1, 1 << 20), 37);
+
+    EXPECT_GT(details::l2CacheSize(), 0);
+}
+
+TEST(TestPreprocessing, TestCopyTilesToSinogram) {
+    size_t chunk_size = 3;
+    size_t row_count = 5;
+    size_t col_count = 4;
+    Tensor<int, 3> src ({chunk_size, row_count, col_count});
+    std::iota(src.begin(), src.end(), 1);
+
+    for (int32_t offset : {0, 1, -2}) {
+        Tensor<int, 3> expected ({row_count, chunk_size, col_count});
+        Tensor<int, 3> dst ({row_count, chunk_size, col_count});
+        for (size_t i = 0; i < chunk_size; ++i) {
+            copyToSinogram(expected.data(), src, i, chunk_size, row_count, col_count, offset);
+
+            size_t tile = 2;
+            for (size_t r = 0; r < row_count; r += tile) {
+                size_t n = std::min(tile, row_count - r);
+                copyToSinogram(dst.data() + (row_count - r - n) * chunk_size * col_count,
+                               &src[(i * row_count + r) * col_count], i, chunk_size, n, col_count, offset);
+            }
+        }
+        EXPECT_THAT(dst, ElementsAreArray(expected)) << offset;
+    }
+}
+
 TEST(TestPreprocessing, TestCopyToSinogram) {
 
     // (chunk_idx, rows, cols) -> (rows, chunk_idx, cols).
@@ -64,4 +64,25 @@ TEST(ProjectionMediatorTest, TestSetFilter3) {
     ASSERT_FALSE(m.waitAndPop(proj, 0));
 }
 
+TEST(ProjectionMediatorTest, TestProjectionView) {
+    auto raw = std::make_shared<std::vector<RawDtype>>(std::vector<RawDtype>{1, 2, 3, 4, 5, 6});
+    Projection proj(ProjectionType::PROJECTION, 7, 3, 2, raw, raw->data());
+    ASSERT_TRUE(proj.isView());
+    ASSERT_THAT(proj.shape(), ElementsAre(2, 3));
+    ASSERT_EQ(reinterpret_cast<const RawDtype*>(proj.bytes()), raw->data());
+    ASSERT_EQ(raw.use_count(), 2);
+
+    ProjectionMediator m;
+    m.setFilter(1);
+    m.push(std::move(proj));
+
+    Projection<> out;
+    ASSERT_TRUE(m.waitAndPop(out, 0));
+    out.materialize();
+    ASSERT_FALSE(out.isView());
+    ASSERT_EQ(raw.use_count(), 1);
+    ASSERT_THAT(out.shape(), ElementsAre(2, 3));
+    ASSERT_THAT(out.data, ElementsAre(1, 2, 3, 4, 5, 6));
+}
+
 }
\ No newline at end of file
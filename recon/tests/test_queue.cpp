@@ -12,6 +12,7 @@
 #include <gmock/gmock.h>
 
 #include "common/queue.hpp"
+#include "common/ring_queue.hpp"
 
 namespace recastx::recon::test {
 
@@ -119,4 +120,139 @@ TEST(ThreadSafeQueueTest, TestDataBufferMpmc) {
     ASSERT_TRUE(queue.empty());
 }
 
+TEST(RingQueueTest, TestGeneral) {
+    using DataType = std::vector<int>;
+
+    EXPECT_THROW(RingQueue<DataType>(0), std::invalid_argument);
+
+    RingQueue<DataType> queue(2);
+    ASSERT_TRUE(queue.empty());
+    ASSERT_EQ(queue.capacity(), 2);
+
+    DataType new_item {1, 2, 3};
+    ASSERT_TRUE(queue.tryPush(new_item));
+    ASSERT_EQ(new_item.size(), 3);
+    ASSERT_FALSE(queue.empty());
+
+    DataType item;
+    ASSERT_TRUE(queue.tryPop(item));
+    ASSERT_EQ(item, new_item);
+    ASSERT_FALSE(queue.tryPop(item));
+    ASSERT_FALSE(queue.waitAndPop(item, 10));
+
+    // wrap around
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(queue.tryPush({i}));
+        ASSERT_TRUE(queue.tryPush({i + 1}));
+        ASSERT_TRUE(queue.waitAndPop(item, 0));
+        ASSERT_THAT(item, ::testing::ElementsAre(i));
+        ASSERT_TRUE(queue.waitAndPop(item));
+        ASSERT_THAT(item, ::testing::ElementsAre(i + 1));
+    }
+}
+
+TEST(RingQueueTest, TestPolicy) {
+    {
+        RingQueue<int> queue(2, QueuePolicy::DROP_OLDEST);
+        ASSERT_TRUE(queue.tryPush(1));
+        ASSERT_TRUE(queue.push(2));
+        ASSERT_FALSE(queue.tryPush(3));
+        ASSERT_EQ(queue.dropped(), 0);
+        ASSERT_TRUE(queue.push(3));
+        ASSERT_EQ(queue.size(), 2);
+        ASSERT_EQ(queue.dropped(), 1);
+
+        int item;
+        queue.tryPop(item);
+        ASSERT_EQ(item, 2);
+        queue.tryPop(item);
+        ASSERT_EQ(item, 3);
+    }
+
+    {
+        RingQueue<int> queue(2, QueuePolicy::DROP_NEWEST);
+        ASSERT_TRUE(queue.push(1));
+        ASSERT_TRUE(queue.push(2));
+        ASSERT_FALSE(queue.push(3));
+        ASSERT_EQ(queue.size(), 2);
+        ASSERT_EQ(queue.dropped(), 1);
+
+        int item;
+        queue.tryPop(item);
+        ASSERT_EQ(item, 1);
+        queue.tryPop(item);
+        ASSERT_EQ(item, 2);
+    }
+
+    {
+        RingQueue<std::unique_ptr<int>> queue(1, QueuePolicy::BLOCK);
+        ASSERT_TRUE(queue.push(std::make_unique<int>(1)));
+        auto data = std::make_unique<int>(2);
+        ASSERT_FALSE(queue.push(std::move(data), 10));
+        // not moved on failure
+        ASSERT_EQ(*data, 2);
+        ASSERT_EQ(queue.dropped(), 0);
+
+        auto consumer = std::thread([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            std::unique_ptr<int> item;
+            queue.waitAndPop(item);
+        });
+        ASSERT_TRUE(queue.push(std::move(data)));
+        consumer.join();
+
+        std::unique_ptr<int> item;
+        ASSERT_TRUE(queue.tryPop(item));
+        ASSERT_EQ(*item, 2);
+    }
+}
+
+TEST(RingQueueTest, TestReset) {
+    auto data = std::make_shared<int>(1);
+    RingQueue<std::shared_ptr<int>> queue(2);
+    queue.push(data);
+    queue.push(data);
+    ASSERT_EQ(data.use_count(), 3);
+    queue.reset();
+    ASSERT_TRUE(queue.empty());
+    // resources are released
+    ASSERT_EQ(data.use_count(), 1);
+    ASSERT_EQ(queue.popped(), 0);
+
+    queue.push(data);
+    std::shared_ptr<int> item;
+    ASSERT_TRUE(queue.tryPop(item));
+    ASSERT_EQ(item, data);
+    ASSERT_EQ(queue.popped(), 1);
+}
+
+TEST(RingQueueTest, TestMpmc) {
+    RingQueue<int> queue(16, QueuePolicy::BLOCK);
+
+    int n = 10000;
+    std::atomic<long> sum = 0;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 2; ++p) {
+        producers.emplace_back([&] { for (int i = 1; i <= n; ++i) queue.push(i); });
+    }
+    std::vector<std::thread> consumers;
+    std::atomic<int> count = 0;
+    for (int c = 0; c < 3; ++c) {
+        consumers.emplace_back([&] {
+            int ret;
+            while (count < 2 * n) {
+                if (queue.waitAndPop(ret, 10)) {
+                    sum += ret;
+                    ++count;
+                }
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    for (auto& t : consumers) t.join();
+    ASSERT_EQ(sum, static_cast<long>(n) * (n + 1));
+    ASSERT_TRUE(queue.empty());
+    ASSERT_EQ(queue.popped(), 2 * n);
+}
+
 } // namespace recastx::recon::test
\ No newline at end of file
@@ -11,6 +11,7 @@
 
 #include <oneapi/tbb.h>
 
+#include "recon/fft.hpp"
 #include "recon/ramp_filter.hpp"
 
 namespace recastx::recon::test {
@@ -96,4 +97,84 @@ TEST_F(RampFilterTest, TestShepp) {
                            0.41235096f, -1.32173338f, 0.944262f, 1.10916587f, -1.14404545f}));
 }
 
+TEST_F(RampFilterTest, TestBatchedRows) {
+    int cols = 6;
+    int rows = 2 * RampFilter::k_BLOCK_ROWS + 3;
+    std::vector<float> src(rows * cols);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<float>((i * 7) % 11) - 2.f;
+
+    // Filter each row separately as the reference.
+    std::vector<float> expected(src);
+    auto row_filter = RampFilterFactory().create("shepp", expected.data(), cols, 1, 1);
+    for (int r = 0; r < rows; ++r) row_filter->apply(&expected[r * cols], 0);
+
+    auto filter = RampFilterFactory().create("shepp", src.data(), cols, rows, 1);
+    filter->apply(src.data(), 0);
+    EXPECT_THAT(src, Pointwise(FloatNear(1e-5), expected));
+}
+
+TEST_F(RampFilterTest, TestNextSmoothLength) {
+    EXPECT_EQ(details::nextSmoothLength(0), 1);
+    EXPECT_EQ(details::nextSmoothLength(1), 1);
+    EXPECT_EQ(details::nextSmoothLength(11), 12);
+    EXPECT_EQ(details::nextSmoothLength(97), 98);
+    EXPECT_EQ(details::nextSmoothLength(4000), 4000);
+    EXPECT_EQ(details::nextSmoothLength(4001), 4032);
+
+    EXPECT_EQ(RampFilter::paddedLength(2001, RampFilterPadding::NONE), 2001);
+    EXPECT_EQ(RampFilter::paddedLength(2001, RampFilterPadding::ZERO), 4032);
+    EXPECT_EQ(RampFilter::paddedLength(2001, RampFilterPadding::EDGE), 4032);
+}
+
+TEST_F(RampFilterTest, TestPadding) {
+    int cols = 5;
+    int rows = RampFilter::k_BLOCK_ROWS + 1;
+    std::vector<float> src(rows * cols);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<float>((i * 3) % 7) + 1.f;
+
+    // Reference: filter the padded rows without padding and crop them.
+    int n = RampFilter::paddedLength(cols, RampFilterPadding::EDGE);
+    ASSERT_EQ(n, 10);
+    for (auto padding : {RampFilterPadding::ZERO, RampFilterPadding::EDGE}) {
+        std::vector<float> padded(rows * n);
+        for (int r = 0; r < rows; ++r) {
+            const float* s = &src[r * cols];
+            float* d = &padded[r * n];
+            std::copy(s, s + cols, d);
+            if (padding == RampFilterPadding::EDGE) {
+                std::fill(d + cols, d + cols + (n - cols) / 2, s[cols - 1]);
+                std::fill(d + cols + (n - cols) / 2, d + n, s[0]);
+            }
+        }
+        RampFilterFactory().create("shepp", padded.data(), n, rows, 1)->apply(padded.data(), 0);
+        std::vector<float> expected;
+        for (int r = 0; r < rows; ++r) {
+            expected.insert(expected.end(), padded.begin() + r * n, padded.begin() + r * n + cols);
+        }
+
+        std::vector<float> data(src);
+        RampFilterFactory().create("shepp", data.data(), cols, rows, 1, padding)->apply(data.data(), 0);
+        EXPECT_THAT(data, Pointwise(FloatNear(1e-5), expected));
+    }
+}
+
+TEST_F(RampFilterTest, TestMeasuredPlanning) {
+    int cols = 12;
+    int rows = 3;
+    std::vector<float> src(rows * cols);
+    for (size_t i = 0; i < src.size(); ++i) src[i] = static_cast<float>((i * 5) % 7);
+
+    std::vector<float> expected(src);
+    RampFilterFactory().create("ramlak", expected.data(), cols, rows, 1)->apply(expected.data(), 0);
+
+    setFftPlanning(FftPlanning::MEASURE);
+    // The data are overwritten during planning.
+    std::vector<float> data(src.size());
+    auto filter = RampFilterFactory().create("ramlak", data.data(), cols, rows, 1);
+    data = src;
+    filter->apply(data.data(), 0);
+    setFftPlanning(FftPlanning::ESTIMATE);
+    EXPECT_THAT(data, Pointwise(FloatNear(1e-5), expected));
+}
+
 } // namespace recastx::recon::test
\ No newline at end of file
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "recon/recorder.hpp"
+
+namespace recastx::recon::test {
+
+class RecorderTest : public testing::Test {
+
+  protected:
+
+    std::string path_ = (std::filesystem::temp_directory_path() / "recastx_test_recorder.raw").string();
+
+    ~RecorderTest() override {
+        std::filesystem::remove(path_);
+        std::filesystem::remove(rawStreamIndexPath(path_));
+    }
+
+    static Projection<> makeProjection(ProjectionType type, size_t index, size_t num_rows, size_t num_cols) {
+        auto data = std::make_shared<std::vector<RawDtype>>(num_rows * num_cols, static_cast<RawDtype>(index));
+        const void* ptr = data->data();
+        return {type, index, num_cols, num_rows, std::move(data), ptr};
+    }
+
+    std::vector<RawStreamIndexEntry> readIndex() const {
+        std::ifstream fs(rawStreamIndexPath(path_), std::ios::binary);
+        RawStreamHeader header;
+        fs.read(reinterpret_cast<char*>(&header), sizeof header);
+        EXPECT_EQ(header.magic, RawStreamHeader::MAGIC);
+        EXPECT_EQ(header.entry_size, sizeof(RawStreamIndexEntry));
+        std::vector<RawStreamIndexEntry> entries;
+        RawStreamIndexEntry entry;
+        while (fs.read(reinterpret_cast<char*>(&entry), sizeof entry)) entries.push_back(entry);
+        return entries;
+    }
+};
+
+TEST_F(RecorderTest, TestRecording) {
+    size_t num_rows = 30, num_cols = 50;
+    size_t num_frames = 10;
+    {
+        // A frame spans more than one block.
+        Recorder recorder(path_, num_frames, 4096);
+        EXPECT_TRUE(recorder.push(makeProjection(ProjectionType::DARK, 0, num_rows, num_cols)));
+        for (size_t i = 1; i < num_frames; ++i) {
+            ASSERT_TRUE(recorder.push(makeProjection(ProjectionType::PROJECTION, i, num_rows, num_cols)));
+        }
+    }
+
+    size_t frame_size = num_rows * num_cols * sizeof(RawDtype);
+    EXPECT_EQ(std::filesystem::file_size(path_), num_frames * frame_size);
+
+    auto entries = readIndex();
+    ASSERT_EQ(entries.size(), num_frames);
+    std::ifstream fs(path_, std::ios::binary);
+    for (size_t i = 0; i < num_frames; ++i) {
+        const auto& entry = entries[i];
+        EXPECT_EQ(entry.offset, i * frame_size);
+        EXPECT_EQ(entry.frame, i);
+        EXPECT_EQ(entry.scan_index, i == 0 ? 0 : 2);
+        EXPECT_EQ(entry.num_rows, num_rows);
+        EXPECT_EQ(entry.num_cols, num_cols);
+        if (i > 0) {
+            EXPECT_GE(entry.timestamp, entries[i - 1].timestamp);
+        }
+
+        std::vector<RawDtype> img(num_rows * num_cols);
+        fs.seekg(static_cast<std::streamoff>(entry.offset));
+        fs.read(reinterpret_cast<char*>(img.data()), frame_size);
+        EXPECT_THAT(img, ::testing::Each(static_cast<RawDtype>(i)));
+    }
+}
+
+TEST_F(RecorderTest, TestDropping) {
+    size_t num_frames = 1000;
+    size_t num_dropped;
+    {
+        Recorder recorder(path_, 1);
+        for (size_t i = 0; i < num_frames; ++i) {
+            recorder.push(makeProjection(ProjectionType::PROJECTION, i, 64, 64));
+        }
+        num_dropped = recorder.numDropped();
+        EXPECT_GT(num_dropped, 0);
+    }
+    EXPECT_EQ(readIndex().size(), num_frames - num_dropped);
+}
+
+TEST_F(RecorderTest, TestInvalidPath) {
+    EXPECT_THROW(Recorder("/nonexistent/recastx.raw"), std::runtime_error);
+}
+
+} // namespace recastx::recon::test
\ No newline at end of file
@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "recon/simd.hpp"
+
+namespace recastx::recon::test {
+
+using ::testing::ElementsAreArray;
+
+class SimdTest : public testing::Test {
+
+  protected:
+
+    std::vector<simd::Isa> isas_;
+
+    std::vector<uint16_t> src_;
+
+    void SetUp() override {
+        for (auto isa : {simd::Isa::SCALAR, simd::Isa::AVX2, simd::Isa::AVX512}) {
+            if (static_cast<int>(isa) <= static_cast<int>(simd::detectIsa())) isas_.push_back(isa);
+        }
+
+        src_.resize(1000);
+        for (size_t i = 0; i < src_.size(); ++i) src_[i] = static_cast<uint16_t>(i * 997 % 65536);
+    }
+
+    void TearDown() override {
+        simd::setIsa(simd::detectIsa());
+    }
+};
+
+TEST_F(SimdTest, TestSetIsa) {
+    EXPECT_EQ(simd::setIsa(simd::Isa::SCALAR), simd::Isa::SCALAR);
+    EXPECT_EQ(simd::isa(), simd::Isa::SCALAR);
+    EXPECT_EQ(simd::setIsa(simd::Isa::AVX512), simd::detectIsa());
+    EXPECT_EQ(simd::isa(), simd::detectIsa());
+}
+
+TEST_F(SimdTest, TestConvert) {
+    for (auto isa : isas_) {
+        simd::setIsa(isa);
+        for (size_t stride : {1, 2, 3, 5}) {
+            for (size_t n : {0, 1, 7, 8, 9, 16, 17, 33, 100, 199}) {
+                // Only src[(n - 1) * stride] is guaranteed to be valid.
+                size_t size = n == 0 ? 0 : (n - 1) * stride + 1;
+                std::vector<uint16_t> src(src_.begin(), src_.begin() + size);
+                std::vector<float> dst(n, -1.f);
+                std::vector<float> expected(n);
+                for (size_t i = 0; i < n; ++i) expected[i] = static_cast<float>(src[i * stride]);
+
+                simd::convert(dst.data(), src.data(), n, stride);
+                EXPECT_THAT(dst, ElementsAreArray(expected))
+                    << simd::isaName(isa) << ", stride " << stride << ", n " << n;
+            }
+        }
+    }
+}
+
+TEST_F(SimdTest, TestAccumulate) {
+    for (auto isa : isas_) {
+        simd::setIsa(isa);
+        for (size_t n : {0, 5, 16, 31, 100}) {
+            std::vector<float> dst(n, 1.f);
+            std::vector<float> expected(n);
+            for (size_t i = 0; i < n; ++i) expected[i] = 1.f + static_cast<float>(src_[i]);
+
+            simd::accumulate(dst.data(), src_.data(), n);
+            EXPECT_THAT(dst, ElementsAreArray(expected)) << simd::isaName(isa) << ", n " << n;
+        }
+    }
+}
+
+TEST_F(SimdTest, TestReduce) {
+    std::vector<float> src(src_.begin(), src_.end());
+    for (auto isa : isas_) {
+        simd::setIsa(isa);
+        for (size_t factor : {1, 2, 3, 4}) {
+            for (size_t n : {0, 1, 8, 15, 16, 17, 100}) {
+                std::vector<float> dst(n);
+                std::vector<float> expected(n);
+                for (size_t i = 0; i < n; ++i) {
+                    float v = 0.f;
+                    for (size_t k = 0; k < factor; ++k) v += src[i * factor + k];
+                    expected[i] = v * 0.5f;
+                }
+
+                simd::reduce(dst.data(), src.data(), n, factor, 0.5f);
+                EXPECT_THAT(dst, ElementsAreArray(expected))
+                    << simd::isaName(isa) << ", factor " << factor << ", n " << n;
+            }
+        }
+    }
+}
+
+TEST_F(SimdTest, TestNegativeLog) {
+    // Values after flat field correction: mostly in (0, 2], but anything positive is possible.
+    std::vector<float> src;
+    for (float v = 1e-4f; v < 4.f; v *= 1.0001f) src.push_back(v);
+    for (float v = std::numeric_limits<float>::min(); v < 1e38f; v *= 1.01f) src.push_back(v);
+    for (int k = -1000; k <= 1000; ++k) src.push_back(1.f + static_cast<float>(k) * 1e-7f);
+
+    for (auto isa : isas_) {
+        simd::setIsa(isa);
+        std::vector<float> dst(src);
+        simd::negativeLog(dst.data(), dst.size());
+
+        double max_rel_err = 0.;
+        for (size_t i = 0; i < src.size(); ++i) {
+            double expected = -std::log(static_cast<double>(src[i]));
+            double err = std::abs(dst[i] - expected);
+            if (std::abs(expected) > 1e-3) {
+                max_rel_err = std::max(max_rel_err, err / std::abs(expected));
+            } else {
+                ASSERT_LE(err, 1e-10) << simd::isaName(isa) << ", " << src[i];
+            }
+        }
+        EXPECT_LE(max_rel_err, simd::k_NEGATIVE_LOG_MAX_REL_ERROR) << simd::isaName(isa);
+    }
+}
+
+TEST_F(SimdTest, TestNegativeLogEdgeCases) {
+    float min_normal = std::numeric_limits<float>::min();
+    for (auto isa : isas_) {
+        simd::setIsa(isa);
+        for (size_t n : {0, 1, 15, 16, 17, 40}) {
+            std::vector<float> data(n);
+            for (size_t i = 0; i < n; ++i) {
+                switch (i % 5) {
+                    case 0: data[i] = 0.f; break;
+                    case 1: data[i] = -1.f; break;
+                    case 2: data[i] = std::numeric_limits<float>::denorm_min(); break;
+                    case 3: data[i] = 1.f; break;
+                    default: data[i] = 0.25f;
+                }
+            }
+            simd::negativeLog(data.data(), n, 2.f);
+            for (size_t i = 0; i < n; ++i) {
+                float expected;
+                switch (i % 5) {
+                    case 2: expected = -2.f * std::log(min_normal); break;
+                    case 3: expected = 0.f; break;
+                    case 4: expected = 4.f * std::log(2.f); break;
+                    default: expected = 0.f;
+                }
+                EXPECT_NEAR(data[i], expected, 1e-5f * std::abs(expected))
+                    << simd::isaName(isa) << ", n " << n << ", i " << i;
+            }
+        }
+    }
+}
+
+} // namespace recastx::recon::test
\ No newline at end of file
@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "recon/state_machine.hpp"
+
+namespace recastx::recon::test {
+
+enum class State { IDLE, RUNNING, STOPPED };
+
+TEST(StateMachineTest, TestTransition) {
+    StateMachine<State> sm(State::IDLE);
+    EXPECT_EQ(sm.get(), State::IDLE);
+
+    EXPECT_FALSE(sm.transit(State::RUNNING, State::STOPPED));
+    EXPECT_EQ(sm.get(), State::IDLE);
+    EXPECT_TRUE(sm.transit(State::IDLE, State::RUNNING));
+    EXPECT_EQ(sm.get(), State::RUNNING);
+
+    EXPECT_EQ(sm.set(State::STOPPED), State::RUNNING);
+    EXPECT_EQ(sm.get(), State::STOPPED);
+}
+
+TEST(StateMachineTest, TestWait) {
+    StateMachine<State> sm(State::IDLE);
+
+    EXPECT_TRUE(sm.waitFor(State::IDLE, 0));
+    EXPECT_FALSE(sm.waitFor(State::RUNNING, 10));
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread t([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        sm.set(State::RUNNING);
+    });
+    // Woken up by the transition instead of waiting until the timeout.
+    EXPECT_TRUE(sm.waitFor(State::RUNNING, 10000));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(5000));
+    t.join();
+
+    auto is_stopped = [](State s) { return s == State::STOPPED; };
+    EXPECT_FALSE(sm.waitUntil(is_stopped, std::chrono::steady_clock::now() + std::chrono::milliseconds(10)));
+    start = std::chrono::steady_clock::now();
+    t = std::thread([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        sm.set(State::STOPPED);
+    });
+    EXPECT_TRUE(sm.waitUntil(is_stopped, start + std::chrono::seconds(10)));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(5000));
+    t.join();
+}
+
+TEST(StateMachineTest, TestNotify) {
+    StateMachine<State> sm(State::RUNNING);
+    std::atomic<int> count = 0;
+
+    std::thread t([&] {
+        for (int i = 0; i < 100; ++i) {
+            ++count;
+            sm.notify();
+        }
+    });
+    // The condition depends on something else than the state.
+    EXPECT_TRUE(sm.waitUntil([&](State s) { return s == State::RUNNING && count == 100; }));
+    t.join();
+}
+
+} // namespace recastx::recon::test
\ No newline at end of file
@@ -191,6 +191,67 @@ TEST(TestTensor, TestVectorArithmetic) {
     }
 }
 
+TEST(TestTensor, TestExpression) {
+    using TensorType = Tensor<float, 2>;
+    auto t1 = TensorType({2, 2}, {1.f, 2.f, 3.f, 4.f});
+    auto t2 = TensorType({2, 2}, {4.f, 3.f, 2.f, 1.f});
+    auto t3 = TensorType({2, 2}, {2.f, 2.f, 0.5f, 0.5f});
+
+    {
+        TensorType ret = (t1 - t2) * t3;
+        EXPECT_THAT(ret, ElementsAre(-6.f, -2.f, 0.5f, 1.5f));
+        ret = (ret + 1.f) / t3 - t1 * 2.f;
+        EXPECT_THAT(ret, ElementsAre(-4.5f, -4.5f, -3.f, -3.f));
+        ret *= t3;
+        EXPECT_THAT(ret, ElementsAre(-9.f, -9.f, -1.5f, -1.5f));
+        ret /= t3 / 2.f;
+        EXPECT_THAT(ret, ElementsAre(-9.f, -9.f, -6.f, -6.f));
+    }
+    {
+        // The expression refers to the destination.
+        TensorType ret(t1);
+        ret = ret * ret - t1;
+        EXPECT_THAT(ret, ElementsAre(0.f, 2.f, 6.f, 12.f));
+    }
+    {
+        // The destination is reshaped.
+        TensorType ret;
+        ret = t1 * 0.f;
+        EXPECT_THAT(ret.shape(), ElementsAre(2, 2));
+        EXPECT_THAT(ret, ElementsAre(0.f, 0.f, 0.f, 0.f));
+    }
+    {
+        // Evaluate into a tensor with another allocator.
+        AlignedTensor<float, 2> ret = t1 + t2;
+        EXPECT_THAT(ret, ElementsAre(5.f, 5.f, 5.f, 5.f));
+        TensorType ret2 = ret - 1.f;
+        EXPECT_THAT(ret2, ElementsAre(4.f, 4.f, 4.f, 4.f));
+    }
+}
+
+TEST(TestTensor, TestParallelEvaluation) {
+    using TensorType = Tensor<float, 1>;
+    size_t n = details::k_PARALLEL_SIZE + 12345;
+    TensorType t1({n});
+    TensorType t2({n});
+    for (size_t i = 0; i < n; ++i) {
+        t1[i] = static_cast<float>(i % 1000);
+        t2[i] = 2.f;
+    }
+
+    TensorType ret = (t1 + t2) * t2 - 1.f;
+    ret += t2;
+    for (size_t i = 0; i < n; ++i) {
+        ASSERT_EQ(ret[i], (t1[i] + 2.f) * 2.f + 1.f) << i;
+    }
+
+    std::vector<TensorType> src {t1, t2, t1};
+    Tensor<double, 1> avg = math::average(src);
+    for (size_t i = 0; i < n; ++i) {
+        ASSERT_DOUBLE_EQ(avg[i], (2. * t1[i] + 2.) / 3.) << i;
+    }
+}
+
 TEST(TestMath, TestAverage) {
     std::array<size_t, 2> s{2, 3};
     std::vector<Tensor<uint16_t, 2>> src;
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) Paul Scherrer Institut
+ * Author: Jun Zhu
+ *
+ * Distributed under the terms of the BSD 3-Clause License.
+ *
+ * The full license is in the file LICENSE, distributed with this software.
+*/
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "common/config.hpp"
+#include "common/queue.hpp"
+#include "common/ring_queue.hpp"
+
+// Microbenchmarks of ThreadSafeQueue and RingQueue.
+//
+// Usage: benchmark_queue [number of items per producer]
+
+namespace recastx::benchmark {
+
+// Payload similar to a projection received from the DAQ client.
+struct Payload {
+    std::shared_ptr<const void> ref;
+    size_t index = 0;
+};
+
+template<typename Queue>
+bool push(Queue& queue, Payload&& item) {
+    if constexpr (std::is_same_v<Queue, ThreadSafeQueue<Payload>>) {
+        return queue.tryPush(std::move(item));
+    } else {
+        return queue.push(std::move(item), 10);
+    }
+}
+
+template<typename Queue>
+double run(Queue& queue, size_t num_producers, size_t num_consumers, size_t num_items) {
+    auto ref = std::make_shared<int>(0);
+    std::atomic<size_t> consumed = 0;
+    size_t total = num_producers * num_items;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < num_producers; ++p) {
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < num_items; ++i) {
+                // Retry until there is space, which is what the DAQ client does.
+                while (!push(queue, Payload{ref, i})) std::this_thread::yield();
+            }
+        });
+    }
+    for (size_t c = 0; c < num_consumers; ++c) {
+        threads.emplace_back([&] {
+            Payload item;
+            while (consumed < total) {
+                if (queue.waitAndPop(item, 1)) ++consumed;
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(total) / elapsed.count();
+}
+
+void report(const std::string& name, size_t num_producers, size_t num_consumers, double rate) {
+    spdlog::info("{:<16} {} producer(s) / {} consumer(s): {:>12.0f} items/s",
+                 name, num_producers, num_consumers, rate);
+}
+
+} // namespace recastx::benchmark
+
+int main(int argc, char** argv) {
+    using namespace recastx;
+    using namespace recastx::benchmark;
+
+    size_t num_items = argc > 1 ? std::stoul(argv[1]) : 200000;
+    size_t capacity = k_DAQ_BUFFER_SIZE;
+
+    std::vector<std::pair<size_t, size_t>> configs {{1, 1}, {2, 4}, {4, 4}, {8, 2}};
+    for (auto [np, nc] : configs) {
+        ThreadSafeQueue<Payload> q1(static_cast<int>(capacity));
+        report("ThreadSafeQueue", np, nc, run(q1, np, nc, num_items));
+
+        RingQueue<Payload> q2(capacity, QueuePolicy::BLOCK);
+        report("RingQueue", np, nc, run(q2, np, nc, num_items));
+    }
+
+    return 0;
+}
\ No newline at end of file